@@ -0,0 +1,770 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Microbenchmarks of the engine hot paths. Prints a table, or JSON with
+// --json=FILE ("-" for stdout), of ns/op and ops/sec for every benchmark,
+// swept over player counts, observation types and thread counts.
+//
+// Flags (all optional):
+//   --players=2,3,4,5          player counts
+//   --observation_types=0,1,2  AgentObservationType values
+//   --threads=1,2,4            OpenMP thread counts for the parallel env,
+//                              default powers of two up to all cores
+//   --states=1024              states of the parallel env and games of the
+//                              batch engine
+//   --min_time=0.2             minimum seconds measured per benchmark
+//   --filter=Encode            only run benchmarks whose name contains this
+//   --json=FILE                write JSON instead of a table
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "canonical_encoders.h"
+#include "hanabi_arena.h"
+#include "hanabi_batch_engine.h"
+#include "hanabi_compact_state.h"
+#include "hanabi_determinization.h"
+#include "hanabi_game.h"
+#include "hanabi_ismcts.h"
+#include "hanabi_move.h"
+#include "hanabi_observation.h"
+#include "hanabi_parallel_env.h"
+#include "hanabi_state.h"
+#include "util.h"
+
+namespace {
+
+using hanabi_learning_env::CanonicalObservationEncoder;
+using hanabi_learning_env::HanabiBatchEngine;
+using hanabi_learning_env::HanabiCompactState;
+using hanabi_learning_env::HanabiGame;
+using hanabi_learning_env::HanabiMove;
+using hanabi_learning_env::HanabiObservation;
+using hanabi_learning_env::HanabiObservationView;
+using hanabi_learning_env::HanabiParallelEnv;
+using hanabi_learning_env::HanabiState;
+using hanabi_learning_env::kChancePlayerId;
+
+using Clock = std::chrono::steady_clock;
+
+// Number of states prepared for, and ops timed in, one batch.
+constexpr int kBatchSize = 1024;
+
+// Results of benchmarked calls are added here, so they cannot be optimized
+// away.
+volatile size_t sink = 0;
+
+struct Options {
+  std::vector<int> players = {2, 3, 4, 5};
+  std::vector<int> observation_types = {0, 1, 2};
+  std::vector<int> threads;
+  int states = 1024;
+  double min_time = 0.2;
+  std::string filter;
+  std::string json;
+};
+
+struct Result {
+  std::string name;
+  int players;
+  int observation_type;  // -1 if the benchmark does not depend on it.
+  int threads;
+  int64_t ops;
+  double seconds;
+
+  double NsPerOp() const { return 1e9 * seconds / ops; }
+  double OpsPerSec() const { return ops / seconds; }
+};
+
+// Runs setup() untimed and body() timed until body() was timed for at least
+// min_time seconds. body() returns the number of ops it did.
+template <typename Setup, typename Body>
+void Measure(double min_time, Setup setup, Body body, Result* result) {
+  result->ops = 0;
+  result->seconds = 0;
+  do {
+    setup();
+    const auto start = Clock::now();
+    result->ops += body();
+    result->seconds +=
+        std::chrono::duration<double>(Clock::now() - start).count();
+  } while (result->seconds < min_time);
+}
+
+std::vector<int> ParseIntList(const std::string& value) {
+  std::vector<int> list;
+  std::stringstream stream(value);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    list.push_back(std::stoi(item));
+  }
+  return list;
+}
+
+Options ParseArguments(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    const auto value_pos = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || value_pos == std::string::npos) {
+      std::cerr << "Ignoring argument " << arg << "\n";
+      continue;
+    }
+    const std::string key = arg.substr(2, value_pos - 2);
+    const std::string value = arg.substr(value_pos + 1);
+    if (key == "players") {
+      options.players = ParseIntList(value);
+    } else if (key == "observation_types") {
+      options.observation_types = ParseIntList(value);
+    } else if (key == "threads") {
+      options.threads = ParseIntList(value);
+    } else if (key == "states") {
+      options.states = std::stoi(value);
+    } else if (key == "min_time") {
+      options.min_time = std::stod(value);
+    } else if (key == "filter") {
+      options.filter = value;
+    } else if (key == "json") {
+      options.json = value;
+    } else {
+      std::cerr << "Ignoring argument " << arg << "\n";
+    }
+  }
+  if (options.threads.empty()) {
+    int max_threads = 1;
+#ifdef _OPENMP
+    max_threads = omp_get_max_threads();
+#endif
+    for (int threads = 1; threads < max_threads; threads *= 2) {
+      options.threads.push_back(threads);
+    }
+    options.threads.push_back(max_threads);
+  }
+  return options;
+}
+
+HanabiGame MakeGame(int players, int observation_type) {
+  return HanabiGame({{"players", std::to_string(players)},
+                     {"observation_type", std::to_string(observation_type)},
+                     {"seed", "1"}});
+}
+
+void DealAll(HanabiState* state) {
+  while (state->CurPlayer() == kChancePlayerId) {
+    state->ApplyRandomChance();
+  }
+}
+
+HanabiMove RandomLegalMove(const HanabiState& state, std::mt19937* rng) {
+  const auto moves = state.LegalMoves(state.CurPlayer());
+  return moves[(*rng)() % moves.size()];
+}
+
+// Positions of random games, kBatchSize for each move type, each paired with
+// the move made there (a placeholder for kDeal, dealt with
+// ApplyRandomChance).
+struct Positions {
+  std::unordered_map<int, std::vector<HanabiState>> states;
+  std::unordered_map<int, std::vector<HanabiMove>> moves;
+  std::vector<HanabiState> mixed;  // Player to move, any position.
+};
+
+Positions SamplePositions(const HanabiGame& game) {
+  const std::vector<HanabiMove::Type> types = {
+      HanabiMove::kPlay, HanabiMove::kDiscard, HanabiMove::kRevealColor,
+      HanabiMove::kRevealRank, HanabiMove::kDeal};
+  Positions positions;
+  std::mt19937 rng(1);
+  auto full = [&positions](HanabiMove::Type type) {
+    return positions.states[type].size() >= kBatchSize;
+  };
+  while (!std::all_of(types.begin(), types.end(), full) ||
+         positions.mixed.size() < kBatchSize) {
+    HanabiState state(&game);
+    DealAll(&state);
+    while (!state.IsTerminal()) {
+      if (positions.mixed.size() < kBatchSize) {
+        positions.mixed.push_back(state);
+      }
+      const HanabiMove move = RandomLegalMove(state, &rng);
+      if (!full(move.MoveType())) {
+        positions.states[move.MoveType()].push_back(state);
+        positions.moves[move.MoveType()].push_back(move);
+      }
+      state.ApplyMove(move);
+      if (state.CurPlayer() == kChancePlayerId) {
+        if (!full(HanabiMove::kDeal)) {
+          positions.states[HanabiMove::kDeal].push_back(state);
+          positions.moves[HanabiMove::kDeal].push_back(HanabiMove(
+              HanabiMove::kDeal, -1, -1, -1, -1));
+        }
+        DealAll(&state);
+      }
+    }
+  }
+  return positions;
+}
+
+bool Selected(const Options& options, const std::string& name) {
+  return name.find(options.filter) != std::string::npos;
+}
+
+void RunGameBenchmarks(const Options& options, int players,
+                       std::vector<Result>* results) {
+  const HanabiGame game = MakeGame(players, HanabiGame::kCardKnowledge);
+  const Positions positions = SamplePositions(game);
+  Result result = {"", players, -1, 1, 0, 0};
+
+  result.name = "NewStateAndDeal";
+  if (Selected(options, result.name)) {
+    Measure(options.min_time, [] {}, [&game] {
+      for (int i = 0; i < kBatchSize; ++i) {
+        HanabiState state(&game);
+        DealAll(&state);
+      }
+      return kBatchSize;
+    }, &result);
+    results->push_back(result);
+  }
+
+  const std::vector<std::pair<HanabiMove::Type, std::string>> types = {
+      {HanabiMove::kPlay, "Play"}, {HanabiMove::kDiscard, "Discard"},
+      {HanabiMove::kRevealColor, "RevealColor"},
+      {HanabiMove::kRevealRank, "RevealRank"}, {HanabiMove::kDeal, "Deal"}};
+  for (const auto& type : types) {
+    result.name = "ApplyMove/" + type.second;
+    if (!Selected(options, result.name)) {
+      continue;
+    }
+    const auto& states = positions.states.at(type.first);
+    const auto& moves = positions.moves.at(type.first);
+    std::vector<HanabiState> batch;
+    Measure(options.min_time, [&batch, &states] { batch = states; },
+            [&batch, &moves, &type] {
+      for (int i = 0; i < batch.size(); ++i) {
+        if (type.first == HanabiMove::kDeal) {
+          batch[i].ApplyRandomChance();
+        } else {
+          batch[i].ApplyMove(moves[i]);
+        }
+      }
+      return static_cast<int>(batch.size());
+    }, &result);
+    results->push_back(result);
+  }
+
+  result.name = "LegalMoves";
+  if (Selected(options, result.name)) {
+    size_t total = 0;
+    Measure(options.min_time, [] {}, [&positions, &total] {
+      for (const HanabiState& state : positions.mixed) {
+        total += state.LegalMoves(state.CurPlayer()).size();
+      }
+      return static_cast<int>(positions.mixed.size());
+    }, &result);
+    sink = sink + total;
+    results->push_back(result);
+  }
+
+  // Hashes computed from scratch, and keys shared by color permutations.
+  result.name = "Hash";
+  if (Selected(options, result.name)) {
+    uint64_t total = 0;
+    Measure(options.min_time, [] {}, [&positions, &total] {
+      for (const HanabiState& state : positions.mixed) {
+        total ^= state.Hash();
+      }
+      return static_cast<int>(positions.mixed.size());
+    }, &result);
+    sink = sink + total;
+    results->push_back(result);
+  }
+
+  result.name = "CanonicalKey";
+  if (Selected(options, result.name)) {
+    uint64_t total = 0;
+    Measure(options.min_time, [] {}, [&positions, &total] {
+      for (const HanabiState& state : positions.mixed) {
+        total ^= state.CanonicalKey();
+      }
+      return static_cast<int>(positions.mixed.size());
+    }, &result);
+    sink = sink + total;
+    results->push_back(result);
+  }
+
+  // Copies of mid-game states, as made by search at every node.
+  result.name = "CopyState";
+  if (Selected(options, result.name)) {
+    std::vector<HanabiState> batch;
+    Measure(options.min_time, [&batch] { batch.clear(); }, [&] {
+      batch = positions.mixed;
+      return static_cast<int>(batch.size());
+    }, &result);
+    results->push_back(result);
+  }
+
+  result.name = "CopyState/NoHistory";
+  if (Selected(options, result.name)) {
+    std::vector<HanabiState> no_history = positions.mixed;
+    for (HanabiState& state : no_history) {
+      state.SetHistoryMode(HanabiState::kNoHistory);
+    }
+    std::vector<HanabiState> batch;
+    Measure(options.min_time, [&batch] { batch.clear(); }, [&] {
+      batch = no_history;
+      return static_cast<int>(batch.size());
+    }, &result);
+    results->push_back(result);
+  }
+
+  // The same copies into recycled states, without allocating.
+  result.name = "CopyState/Arena";
+  if (Selected(options, result.name)) {
+    hanabi_learning_env::HanabiArena arena;
+    Measure(options.min_time, [&arena] { arena.Reset(); }, [&] {
+      for (const HanabiState& state : positions.mixed) {
+        arena.Clone(state);
+      }
+      return static_cast<int>(positions.mixed.size());
+    }, &result);
+    results->push_back(result);
+  }
+
+  // A move made and taken back per mid-game state, in place of a copy.
+  result.name = "ApplyAndUndoMove";
+  if (Selected(options, result.name)) {
+    std::vector<HanabiState> batch = positions.mixed;
+    std::vector<HanabiMove> moves;
+    std::mt19937 move_rng(2);
+    for (const HanabiState& state : batch) {
+      moves.push_back(RandomLegalMove(state, &move_rng));
+    }
+    HanabiState::UndoRecord undo;
+    Measure(options.min_time, [] {}, [&] {
+      for (int i = 0; i < batch.size(); ++i) {
+        batch[i].ApplyMove(moves[i], &undo);
+        batch[i].UndoMove(undo);
+      }
+      return static_cast<int>(batch.size());
+    }, &result);
+    sink = sink + batch.back().NumMoves();
+    results->push_back(result);
+  }
+
+  // A world per mid-game state, as drawn by determinizing search.
+  result.name = "SampleDeterminization";
+  if (Selected(options, result.name)) {
+    std::vector<HanabiState> worlds = positions.mixed;
+    hanabi_learning_env::CounterRng rng(1);
+    Measure(options.min_time, [] {}, [&] {
+      for (int i = 0; i < worlds.size(); ++i) {
+        const HanabiState& state = positions.mixed[i];
+        hanabi_learning_env::SampleDeterminization(state, state.CurPlayer(),
+                                                   &rng, &worlds[i]);
+      }
+      return static_cast<int>(worlds.size());
+    }, &result);
+    sink = sink + worlds.back().Deck().Size();
+    results->push_back(result);
+  }
+
+  // Single-threaded search iterations with random rollouts.
+  result.name = "Ismcts/Iteration";
+  if (Selected(options, result.name)) {
+    hanabi_learning_env::IsmctsConfig config;
+    config.max_iterations = 256;
+    config.num_threads = 1;
+    hanabi_learning_env::HanabiIsmcts search(config);
+    std::vector<int64_t> visits;
+    Measure(options.min_time, [] {}, [&] {
+      visits = search.Search(positions.mixed.front());
+      return static_cast<int>(search.NumIterations());
+    }, &result);
+    sink = sink + visits.front();
+    results->push_back(result);
+  }
+
+  result.name = "CompactState/Copy";
+  if (Selected(options, result.name)) {
+    const std::vector<HanabiCompactState> compact(positions.mixed.begin(),
+                                                  positions.mixed.end());
+    std::vector<HanabiCompactState> batch(compact.size());
+    Measure(options.min_time, [] {}, [&] {
+      batch = compact;
+      return static_cast<int>(batch.size());
+    }, &result);
+    sink = sink + batch.back().NumMoves();
+    results->push_back(result);
+  }
+}
+
+void RunObservationBenchmarks(const Options& options, int players,
+                              int observation_type,
+                              std::vector<Result>* results) {
+  const HanabiGame game = MakeGame(players, observation_type);
+  const Positions positions = SamplePositions(game);
+  const CanonicalObservationEncoder encoder(&game);
+  Result result = {"", players, observation_type, 1, 0, 0};
+
+  result.name = "HanabiObservation";
+  if (Selected(options, result.name)) {
+    size_t total = 0;
+    Measure(options.min_time, [] {}, [&positions, &total] {
+      for (const HanabiState& state : positions.mixed) {
+        total += HanabiObservation(state, state.CurPlayer()).DeckSize();
+      }
+      return static_cast<int>(positions.mixed.size());
+    }, &result);
+    sink = sink + total;
+    results->push_back(result);
+  }
+
+  result.name = "HanabiObservation/Arena";
+  if (Selected(options, result.name)) {
+    hanabi_learning_env::HanabiArena arena;
+    size_t total = 0;
+    Measure(options.min_time, [&arena] { arena.Reset(); }, [&] {
+      for (const HanabiState& state : positions.mixed) {
+        total += arena.Observe(state, state.CurPlayer())->DeckSize();
+      }
+      return static_cast<int>(positions.mixed.size());
+    }, &result);
+    sink = sink + total;
+    results->push_back(result);
+  }
+
+  result.name = "CanonicalEncode";
+  if (Selected(options, result.name)) {
+    std::vector<HanabiObservation> observations;
+    for (const HanabiState& state : positions.mixed) {
+      observations.emplace_back(state, state.CurPlayer());
+    }
+    size_t total = 0;
+    Measure(options.min_time, [] {}, [&observations, &encoder, &total] {
+      for (const HanabiObservation& observation : observations) {
+        total += encoder.Encode(observation).size();
+      }
+      return static_cast<int>(observations.size());
+    }, &result);
+    sink = sink + total;
+    results->push_back(result);
+  }
+
+  // Observing and encoding a state into a buffer, as the parallel env does,
+  // through a HanabiObservation and through a HanabiObservationView.
+  std::vector<int8_t> encoding(encoder.PackedLength() * 8);
+  result.name = "ObserveAndEncode";
+  if (Selected(options, result.name)) {
+    Measure(options.min_time, [] {}, [&positions, &encoder, &encoding] {
+      for (const HanabiState& state : positions.mixed) {
+        encoder.Encode(HanabiObservation(state, state.CurPlayer()),
+                       encoding.data());
+      }
+      return static_cast<int>(positions.mixed.size());
+    }, &result);
+    sink = sink + encoding[0];
+    results->push_back(result);
+  }
+
+  result.name = "ObservationView/Encode";
+  if (Selected(options, result.name)) {
+    Measure(options.min_time, [] {}, [&positions, &encoder, &encoding] {
+      for (const HanabiState& state : positions.mixed) {
+        encoder.Encode(HanabiObservationView(state, state.CurPlayer()),
+                       encoding.data());
+      }
+      return static_cast<int>(positions.mixed.size());
+    }, &result);
+    sink = sink + encoding[0];
+    results->push_back(result);
+  }
+}
+
+// Ops of the parallel env benchmarks are single states, so numbers compare
+// across --states.
+void RunParallelEnvBenchmarks(const Options& options, int players,
+                              int observation_type, int threads,
+                              std::vector<Result>* results) {
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#endif
+  const std::unordered_map<std::string, std::string> params = {
+      {"players", std::to_string(players)},
+      {"observation_type", std::to_string(observation_type)},
+      {"seed", "1"}};
+  HanabiParallelEnv env(params, options.states);
+  const int n_states = env.GetNumStates();
+  std::mt19937 rng(1);
+  std::vector<uint64_t> masks(n_states);
+  std::vector<int> moves(n_states);
+  int agent = 0;
+  // Picks a random legal move of the current agent in every state, after
+  // replacing finished games.
+  auto prepare_moves = [&] {
+    std::vector<int> terminal;
+    for (int state_idx = 0; state_idx < n_states; ++state_idx) {
+      if (env.GetStates()[state_idx].IsTerminal()) {
+        terminal.push_back(state_idx);
+      }
+    }
+    env.ResetStates(terminal, agent);
+    env.GetLegalMovesMasks(agent, masks.data());
+    for (int state_idx = 0; state_idx < n_states; ++state_idx) {
+      uint64_t mask = masks[state_idx];
+      for (int skip = rng() % hanabi_learning_env::PopCount(mask); skip > 0;
+           --skip) {
+        mask &= mask - 1;
+      }
+      moves[state_idx] = hanabi_learning_env::LowestSetBit(mask);
+    }
+  };
+  Result result = {"", players, observation_type, threads, 0, 0};
+
+  result.name = "ParallelEnv/ApplyBatchMove";
+  if (Selected(options, result.name)) {
+    Measure(options.min_time, prepare_moves, [&] {
+      env.ApplyBatchMove(moves, agent);
+      agent = (agent + 1) % players;
+      return n_states;
+    }, &result);
+    results->push_back(result);
+  }
+
+  // Allocating a batch observation per call, then into caller-owned
+  // buffers, which is what BatchEngine/Observe compares with.
+  result.name = "ParallelEnv/ObserveAgent";
+  if (Selected(options, result.name)) {
+    size_t total = 0;
+    Measure(options.min_time, [] {}, [&] {
+      total += env.ObserveAgent(agent).observation.size();
+      return n_states;
+    }, &result);
+    sink = sink + total;
+    results->push_back(result);
+  }
+
+  result.name = "ParallelEnv/ObserveAgent/Buffers";
+  if (Selected(options, result.name)) {
+    std::vector<int8_t> observation(
+        static_cast<size_t>(n_states) * env.GetObservationFlatLength());
+    std::vector<int8_t> legal_moves(
+        static_cast<size_t>(n_states) * env.MaxMoves());
+    std::vector<int16_t> scores(n_states);
+    std::vector<int8_t> done(n_states);
+    HanabiParallelEnv::HanabiBatchObservationBuffers buffers;
+    buffers.observation = observation.data();
+    buffers.legal_moves = legal_moves.data();
+    buffers.scores = scores.data();
+    buffers.done = done.data();
+    Measure(options.min_time, [] {}, [&] {
+      env.ObserveAgent(agent, buffers);
+      return n_states;
+    }, &result);
+    sink = sink + observation[0];
+    results->push_back(result);
+  }
+
+  // Beliefs after every step, so the counts are updated incrementally.
+  result.name = "ParallelEnv/Beliefs";
+  if (Selected(options, result.name)) {
+    std::vector<float> beliefs(
+        static_cast<size_t>(n_states) * env.GetBeliefLength());
+    Measure(options.min_time, [&] {
+      prepare_moves();
+      env.ApplyBatchMove(moves, agent);
+      agent = (agent + 1) % players;
+    }, [&] {
+      env.GetBeliefs(agent, beliefs.data());
+      return n_states;
+    }, &result);
+    sink = sink + beliefs[0];
+    results->push_back(result);
+  }
+}
+
+// Same ops and moves as the parallel env benchmarks, on the structure of
+// arrays engine, specialized for the configuration or not.
+void RunBatchEngineBenchmarks(const Options& options, int players,
+                              int observation_type, int threads,
+                              bool specialize, std::vector<Result>* results) {
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#endif
+  const std::unordered_map<std::string, std::string> params = {
+      {"players", std::to_string(players)},
+      {"observation_type", std::to_string(observation_type)},
+      {"seed", "1"}};
+  HanabiBatchEngine engine(params, options.states, /*first_stream=*/0,
+                           specialize);
+  if (specialize && !engine.IsSpecialized()) {
+    return;  // Same engine as the generic run.
+  }
+  const std::string prefix =
+      specialize ? "BatchEngine/Fixed/" : "BatchEngine/";
+  const int n_games = engine.NumGames();
+  const int max_moves = engine.GetGame().MaxMoves();
+  std::mt19937 rng(1);
+  std::vector<uint64_t> masks(n_games);
+  std::vector<int> moves(n_games);
+  std::vector<int8_t> observation(
+      static_cast<size_t>(n_games) * engine.ObservationLength());
+  std::vector<int8_t> legal_moves(static_cast<size_t>(n_games) * max_moves);
+  std::vector<int16_t> scores(n_games);
+  std::vector<int8_t> done(n_games);
+  std::vector<int16_t> rewards(n_games);
+  std::vector<int16_t> final_scores(n_games);
+  std::vector<int16_t> episode_lengths(n_games);
+  HanabiParallelEnv::HanabiBatchObservationBuffers buffers;
+  buffers.observation = observation.data();
+  buffers.legal_moves = legal_moves.data();
+  buffers.scores = scores.data();
+  buffers.done = done.data();
+  HanabiParallelEnv::HanabiStepResultBuffers step_results;
+  step_results.rewards = rewards.data();
+  step_results.final_scores = final_scores.data();
+  step_results.episode_lengths = episode_lengths.data();
+  // Picks a random legal move in every game; the engine replaces finished
+  // games itself.
+  auto prepare_moves = [&] {
+    engine.LegalMovesMasks(masks.data());
+    for (int game = 0; game < n_games; ++game) {
+      uint64_t mask = masks[game];
+      for (int skip = rng() % hanabi_learning_env::PopCount(mask); skip > 0;
+           --skip) {
+        mask &= mask - 1;
+      }
+      moves[game] = hanabi_learning_env::LowestSetBit(mask);
+    }
+  };
+  Result result = {"", players, observation_type, threads, 0, 0};
+
+  result.name = prefix + "Step";
+  if (Selected(options, result.name)) {
+    Measure(options.min_time, prepare_moves, [&] {
+      engine.Step(moves.data(), done.data(), step_results);
+      return n_games;
+    }, &result);
+    results->push_back(result);
+  }
+
+  result.name = prefix + "Observe";
+  if (Selected(options, result.name)) {
+    Measure(options.min_time, [] {}, [&] {
+      engine.Observe(buffers);
+      return n_games;
+    }, &result);
+    sink = sink + observation[0];
+    results->push_back(result);
+  }
+
+  result.name = prefix + "StepAndObserve";
+  if (Selected(options, result.name)) {
+    Measure(options.min_time, prepare_moves, [&] {
+      engine.StepAndObserve(moves.data(), buffers, step_results);
+      return n_games;
+    }, &result);
+    sink = sink + observation[0];
+    results->push_back(result);
+  }
+}
+
+void PrintTable(const std::vector<Result>& results) {
+  int name_width = std::strlen("benchmark");
+  for (const Result& result : results) {
+    name_width = std::max(name_width, static_cast<int>(result.name.size()));
+  }
+  std::printf("%-*s %7s %8s %7s %14s %14s\n", name_width, "benchmark",
+              "players", "obs_type", "threads", "ns/op", "ops/sec");
+  for (const Result& result : results) {
+    std::printf("%-*s %7d %8s %7d %14.1f %14.0f\n", name_width,
+                result.name.c_str(),
+                result.players,
+                result.observation_type < 0
+                    ? "-"
+                    : std::to_string(result.observation_type).c_str(),
+                result.threads, result.NsPerOp(), result.OpsPerSec());
+  }
+}
+
+void WriteJson(const std::vector<Result>& results, const Options& options,
+               std::ostream& out) {
+  char date[32];
+  const std::time_t now = std::time(nullptr);
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+  out << "{\n  \"context\": {\"date\": \"" << date
+      << "\", \"states\": " << options.states
+      << ", \"min_time\": " << options.min_time << "},\n";
+  out << "  \"benchmarks\": [\n";
+  for (int i = 0; i < results.size(); ++i) {
+    const Result& result = results[i];
+    out << "    {\"name\": \"" << result.name
+        << "\", \"players\": " << result.players
+        << ", \"observation_type\": " << result.observation_type
+        << ", \"threads\": " << result.threads
+        << ", \"ops\": " << result.ops
+        << ", \"seconds\": " << result.seconds
+        << ", \"ns_per_op\": " << result.NsPerOp()
+        << ", \"ops_per_sec\": " << result.OpsPerSec() << "}"
+        << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  out << "  ]\n}\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const Options options = ParseArguments(argc, argv);
+  std::vector<Result> results;
+  for (int players : options.players) {
+    RunGameBenchmarks(options, players, &results);
+    for (int observation_type : options.observation_types) {
+      RunObservationBenchmarks(options, players, observation_type, &results);
+      for (int threads : options.threads) {
+        RunParallelEnvBenchmarks(options, players, observation_type, threads,
+                                 &results);
+        RunBatchEngineBenchmarks(options, players, observation_type, threads,
+                                 /*specialize=*/false, &results);
+        RunBatchEngineBenchmarks(options, players, observation_type, threads,
+                                 /*specialize=*/true, &results);
+      }
+    }
+  }
+
+  if (options.json.empty()) {
+    PrintTable(results);
+  } else if (options.json == "-") {
+    WriteJson(results, options, std::cout);
+  } else {
+    std::ofstream out(options.json);
+    WriteJson(results, options, out);
+  }
+  return 0;
+}
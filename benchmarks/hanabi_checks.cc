@@ -0,0 +1,608 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Consistency checks of the engines the benchmarks compare: runs each
+// concurrent or specialized path against a reference over many random steps
+// and exits non-zero on the first mismatches. Registered with ctest.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "canonical_encoders.h"
+#include "hanabi_async_env_pool.h"
+#include "hanabi_batch_engine.h"
+#include "hanabi_compact_state.h"
+#include "hanabi_game.h"
+#include "hanabi_move.h"
+#include "hanabi_observation.h"
+#include "hanabi_parallel_env.h"
+#include "hanabi_state.h"
+#include "util.h"
+
+namespace {
+
+using hanabi_learning_env::CanonicalObservationEncoder;
+using hanabi_learning_env::HanabiAsyncEnvPool;
+using hanabi_learning_env::HanabiBatchEngine;
+using hanabi_learning_env::CounterRng;
+using hanabi_learning_env::HanabiCompactState;
+using hanabi_learning_env::HanabiCompletionQueue;
+using hanabi_learning_env::HanabiGame;
+using hanabi_learning_env::HanabiMove;
+using hanabi_learning_env::HanabiObservation;
+using hanabi_learning_env::HanabiParallelEnv;
+using hanabi_learning_env::HanabiState;
+
+// Failed CHECKs of the check being run, which returns early once there are.
+int failures = 0;
+
+#define CHECK(condition)                                                  \
+  do {                                                                    \
+    if (!(condition)) {                                                   \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,         \
+                   __LINE__, #condition);                                 \
+      ++failures;                                                         \
+    }                                                                     \
+  } while (0)
+
+// Caller-owned step and observation buffers of n rows.
+struct Buffers {
+  Buffers(int n, int observation_len, int max_moves)
+      : observation(static_cast<size_t>(n) * observation_len),
+        legal_moves(static_cast<size_t>(n) * max_moves),
+        scores(n),
+        done(n),
+        rewards(n),
+        final_scores(n),
+        episode_lengths(n) {
+    observation_buffers.observation = observation.data();
+    observation_buffers.legal_moves = legal_moves.data();
+    observation_buffers.scores = scores.data();
+    observation_buffers.done = done.data();
+    result_buffers.rewards = rewards.data();
+    result_buffers.final_scores = final_scores.data();
+    result_buffers.episode_lengths = episode_lengths.data();
+  }
+
+  std::vector<int8_t> observation;
+  std::vector<int8_t> legal_moves;
+  std::vector<int16_t> scores;
+  std::vector<int8_t> done;
+  std::vector<int16_t> rewards;
+  std::vector<int16_t> final_scores;
+  std::vector<int16_t> episode_lengths;
+  HanabiParallelEnv::HanabiBatchObservationBuffers observation_buffers;
+  HanabiParallelEnv::HanabiStepResultBuffers result_buffers;
+};
+
+// Whether rows [begin, begin + n) of two sets of buffers agree.
+bool SameRows(const HanabiParallelEnv::HanabiBatchObservationBuffers& a,
+              const HanabiParallelEnv::HanabiBatchObservationBuffers& b,
+              int begin, int n, int observation_len, int max_moves) {
+  for (int64_t i = static_cast<int64_t>(begin) * observation_len;
+       i < static_cast<int64_t>(begin + n) * observation_len; ++i) {
+    if (a.observation[i] != b.observation[i]) return false;
+  }
+  for (int64_t i = static_cast<int64_t>(begin) * max_moves;
+       i < static_cast<int64_t>(begin + n) * max_moves; ++i) {
+    if (a.legal_moves[i] != b.legal_moves[i]) return false;
+  }
+  for (int i = begin; i < begin + n; ++i) {
+    if (a.scores[i] != b.scores[i] || a.done[i] != b.done[i]) return false;
+  }
+  return true;
+}
+
+// Whether the step results of the first n rows of two sets of buffers agree.
+bool SameResults(const Buffers& a, const Buffers& b, int n) {
+  return std::equal(a.rewards.begin(), a.rewards.begin() + n,
+                    b.rewards.begin()) &&
+         std::equal(a.final_scores.begin(), a.final_scores.begin() + n,
+                    b.final_scores.begin()) &&
+         std::equal(a.episode_lengths.begin(), a.episode_lengths.begin() + n,
+                    b.episode_lengths.begin());
+}
+
+// Uniformly random legal move of every row of buffers.
+void PickMoves(const int8_t* legal_moves, int n, int max_moves,
+               std::mt19937* rng, int* moves) {
+  for (int i = 0; i < n; ++i) {
+    const int8_t* legal = legal_moves + static_cast<int64_t>(i) * max_moves;
+    std::vector<int> uids;
+    for (int uid = 0; uid < max_moves; ++uid) {
+      if (legal[uid]) uids.push_back(uid);
+    }
+    moves[i] = uids[(*rng)() % uids.size()];
+  }
+}
+
+// Deals a card, given as color * num_ranks + rank, at a chance node.
+void DealCard(const HanabiGame& game, int card, HanabiState* state) {
+  state->ApplyMove(HanabiMove(HanabiMove::kDeal, -1, -1,
+                              card / game.NumRanks(), card % game.NumRanks()));
+}
+
+// A HanabiState with the hands of a game the engine has just started.
+HanabiState NewMirrorState(const HanabiBatchEngine& engine, int game) {
+  const HanabiGame& hanabi_game = engine.GetGame();
+  HanabiState state(&hanabi_game, engine.CurPlayer(game));
+  for (int player = 0; player < hanabi_game.NumPlayers(); ++player) {
+    for (int slot = 0; slot < engine.HandSize(game, player); ++slot) {
+      DealCard(hanabi_game, engine.Card(game, player, slot), &state);
+    }
+  }
+  return state;
+}
+
+// Applies a random legal move, or a random chance outcome at a chance node.
+void ApplyRandomMove(std::mt19937* rng, HanabiState* state,
+                     HanabiState::UndoRecord* undo = nullptr) {
+  if (state->CurPlayer() == hanabi_learning_env::kChancePlayerId) {
+    state->ApplyRandomChance(undo);
+    return;
+  }
+  const std::vector<HanabiMove> moves = state->LegalMoves(state->CurPlayer());
+  state->ApplyMove(moves[(*rng)() % moves.size()], undo);
+}
+
+// Everything about a state which UndoMove must give back: the position, the
+// counters and the random stream, through the compact state of a copy
+// without history, and the aggregates and history items besides.
+struct StateSnapshot {
+  explicit StateSnapshot(const HanabiState& state)
+      : text(state.ToString()),
+        compact(WithoutHistory(state)),
+        hash(state.Hash()),
+        playable_mask(state.PlayableMask()) {
+    const HanabiGame& game = *state.ParentGame();
+    for (int color = 0; color < game.NumColors(); ++color) {
+      for (int rank = 0; rank < game.NumRanks(); ++rank) {
+        counts.push_back(state.DiscardCount(color, rank));
+        counts.push_back(state.RemainingCount(color, rank));
+      }
+    }
+    for (const auto& item : state.MoveHistory()) {
+      history.push_back(item.ToString());
+    }
+  }
+
+  static HanabiState WithoutHistory(HanabiState state) {
+    state.SetHistoryMode(HanabiState::kNoHistory);
+    return state;
+  }
+
+  // Whether other is the same state. If history_may_shrink, as UndoMove
+  // allows in kRecentHistory, other's history need only be a suffix of this
+  // one's.
+  bool Restores(const StateSnapshot& other, bool history_may_shrink) const {
+    if (text != other.text ||
+        std::memcmp(&compact, &other.compact, sizeof(compact)) != 0 ||
+        hash != other.hash || playable_mask != other.playable_mask ||
+        counts != other.counts) {
+      return false;
+    }
+    if (!history_may_shrink) {
+      return history == other.history;
+    }
+    return other.history.size() <= history.size() &&
+           std::equal(other.history.begin(), other.history.end(),
+                      history.end() - other.history.size());
+  }
+
+  std::string text;
+  HanabiCompactState compact;
+  uint64_t hash;
+  uint32_t playable_mask;
+  std::vector<int> counts;
+  std::vector<std::string> history;
+};
+
+// Many producers push through a ring much smaller than the number of items
+// in flight; every item must come out exactly once, in order per producer.
+void CheckCompletionQueue() {
+  const int kProducers = 8;
+  const int kItemsPerProducer = 20000;
+  HanabiCompletionQueue queue(4);
+  std::vector<std::thread> producers;
+  for (int producer = 0; producer < kProducers; ++producer) {
+    producers.emplace_back([&queue, producer] {
+      for (int i = 0; i < kItemsPerProducer; ++i) {
+        queue.Push(producer * kItemsPerProducer + i);
+      }
+    });
+  }
+  std::vector<int> next(kProducers, 0);
+  for (int popped = 0; popped < kProducers * kItemsPerProducer; ++popped) {
+    const int item = queue.Pop();
+    const int producer = item / kItemsPerProducer;
+    CHECK(producer >= 0 && producer < kProducers);
+    if (producer < 0 || producer >= kProducers) break;
+    CHECK(item % kItemsPerProducer == next[producer]);
+    next[producer] = item % kItemsPerProducer + 1;
+  }
+  for (auto& thread : producers) {
+    thread.join();
+  }
+  int item = -1;
+  CHECK(!queue.TryPop(&item));
+}
+
+// Every group of the pool against a HanabiParallelEnv over the same states,
+// with the seed left unspecified so that the pool has to share one.
+void CheckAsyncEnvPool() {
+  const int kGroups = 24;
+  const int kStatesPerGroup = 3;
+  const int kReceives = 6000;
+  HanabiAsyncEnvPool pool({{"players", "3"}}, kGroups, kStatesPerGroup);
+  const auto params = pool.GetGame().Parameters();
+  const int observation_len = pool.ObservationLength();
+  const int max_moves = pool.GetGame().MaxMoves();
+  std::vector<std::unique_ptr<HanabiParallelEnv>> references;
+  std::vector<std::unique_ptr<Buffers>> reference_buffers;
+  std::vector<int> agents(kGroups, 0);
+  for (int group = 0; group < kGroups; ++group) {
+    references.emplace_back(new HanabiParallelEnv(
+        params, kStatesPerGroup, group * kStatesPerGroup));
+    reference_buffers.emplace_back(
+        new Buffers(kStatesPerGroup, observation_len, max_moves));
+    references.back()->ObserveAgent(
+        0, reference_buffers.back()->observation_buffers);
+  }
+  std::mt19937 rng(1);
+  std::vector<int> moves(kStatesPerGroup);
+  for (int receive = 0; receive < kReceives; ++receive) {
+    const int group = pool.Recv();
+    Buffers& reference = *reference_buffers[group];
+    CHECK(pool.CurrentAgent(group) == agents[group]);
+    CHECK(SameRows(pool.Observation(group), reference.observation_buffers, 0,
+                   kStatesPerGroup, observation_len, max_moves));
+    if (failures > 0) return;  // The moves might be illegal in the pool.
+    PickMoves(reference.legal_moves.data(), kStatesPerGroup, max_moves, &rng,
+              moves.data());
+    references[group]->StepAndObserve(moves.data(), agents[group],
+                                      /*packed=*/false,
+                                      reference.observation_buffers,
+                                      reference.result_buffers);
+    agents[group] = (agents[group] + 1) % pool.GetGame().NumPlayers();
+    pool.Send(moves.data(), group);
+  }
+}
+
+// The generic batch engine against HanabiStates replaying the same moves and
+// deals, observed by the current player through CanonicalObservationEncoder.
+void CheckBatchEngineEncoding() {
+  const int kGames = 16;
+  const int kSteps = 400;
+  for (int players = 2; players <= 5; ++players) {
+    for (int observation_type = 0; observation_type <= 2; ++observation_type) {
+      HanabiBatchEngine engine(
+          {{"players", std::to_string(players)},
+           {"observation_type", std::to_string(observation_type)},
+           {"seed", "5"}},
+          kGames, /*first_stream=*/0, /*specialize=*/false);
+      const HanabiGame& game = engine.GetGame();
+      const CanonicalObservationEncoder encoder(&game);
+      const int observation_len = engine.ObservationLength();
+      const int max_moves = game.MaxMoves();
+      std::vector<HanabiState> states;
+      std::vector<int> lengths(kGames, 0);
+      for (int g = 0; g < kGames; ++g) {
+        states.push_back(NewMirrorState(engine, g));
+      }
+      Buffers buffers(kGames, observation_len, max_moves);
+      engine.Observe(buffers.observation_buffers);
+      std::mt19937 rng(players * 3 + observation_type);
+      std::vector<int> moves(kGames);
+      for (int step = 0; step < kSteps; ++step) {
+        for (int g = 0; g < kGames; ++g) {
+          const HanabiState& state = states[g];
+          const std::vector<int> expected = encoder.Encode(
+              HanabiObservation(state, state.CurPlayer()));
+          const int8_t* row =
+              &buffers.observation[static_cast<size_t>(g) * observation_len];
+          CHECK(static_cast<int>(expected.size()) == observation_len &&
+                std::equal(expected.begin(), expected.end(), row));
+          const uint64_t mask = state.LegalMovesMask(state.CurPlayer());
+          for (int uid = 0; uid < max_moves; ++uid) {
+            CHECK(buffers.legal_moves[static_cast<size_t>(g) * max_moves +
+                                      uid] == ((mask >> uid) & 1));
+          }
+          CHECK(buffers.scores[g] == state.Score());
+          if (failures > 0) return;
+        }
+        PickMoves(buffers.legal_moves.data(), kGames, max_moves, &rng,
+                  moves.data());
+        engine.StepAndObserve(moves.data(), buffers.observation_buffers,
+                              buffers.result_buffers);
+        for (int g = 0; g < kGames; ++g) {
+          HanabiState& state = states[g];
+          const int player = state.CurPlayer();
+          state.ApplyMove(game.GetMove(moves[g]));
+          ++lengths[g];
+          CHECK(buffers.done[g] == state.IsTerminal());
+          if (state.IsTerminal()) {
+            CHECK(buffers.final_scores[g] == state.Score());
+            CHECK(buffers.episode_lengths[g] == lengths[g]);
+            state = NewMirrorState(engine, g);
+            lengths[g] = 0;
+            continue;
+          }
+          if (state.CurPlayer() == hanabi_learning_env::kChancePlayerId) {
+            DealCard(game,
+                     engine.Card(g, player, engine.HandSize(g, player) - 1),
+                     &state);
+          }
+          CHECK(state.CurPlayer() == engine.CurPlayer(g));
+        }
+      }
+    }
+  }
+}
+
+// The engine specialized for a fixed configuration against the generic one,
+// from the same seed and streams, stepping alone or fused with observing.
+void CheckFixedBatchEngine() {
+  const int kGames = 301;
+  const int kSteps = 200;
+  for (int players = 2; players <= 5; ++players) {
+    for (int observation_type = 0; observation_type <= 2; ++observation_type) {
+      for (const char* random_start : {"false", "true"}) {
+        const std::unordered_map<std::string, std::string> params = {
+            {"players", std::to_string(players)},
+            {"observation_type", std::to_string(observation_type)},
+            {"random_start_player", random_start},
+            {"seed", "7"}};
+        HanabiBatchEngine fixed(params, kGames, /*first_stream=*/5,
+                                /*specialize=*/true);
+        HanabiBatchEngine generic(params, kGames, /*first_stream=*/5,
+                                  /*specialize=*/false);
+        CHECK(fixed.IsSpecialized());
+        CHECK(fixed.ObservationLength() == generic.ObservationLength());
+        if (failures > 0) return;
+        const int observation_len = generic.ObservationLength();
+        const int max_moves = generic.GetGame().MaxMoves();
+        Buffers fixed_buffers(kGames, observation_len, max_moves);
+        Buffers generic_buffers(kGames, observation_len, max_moves);
+        fixed.Observe(fixed_buffers.observation_buffers);
+        generic.Observe(generic_buffers.observation_buffers);
+        std::mt19937 rng(players * 10 + observation_type);
+        std::vector<uint64_t> fixed_masks(kGames);
+        std::vector<uint64_t> generic_masks(kGames);
+        std::vector<int> moves(kGames);
+        for (int step = 0; step < kSteps; ++step) {
+          CHECK(SameRows(fixed_buffers.observation_buffers,
+                         generic_buffers.observation_buffers, 0, kGames,
+                         observation_len, max_moves));
+          fixed.LegalMovesMasks(fixed_masks.data());
+          generic.LegalMovesMasks(generic_masks.data());
+          CHECK(fixed_masks == generic_masks);
+          for (int game = 0; game < kGames; ++game) {
+            CHECK(fixed.CurPlayer(game) == generic.CurPlayer(game));
+            CHECK(fixed.Score(game) == generic.Score(game));
+            CHECK(fixed.DeckSize(game) == generic.DeckSize(game));
+            for (int player = 0; player < players; ++player) {
+              CHECK(fixed.HandSize(game, player) ==
+                    generic.HandSize(game, player));
+              for (int slot = 0; slot < generic.GetGame().HandSize(); ++slot) {
+                CHECK(fixed.Card(game, player, slot) ==
+                      generic.Card(game, player, slot));
+              }
+            }
+          }
+          if (failures > 0) return;
+          PickMoves(generic_buffers.legal_moves.data(), kGames, max_moves,
+                    &rng, moves.data());
+          if (step % 2 == 0) {
+            fixed.StepAndObserve(moves.data(),
+                                 fixed_buffers.observation_buffers,
+                                 fixed_buffers.result_buffers);
+            generic.StepAndObserve(moves.data(),
+                                   generic_buffers.observation_buffers,
+                                   generic_buffers.result_buffers);
+          } else {
+            fixed.Step(moves.data(), fixed_buffers.done.data(),
+                       fixed_buffers.result_buffers);
+            generic.Step(moves.data(), generic_buffers.done.data(),
+                         generic_buffers.result_buffers);
+            CHECK(fixed_buffers.done == generic_buffers.done);
+            fixed.Observe(fixed_buffers.observation_buffers);
+            generic.Observe(generic_buffers.observation_buffers);
+          }
+          CHECK(SameResults(fixed_buffers, generic_buffers, kGames));
+        }
+      }
+    }
+  }
+}
+
+// Applying a few moves and chance outcomes with undo records and taking them
+// back in reverse order restores the state exactly, in every history mode,
+// with and without the state's own random stream and incremental hash. In
+// kRecentHistory the history may lose its older items.
+void CheckUndoRoundTrip() {
+  const int kEpisodes = 20;
+  const int kDepth = 4;
+  const HanabiState::HistoryMode modes[] = {HanabiState::kFullHistory,
+                                            HanabiState::kRecentHistory,
+                                            HanabiState::kNoHistory};
+  std::mt19937 rng(3);
+  std::vector<HanabiState::UndoRecord> undos(kDepth);
+  for (int players = 2; players <= 5; ++players) {
+    HanabiGame game({{"players", std::to_string(players)}, {"seed", "3"}});
+    for (const HanabiState::HistoryMode mode : modes) {
+      for (int episode = 0; episode < kEpisodes; ++episode) {
+        HanabiState state(&game);
+        state.SetHistoryMode(mode);
+        if (episode % 2 == 0) {
+          state.SetRandomStream(CounterRng(3, players, episode));
+        }
+        state.SetIncrementalHash(episode % 4 < 2);
+        while (!state.IsTerminal()) {
+          const StateSnapshot before(state);
+          int depth = 0;
+          for (; depth < kDepth && !state.IsTerminal(); ++depth) {
+            ApplyRandomMove(&rng, &state, &undos[depth]);
+          }
+          while (depth > 0) {
+            state.UndoMove(undos[--depth]);
+          }
+          CHECK(before.Restores(StateSnapshot(state),
+                                mode == HanabiState::kRecentHistory));
+          if (failures > 0) return;
+          ApplyRandomMove(&rng, &state);
+        }
+      }
+    }
+  }
+}
+
+// The hash ApplyMove and UndoMove keep up to date equals the hash computed
+// from scratch.
+void CheckIncrementalHash() {
+  const int kEpisodes = 30;
+  std::mt19937 rng(4);
+  HanabiState::UndoRecord undo;
+  for (int players = 2; players <= 5; ++players) {
+    HanabiGame game({{"players", std::to_string(players)}, {"seed", "4"}});
+    for (int episode = 0; episode < kEpisodes; ++episode) {
+      HanabiState state(&game);
+      state.SetIncrementalHash(true);
+      while (!state.IsTerminal()) {
+        ApplyRandomMove(&rng, &state);
+        HanabiState scratch(state);
+        scratch.SetIncrementalHash(false);
+        CHECK(state.Hash() == scratch.Hash());
+        HanabiState undone(state);
+        if (!undone.IsTerminal()) {
+          ApplyRandomMove(&rng, &undone, &undo);
+          undone.UndoMove(undo);
+          CHECK(undone.Hash() == scratch.Hash());
+        }
+        if (failures > 0) return;
+      }
+    }
+  }
+}
+
+// A compact state plays the same game as a HanabiState from the same random
+// stream, and converting either way gives the other back.
+void CheckCompactStateRoundTrip() {
+  const int kEpisodes = 30;
+  std::mt19937 rng(5);
+  for (int players = 2; players <= 5; ++players) {
+    for (int observation_type = 0; observation_type <= 2; ++observation_type) {
+      HanabiGame game({{"players", std::to_string(players)},
+                       {"observation_type", std::to_string(observation_type)},
+                       {"seed", "5"}});
+      const CanonicalObservationEncoder encoder(&game);
+      for (int episode = 0; episode < kEpisodes; ++episode) {
+        HanabiState state(&game);
+        state.SetRandomStream(CounterRng(5, players, episode));
+        HanabiCompactState compact(state);
+        while (!state.IsTerminal()) {
+          if (state.CurPlayer() == hanabi_learning_env::kChancePlayerId) {
+            state.ApplyRandomChance();
+            compact.ApplyRandomChance();
+          } else {
+            CHECK(state.LegalMovesMask(state.CurPlayer()) ==
+                  compact.LegalMovesMask(compact.CurPlayer()));
+            const std::vector<HanabiMove> moves =
+                state.LegalMoves(state.CurPlayer());
+            const HanabiMove move = moves[rng() % moves.size()];
+            state.ApplyMove(move);
+            compact.ApplyMove(move);
+          }
+          const HanabiCompactState converted(state);
+          CHECK(std::memcmp(&converted, &compact, sizeof(compact)) == 0);
+          const HanabiState back = compact.ToState();
+          CHECK(back.ToString() == state.ToString());
+          CHECK(back.Hash() == state.Hash());
+          CHECK(back.FirstPlayerMoveIndex() == state.FirstPlayerMoveIndex());
+          const HanabiCompactState again(back);
+          CHECK(std::memcmp(&again, &compact, sizeof(compact)) == 0);
+          if (state.CurPlayer() >= 0) {
+            for (int observer = 0; observer < players; ++observer) {
+              CHECK(encoder.Encode(HanabiObservation(back, observer)) ==
+                    encoder.Encode(HanabiObservation(state, observer)));
+            }
+          }
+          if (failures > 0) return;
+        }
+      }
+    }
+  }
+}
+
+// Two games played with the same moves and deals, with the colors of one
+// relabeled by a random permutation, share their canonical keys.
+void CheckCanonicalKey() {
+  const int kEpisodes = 30;
+  std::mt19937 rng(6);
+  for (int players = 2; players <= 5; ++players) {
+    HanabiGame game({{"players", std::to_string(players)}, {"seed", "6"}});
+    std::vector<int> color_map(game.NumColors());
+    for (int color = 0; color < game.NumColors(); ++color) {
+      color_map[color] = color;
+    }
+    for (int episode = 0; episode < kEpisodes; ++episode) {
+      std::shuffle(color_map.begin(), color_map.end(), rng);
+      auto relabel = [&color_map](HanabiMove move) {
+        return move.Color() < 0
+                   ? move
+                   : HanabiMove(move.MoveType(), move.CardIndex(),
+                                move.TargetOffset(), color_map[move.Color()],
+                                move.Rank());
+      };
+      HanabiState state(&game);
+      HanabiState permuted(&game);
+      while (!state.IsTerminal()) {
+        ApplyRandomMove(&rng, &state);
+        permuted.ApplyMove(relabel(state.MoveHistory().back().move));
+        CHECK(state.CanonicalKey() == permuted.CanonicalKey());
+        if (failures > 0) return;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  const std::vector<std::pair<const char*, void (*)()>> checks = {
+      {"CompletionQueue", CheckCompletionQueue},
+      {"AsyncEnvPool", CheckAsyncEnvPool},
+      {"BatchEngineEncoding", CheckBatchEngineEncoding},
+      {"FixedBatchEngine", CheckFixedBatchEngine},
+      {"UndoRoundTrip", CheckUndoRoundTrip},
+      {"IncrementalHash", CheckIncrementalHash},
+      {"CompactStateRoundTrip", CheckCompactStateRoundTrip},
+      {"CanonicalKey", CheckCanonicalKey}};
+  int failed_checks = 0;
+  for (const auto& check : checks) {
+    failures = 0;
+    check.second();
+    std::printf("%-24s %s\n", check.first, failures == 0 ? "ok" : "FAILED");
+    failed_checks += failures != 0;
+  }
+  return failed_checks == 0 ? 0 : 1;
+}
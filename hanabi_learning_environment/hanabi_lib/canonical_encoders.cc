@@ -19,6 +19,7 @@
 #include <vector>
 
 #include "canonical_encoders.h"
+#include "util.h"
 
 namespace hanabi_learning_env {
 
@@ -40,6 +41,61 @@ const HanabiHistoryItem* GetLastNonDealMove(
   return it == past_moves.end() ? nullptr : &(*it);
 }
 
+// Hand of the player at offset from the observer. Encoders only read the
+// observer's own hand for its size and card knowledge, so the unhidden hands
+// of a view encode the same as the hands of a HanabiObservation.
+const HanabiHand& ObservedHand(const HanabiObservation& obs, int offset) {
+  return obs.Hands()[offset];
+}
+
+const HanabiHand& ObservedHand(const HanabiObservationView& obs, int offset) {
+  return obs.Hand(offset);
+}
+
+// Adapts a raw, caller-owned buffer to the indexed writes of the section
+// encoders below, which otherwise write into a std::vector.
+template <typename T>
+class BufferEncoding {
+ public:
+  explicit BufferEncoding(T* data) : data_(data) {}
+  T& operator[](int index) { return data_[index]; }
+
+ private:
+  T* data_;
+};
+
+// Adapts a byte buffer to the section encoders, packing eight entries into
+// each byte, least significant bit first. That is the bit order of
+// numpy.unpackbits(..., bitorder='little').
+class PackedBitsEncoding {
+ public:
+  class BitReference {
+   public:
+    BitReference(uint8_t* byte, uint8_t mask) : byte_(byte), mask_(mask) {}
+    BitReference& operator=(int value) {
+      if (value) {
+        *byte_ |= mask_;
+      } else {
+        *byte_ &= ~mask_;
+      }
+      return *this;
+    }
+
+   private:
+    uint8_t* byte_;
+    uint8_t mask_;
+  };
+
+  explicit PackedBitsEncoding(uint8_t* data) : data_(data) {}
+  BitReference operator[](int index) {
+    return BitReference(data_ + (index >> 3),
+                        static_cast<uint8_t>(1 << (index & 7)));
+  }
+
+ private:
+  uint8_t* data_;
+};
+
 int BitsPerCard(const HanabiGame& game) {
   return game.NumColors() * game.NumRanks();
 }
@@ -54,47 +110,53 @@ int HandsSectionLength(const HanabiGame& game) {
          game.NumPlayers();
 }
 
+int HandCardsLength(const HanabiGame& game) {
+  return game.HandSize() * BitsPerCard(game);
+}
+
+// Encodes the cards of a single (fully visible) hand, one-hot per card.
+// Always advances by HandCardsLength(game); the bits for cards missing from
+// the hand are left empty.
+// Returns the number of entries written to the encoding.
+template <class Encoding>
+int EncodeHandCards(const HanabiGame& game, const HanabiHand& hand,
+                    int start_offset, Encoding* encoding) {
+  int bits_per_card = BitsPerCard(game);
+  int num_ranks = game.NumRanks();
+
+  int offset = start_offset;
+  for (const HanabiCard& card : hand.Cards()) {
+    // Only a player's own cards can be invalid/unobserved.
+    assert(card.IsValid());
+    assert(card.Color() < game.NumColors());
+    assert(card.Rank() < num_ranks);
+    (*encoding)[offset + CardIndex(card.Color(), card.Rank(), num_ranks)] = 1;
+    offset += bits_per_card;
+  }
+  return HandCardsLength(game);
+}
+
 // Enocdes cards in all other player's hands (excluding our unknown hand),
 // and whether the hand is missing a card for all players (when deck is empty.)
 // Each card in a hand is encoded with a one-hot representation using
 // <num_colors> * <num_ranks> bits (25 bits in a standard game) per card.
 // Returns the number of entries written to the encoding.
-int EncodeHands(const HanabiGame& game, const HanabiObservation& obs,
-                int start_offset, std::vector<int>* encoding) {
-  int bits_per_card = BitsPerCard(game);
-  int num_ranks = game.NumRanks();
+template <class Observation, class Encoding>
+int EncodeHands(const HanabiGame& game, const Observation& obs,
+                int start_offset, Encoding* encoding) {
   int num_players = game.NumPlayers();
-  int hand_size = game.HandSize();
 
   int offset = start_offset;
-  const std::vector<HanabiHand>& hands = obs.Hands();
-  assert(hands.size() == num_players);
   for (int player = 1; player < num_players; ++player) {
-    const std::vector<HanabiCard>& cards = hands[player].Cards();
-    int num_cards = 0;
-
-    for (const HanabiCard& card : cards) {
-      // Only a player's own cards can be invalid/unobserved.
-      assert(card.IsValid());
-      assert(card.Color() < game.NumColors());
-      assert(card.Rank() < num_ranks);
-      (*encoding)[offset + CardIndex(card.Color(), card.Rank(), num_ranks)] = 1;
-
-      ++num_cards;
-      offset += bits_per_card;
-    }
-
     // A player's hand can have fewer cards than the initial hand size.
-    // Leave the bits for the absent cards empty (adjust the offset to skip
-    // bits for the missing cards).
-    if (num_cards < hand_size) {
-      offset += (hand_size - num_cards) * bits_per_card;
-    }
+    // The bits for the absent cards are left empty.
+    offset += EncodeHandCards(game, ObservedHand(obs, player), offset,
+                              encoding);
   }
 
   // For each player, set a bit if their hand is missing a card.
   for (int player = 0; player < num_players; ++player) {
-    if (hands[player].Cards().size() < game.HandSize()) {
+    if (ObservedHand(obs, player).Cards().size() < game.HandSize()) {
       (*encoding)[offset + player] = 1;
     }
   }
@@ -120,8 +182,9 @@ int BoardSectionLength(const HanabiGame& game) {
 // We note several features use a thermometer representation instead of one-hot.
 // For example, life tokens could be: 000 (0), 100 (1), 110 (2), 111 (3).
 // Returns the number of entries written to the encoding.
-int EncodeBoard(const HanabiGame& game, const HanabiObservation& obs,
-                int start_offset, std::vector<int>* encoding) {
+template <class Observation, class Encoding>
+int EncodeBoard(const HanabiGame& game, const Observation& obs,
+                int start_offset, Encoding* encoding) {
   int num_colors = game.NumColors();
   int num_ranks = game.NumRanks();
   int num_players = game.NumPlayers();
@@ -185,20 +248,16 @@ int DiscardSectionLength(const HanabiGame& game) { return game.MaxDeckSize(); }
 //   - one of the second highest rank have been discarded
 //   - the highest rank card has been discarded
 // Returns the number of entries written to the encoding.
-int EncodeDiscards(const HanabiGame& game, const HanabiObservation& obs,
-                   int start_offset, std::vector<int>* encoding) {
+template <class Observation, class Encoding>
+int EncodeDiscards(const HanabiGame& game, const Observation& obs,
+                   int start_offset, Encoding* encoding) {
   int num_colors = game.NumColors();
   int num_ranks = game.NumRanks();
 
   int offset = start_offset;
-  std::vector<int> discard_counts(num_colors * num_ranks, 0);
-  for (const HanabiCard& card : obs.DiscardPile()) {
-    ++discard_counts[card.Color() * num_ranks + card.Rank()];
-  }
-
   for (int c = 0; c < num_colors; ++c) {
     for (int r = 0; r < num_ranks; ++r) {
-      int num_discarded = discard_counts[c * num_ranks + r];
+      int num_discarded = obs.DiscardCount(c, r);
       for (int i = 0; i < num_discarded; ++i) {
         (*encoding)[offset + i] = 1;
       }
@@ -232,16 +291,18 @@ int LastActionSectionLength(const HanabiGame& game) {
 //  - Reveal outcome (<hand_size> bits; each bit is 1 if the card was hinted at)
 //  - Position played/discarded (<hand_size> bits; one-hot)
 //  - Card played/discarded (<num_colors> * <num_ranks> bits; one-hot)
+// last_move is observer-relative, nullptr if there was no such move.
 // Returns the number of entries written to the encoding.
-int EncodeLastAction(const HanabiGame& game, const HanabiObservation& obs,
-                     int start_offset, std::vector<int>* encoding) {
+template <class Encoding>
+int EncodeLastActionItem(const HanabiGame& game,
+                         const HanabiHistoryItem* last_move, int start_offset,
+                         Encoding* encoding) {
   int num_colors = game.NumColors();
   int num_ranks = game.NumRanks();
   int num_players = game.NumPlayers();
   int hand_size = game.HandSize();
 
   int offset = start_offset;
-  const HanabiHistoryItem* last_move = GetLastNonDealMove(obs.LastMoves());
   if (last_move == nullptr) {
     offset += LastActionSectionLength(game);
   } else {
@@ -337,11 +398,65 @@ int EncodeLastAction(const HanabiGame& game, const HanabiObservation& obs,
   return offset - start_offset;
 }
 
+template <class Encoding>
+int EncodeLastAction(const HanabiGame& game, const HanabiObservation& obs,
+                     int start_offset, Encoding* encoding) {
+  return EncodeLastActionItem(game, GetLastNonDealMove(obs.LastMoves()),
+                              start_offset, encoding);
+}
+
+template <class Encoding>
+int EncodeLastAction(const HanabiGame& game, const HanabiObservationView& obs,
+                     int start_offset, Encoding* encoding) {
+  HanabiHistoryItem last_move(HanabiMove(HanabiMove::kInvalid, -1, -1, -1, -1));
+  const bool found = obs.LastNonDealMove(&last_move);
+  return EncodeLastActionItem(game, found ? &last_move : nullptr, start_offset,
+                              encoding);
+}
+
 int CardKnowledgeSectionLength(const HanabiGame& game) {
   return game.NumPlayers() * game.HandSize() *
          (BitsPerCard(game) + game.NumColors() + game.NumRanks());
 }
 
+int HandKnowledgeLength(const HanabiGame& game) {
+  return game.HandSize() *
+         (BitsPerCard(game) + game.NumColors() + game.NumRanks());
+}
+
+// Encodes the card knowledge of a single hand, see EncodeCardKnowledge.
+// Always advances by HandKnowledgeLength(game); the bits for cards missing
+// from the hand are left empty.
+// Returns the number of entries written to the encoding.
+template <class Encoding>
+int EncodeHandKnowledge(const HanabiGame& game, const HanabiHand& hand,
+                        int start_offset, Encoding* encoding) {
+  int bits_per_card = BitsPerCard(game);
+  int num_colors = game.NumColors();
+  int num_ranks = game.NumRanks();
+
+  int offset = start_offset;
+  for (const HanabiHand::CardKnowledge& card_knowledge : hand.Knowledge()) {
+    // Add bits for plausible card. The mask is in CardIndex order.
+    for (uint32_t plausible = card_knowledge.PlausibleMask(); plausible != 0;
+         plausible &= plausible - 1) {
+      (*encoding)[offset + LowestSetBit(plausible)] = 1;
+    }
+    offset += bits_per_card;
+
+    // Add bits for explicitly revealed colors and ranks.
+    if (card_knowledge.ColorHinted()) {
+      (*encoding)[offset + card_knowledge.Color()] = 1;
+    }
+    offset += num_colors;
+    if (card_knowledge.RankHinted()) {
+      (*encoding)[offset + card_knowledge.Rank()] = 1;
+    }
+    offset += num_ranks;
+  }
+  return HandKnowledgeLength(game);
+}
+
 // Encode the common card knowledge.
 // For each card/position in each player's hand, including the observing player,
 // encode the possible cards that could be in that position and whether the
@@ -363,61 +478,41 @@ int CardKnowledgeSectionLength(const HanabiGame& game) {
 // Uses <num_players> * <hand_size> *
 // (<num_colors> * <num_ranks> + <num_colors> + <num_ranks>) bits.
 // Returns the number of entries written to the encoding.
-int EncodeCardKnowledge(const HanabiGame& game, const HanabiObservation& obs,
-                        int start_offset, std::vector<int>* encoding) {
-  int bits_per_card = BitsPerCard(game);
-  int num_colors = game.NumColors();
-  int num_ranks = game.NumRanks();
+template <class Observation, class Encoding>
+int EncodeCardKnowledge(const HanabiGame& game, const Observation& obs,
+                        int start_offset, Encoding* encoding) {
   int num_players = game.NumPlayers();
-  int hand_size = game.HandSize();
 
   int offset = start_offset;
-  const std::vector<HanabiHand>& hands = obs.Hands();
-  assert(hands.size() == num_players);
   for (int player = 0; player < num_players; ++player) {
-    const std::vector<HanabiHand::CardKnowledge>& knowledge =
-        hands[player].Knowledge();
-    int num_cards = 0;
-
-    for (const HanabiHand::CardKnowledge& card_knowledge : knowledge) {
-      // Add bits for plausible card.
-      for (int color = 0; color < num_colors; ++color) {
-        if (card_knowledge.ColorPlausible(color)) {
-          for (int rank = 0; rank < num_ranks; ++rank) {
-            if (card_knowledge.RankPlausible(rank)) {
-              (*encoding)[offset + CardIndex(color, rank, num_ranks)] = 1;
-            }
-          }
-        }
-      }
-      offset += bits_per_card;
-
-      // Add bits for explicitly revealed colors and ranks.
-      if (card_knowledge.ColorHinted()) {
-        (*encoding)[offset + card_knowledge.Color()] = 1;
-      }
-      offset += num_colors;
-      if (card_knowledge.RankHinted()) {
-        (*encoding)[offset + card_knowledge.Rank()] = 1;
-      }
-      offset += num_ranks;
-
-      ++num_cards;
-    }
-
     // A player's hand can have fewer cards than the initial hand size.
-    // Leave the bits for the absent cards empty (adjust the offset to skip
-    // bits for the missing cards).
-    if (num_cards < hand_size) {
-      offset +=
-          (hand_size - num_cards) * (bits_per_card + num_colors + num_ranks);
-    }
+    // The bits for the absent cards are left empty.
+    offset += EncodeHandKnowledge(game, ObservedHand(obs, player), offset,
+                                  encoding);
   }
 
   assert(offset - start_offset == CardKnowledgeSectionLength(game));
   return offset - start_offset;
 }
 
+// Writes all sections of the canonical encoding, returns the number of
+// entries written. Entries which are not set are left untouched.
+template <class Observation, class Encoding>
+int EncodeAllSections(const HanabiGame& game, const Observation& obs,
+                      Encoding* encoding) {
+  // This offset is an index to the start of each section of the bit vector.
+  // It is incremented at the end of each section.
+  int offset = 0;
+  offset += EncodeHands(game, obs, offset, encoding);
+  offset += EncodeBoard(game, obs, offset, encoding);
+  offset += EncodeDiscards(game, obs, offset, encoding);
+  offset += EncodeLastAction(game, obs, offset, encoding);
+  if (game.ObservationType() != HanabiGame::kMinimal) {
+    offset += EncodeCardKnowledge(game, obs, offset, encoding);
+  }
+  return offset;
+}
+
 }  // namespace
 
 std::vector<int> CanonicalObservationEncoder::Shape() const {
@@ -432,22 +527,276 @@ std::vector<int> CanonicalObservationEncoder::Shape() const {
 
 std::vector<int> CanonicalObservationEncoder::Encode(
     const HanabiObservation& obs) const {
+  return EncodeVector(obs);
+}
+
+std::vector<int> CanonicalObservationEncoder::Encode(
+    const HanabiObservationView& obs) const {
+  return EncodeVector(obs);
+}
+
+void CanonicalObservationEncoder::Encode(const HanabiObservation& obs,
+                                         int8_t* encoding) const {
+  EncodeBuffer(obs, encoding);
+}
+
+void CanonicalObservationEncoder::Encode(const HanabiObservationView& obs,
+                                         int8_t* encoding) const {
+  EncodeBuffer(obs, encoding);
+}
+
+int CanonicalObservationEncoder::PackedLength() const {
+  return (FlatLength(Shape()) + 7) / 8;
+}
+
+void CanonicalObservationEncoder::EncodePacked(const HanabiObservation& obs,
+                                               uint8_t* encoding) const {
+  EncodePackedBuffer(obs, encoding);
+}
+
+void CanonicalObservationEncoder::EncodePacked(
+    const HanabiObservationView& obs, uint8_t* encoding) const {
+  EncodePackedBuffer(obs, encoding);
+}
+
+template <class Observation>
+std::vector<int> CanonicalObservationEncoder::EncodeVector(
+    const Observation& obs) const {
   // Make an empty bit string of the proper size.
   std::vector<int> encoding(FlatLength(Shape()), 0);
+  int offset = EncodeAllSections(*parent_game_, obs, &encoding);
+  assert(offset == encoding.size());
+  return encoding;
+}
 
-  // This offset is an index to the start of each section of the bit vector.
-  // It is incremented at the end of each section.
-  int offset = 0;
-  offset += EncodeHands(*parent_game_, obs, offset, &encoding);
-  offset += EncodeBoard(*parent_game_, obs, offset, &encoding);
-  offset += EncodeDiscards(*parent_game_, obs, offset, &encoding);
-  offset += EncodeLastAction(*parent_game_, obs, offset, &encoding);
-  if (parent_game_->ObservationType() != HanabiGame::kMinimal) {
-    offset += EncodeCardKnowledge(*parent_game_, obs, offset, &encoding);
+template <class Observation>
+void CanonicalObservationEncoder::EncodeBuffer(const Observation& obs,
+                                               int8_t* encoding) const {
+  const int length = FlatLength(Shape());
+  std::fill(encoding, encoding + length, 0);
+  BufferEncoding<int8_t> buffer(encoding);
+  int offset = EncodeAllSections(*parent_game_, obs, &buffer);
+  assert(offset == length);
+}
+
+template <class Observation>
+void CanonicalObservationEncoder::EncodePackedBuffer(const Observation& obs,
+                                                     uint8_t* encoding) const {
+  std::fill(encoding, encoding + PackedLength(), 0);
+  PackedBitsEncoding packed(encoding);
+  int offset = EncodeAllSections(*parent_game_, obs, &packed);
+  assert(offset == FlatLength(Shape()));
+}
+
+void PackBits(const int8_t* encoding, int length, uint8_t* packed) {
+  for (int byte = 0; byte < (length + 7) / 8; ++byte) {
+    uint8_t bits = 0;
+    for (int bit = 0; bit < 8 && byte * 8 + bit < length; ++bit) {
+      bits |= (encoding[byte * 8 + bit] != 0) << bit;
+    }
+    packed[byte] = bits;
   }
+}
 
-  assert(offset == encoding.size());
-  return encoding;
+IncrementalCanonicalEncoder::IncrementalCanonicalEncoder(
+    const HanabiGame* parent_game)
+    : parent_game_(parent_game),
+      encoder_(parent_game),
+      encoding_(FlatLength(encoder_.Shape()), 0),
+      fireworks_(parent_game->NumColors(), 0),
+      discard_counts_(BitsPerCard(*parent_game), 0) {
+  const HanabiGame& game = *parent_game_;
+  board_offset_ = HandsSectionLength(game);
+  discards_offset_ = board_offset_ + BoardSectionLength(game);
+  last_action_offset_ = discards_offset_ + DiscardSectionLength(game);
+  knowledge_offset_ = last_action_offset_ + LastActionSectionLength(game);
+  int offset = discards_offset_;
+  for (int c = 0; c < game.NumColors(); ++c) {
+    for (int r = 0; r < game.NumRanks(); ++r) {
+      discard_card_offsets_.push_back(offset);
+      offset += game.NumberCardInstances(c, r);
+    }
+  }
+}
+
+void IncrementalCanonicalEncoder::Fill(int begin, int end, int8_t value) {
+  std::fill(encoding_.begin() + begin, encoding_.begin() + end, value);
+}
+
+void IncrementalCanonicalEncoder::EncodeFromScratch(const HanabiState& state,
+                                                    int observer) {
+  encoder_.Encode(HanabiObservationView(state, observer), encoding_.data());
+  valid_ = true;
+  observer_ = observer;
+  num_moves_ = state.NumMoves();
+  deck_size_ = state.Deck().Size();
+  information_tokens_ = state.InformationTokens();
+  life_tokens_ = state.LifeTokens();
+  fireworks_ = state.Fireworks();
+  discard_pile_size_ = state.DiscardPile().size();
+  for (int c = 0; c < parent_game_->NumColors(); ++c) {
+    for (int r = 0; r < parent_game_->NumRanks(); ++r) {
+      discard_counts_[CardIndex(c, r, parent_game_->NumRanks())] =
+          state.DiscardCount(c, r);
+    }
+  }
+}
+
+const std::vector<int8_t>& IncrementalCanonicalEncoder::Update(
+    const HanabiState& state, int observer) {
+  // The encoding is updated from the moves since the last update, which must
+  // all be in the history; without a history every update is from scratch.
+  if (!valid_ || observer != observer_ || state.NumMoves() < num_moves_ ||
+      state.HistoryStart() > num_moves_) {
+    EncodeFromScratch(state, observer);
+    return encoding_;
+  }
+  if (state.NumMoves() == num_moves_) {
+    return encoding_;
+  }
+  const auto& history = state.MoveHistory();
+  const int history_start = state.HistoryStart();
+
+  const int num_players = parent_game_->NumPlayers();
+  // Bitmasks of the players whose hand cards / card knowledge changed.
+  unsigned int hands_changed = 0;
+  unsigned int knowledge_changed = 0;
+  bool acted = false;
+  for (int i = num_moves_; i < state.NumMoves(); ++i) {
+    const HanabiHistoryItem& item = history[i - history_start];
+    switch (item.move.MoveType()) {
+      case HanabiMove::kDeal:
+        hands_changed |= 1u << item.deal_to_player;
+        break;
+      case HanabiMove::kPlay:
+      case HanabiMove::kDiscard:
+        hands_changed |= 1u << item.player;
+        acted = true;
+        break;
+      case HanabiMove::kRevealColor:
+      case HanabiMove::kRevealRank:
+        knowledge_changed |=
+            1u << ((item.player + item.move.TargetOffset()) % num_players);
+        acted = true;
+        break;
+      default:
+        std::abort();
+    }
+  }
+  // Changing the cards of a hand shifts its knowledge as well.
+  knowledge_changed |= hands_changed;
+
+  UpdateBoard(state);
+  UpdateDiscards(state);
+  for (int player = 0; player < num_players; ++player) {
+    if (hands_changed & (1u << player)) {
+      UpdateHand(state, player);
+    }
+    if ((knowledge_changed & (1u << player)) &&
+        parent_game_->ObservationType() != HanabiGame::kMinimal) {
+      UpdateKnowledge(state, player);
+    }
+  }
+  if (acted) {
+    UpdateLastAction(state);
+  }
+  num_moves_ = state.NumMoves();
+  return encoding_;
+}
+
+void IncrementalCanonicalEncoder::UpdateBoard(const HanabiState& state) {
+  const HanabiGame& game = *parent_game_;
+  // The deck only shrinks: clear the tail of the thermometer.
+  int offset = board_offset_;
+  Fill(offset + state.Deck().Size(), offset + deck_size_, 0);
+  deck_size_ = state.Deck().Size();
+  offset += game.MaxDeckSize() - game.HandSize() * game.NumPlayers();
+
+  for (int c = 0; c < game.NumColors(); ++c) {
+    if (state.Fireworks()[c] != fireworks_[c]) {
+      if (fireworks_[c] > 0) {
+        encoding_[offset + fireworks_[c] - 1] = 0;
+      }
+      fireworks_[c] = state.Fireworks()[c];
+      if (fireworks_[c] > 0) {
+        encoding_[offset + fireworks_[c] - 1] = 1;
+      }
+    }
+    offset += game.NumRanks();
+  }
+
+  // Tokens: only the entries between the old and new count change.
+  const int information_tokens = state.InformationTokens();
+  Fill(offset + std::min(information_tokens, information_tokens_),
+       offset + std::max(information_tokens, information_tokens_),
+       information_tokens > information_tokens_ ? 1 : 0);
+  information_tokens_ = information_tokens;
+  offset += game.MaxInformationTokens();
+
+  const int life_tokens = state.LifeTokens();
+  Fill(offset + std::min(life_tokens, life_tokens_),
+       offset + std::max(life_tokens, life_tokens_),
+       life_tokens > life_tokens_ ? 1 : 0);
+  life_tokens_ = life_tokens;
+}
+
+void IncrementalCanonicalEncoder::UpdateDiscards(const HanabiState& state) {
+  const auto& discard_pile = state.DiscardPile();
+  for (int i = discard_pile_size_; i < discard_pile.size(); ++i) {
+    const int card_index = CardIndex(discard_pile[i].Color(),
+                                     discard_pile[i].Rank(),
+                                     parent_game_->NumRanks());
+    encoding_[discard_card_offsets_[card_index] +
+              discard_counts_[card_index]++] = 1;
+  }
+  discard_pile_size_ = discard_pile.size();
+}
+
+void IncrementalCanonicalEncoder::UpdateHand(const HanabiState& state,
+                                             int player) {
+  const HanabiGame& game = *parent_game_;
+  const int num_players = game.NumPlayers();
+  const int relative_player = (player - observer_ + num_players) % num_players;
+  const HanabiHand& hand = state.Hands()[player];
+  if (relative_player > 0) {
+    const int offset = (relative_player - 1) * HandCardsLength(game);
+    Fill(offset, offset + HandCardsLength(game), 0);
+    BufferEncoding<int8_t> buffer(encoding_.data());
+    EncodeHandCards(game, hand, offset, &buffer);
+  }
+  encoding_[(num_players - 1) * HandCardsLength(game) + relative_player] =
+      hand.Cards().size() < game.HandSize() ? 1 : 0;
+}
+
+void IncrementalCanonicalEncoder::UpdateKnowledge(const HanabiState& state,
+                                                  int player) {
+  const HanabiGame& game = *parent_game_;
+  const int num_players = game.NumPlayers();
+  const int relative_player = (player - observer_ + num_players) % num_players;
+  const int offset =
+      knowledge_offset_ + relative_player * HandKnowledgeLength(game);
+  Fill(offset, offset + HandKnowledgeLength(game), 0);
+  BufferEncoding<int8_t> buffer(encoding_.data());
+  EncodeHandKnowledge(game, state.Hands()[player], offset, &buffer);
+}
+
+void IncrementalCanonicalEncoder::UpdateLastAction(const HanabiState& state) {
+  const HanabiGame& game = *parent_game_;
+  const auto& history = state.MoveHistory();
+  auto it = std::find_if(history.rbegin(), history.rend(),
+                         [](const HanabiHistoryItem& item) {
+                           return item.move.MoveType() != HanabiMove::kDeal;
+                         });
+  Fill(last_action_offset_,
+       last_action_offset_ + LastActionSectionLength(game), 0);
+  if (it == history.rend()) {
+    return;
+  }
+  HanabiHistoryItem last_move = *it;
+  last_move.player =
+      (last_move.player - observer_ + game.NumPlayers()) % game.NumPlayers();
+  BufferEncoding<int8_t> buffer(encoding_.data());
+  EncodeLastActionItem(game, &last_move, last_action_offset_, &buffer);
 }
 
 }  // namespace hanabi_learning_env
@@ -18,10 +18,12 @@
 #ifndef __CANONICAL_ENCODERS_H__
 #define __CANONICAL_ENCODERS_H__
 
+#include <cstdint>
 #include <vector>
 
 #include "hanabi_game.h"
 #include "hanabi_observation.h"
+#include "hanabi_state.h"
 #include "observation_encoder.h"
 
 namespace hanabi_learning_env {
@@ -34,13 +36,93 @@ class CanonicalObservationEncoder : public ObservationEncoder {
 
   std::vector<int> Shape() const override;
   std::vector<int> Encode(const HanabiObservation& obs) const override;
+  // The overloads taking a HanabiObservationView encode the same, straight
+  // from the state, without building a HanabiObservation.
+  std::vector<int> Encode(const HanabiObservationView& obs) const;
+  // Writes the encoding of obs into FlatLength(Shape()) entries starting at
+  // encoding, without any intermediate allocation. The entries need not be
+  // initialized.
+  void Encode(const HanabiObservation& obs, int8_t* encoding) const;
+  void Encode(const HanabiObservationView& obs, int8_t* encoding) const;
+  // Number of bytes of a bit-packed encoding.
+  int PackedLength() const;
+  // Writes the encoding of obs packed 8 bits per byte into PackedLength()
+  // bytes starting at encoding. Bit i of the encoding is bit (i % 8) of byte
+  // (i / 8), i.e. bits are in little-endian order as expected by
+  // numpy.unpackbits(..., bitorder='little'). Padding bits are zero.
+  void EncodePacked(const HanabiObservation& obs, uint8_t* encoding) const;
+  void EncodePacked(const HanabiObservationView& obs, uint8_t* encoding) const;
 
   ObservationEncoder::Type type() const override {
     return ObservationEncoder::Type::kCanonical;
   }
 
  private:
+  template <class Observation>
+  std::vector<int> EncodeVector(const Observation& obs) const;
+  template <class Observation>
+  void EncodeBuffer(const Observation& obs, int8_t* encoding) const;
+  template <class Observation>
+  void EncodePackedBuffer(const Observation& obs, uint8_t* encoding) const;
+
+  const HanabiGame* parent_game_ = nullptr;
+};
+
+// Packs length 0/1 entries 8 per byte into (length + 7) / 8 bytes, in the
+// bit order of CanonicalObservationEncoder::EncodePacked.
+void PackBits(const int8_t* encoding, int length, uint8_t* packed);
+
+// Keeps the canonical encoding of one state, as seen by one observer, up to
+// date across moves. Update encodes from scratch only the first time; after
+// that it patches the bits affected by the history items appended since the
+// previous call: the hand and knowledge rows of the players whose hands
+// changed, deltas of the deck, token and fireworks thermometers, the newly
+// discarded cards and the last-action section.
+// The state must only advance between updates. Call Invalidate when the
+// tracked state is replaced by a different one. Updates fall back to encoding
+// from scratch when the moves since the previous call are no longer in the
+// history (see HanabiState::SetHistoryMode). States in kNoHistory cannot be
+// encoded, as their last action is unknown.
+class IncrementalCanonicalEncoder {
+ public:
+  explicit IncrementalCanonicalEncoder(const HanabiGame* parent_game);
+
+  // Forget the cached encoding, the next Update encodes from scratch.
+  void Invalidate() { valid_ = false; }
+  // Bring the encoding up to date with state observed by observer.
+  const std::vector<int8_t>& Update(const HanabiState& state, int observer);
+  // The encoding as of the last Update.
+  const std::vector<int8_t>& Encoding() const { return encoding_; }
+
+ private:
+  void EncodeFromScratch(const HanabiState& state, int observer);
+  void UpdateBoard(const HanabiState& state);
+  void UpdateDiscards(const HanabiState& state);
+  void UpdateHand(const HanabiState& state, int player);
+  void UpdateKnowledge(const HanabiState& state, int player);
+  void UpdateLastAction(const HanabiState& state);
+  // Set entries [begin, end) of the encoding to value.
+  void Fill(int begin, int end, int8_t value);
+
   const HanabiGame* parent_game_ = nullptr;
+  CanonicalObservationEncoder encoder_;
+  std::vector<int8_t> encoding_;
+  bool valid_ = false;
+  int observer_ = -1;
+  // Number of moves, and summary of the state, as of the encoding.
+  int num_moves_ = 0;
+  int deck_size_ = 0;
+  int information_tokens_ = 0;
+  int life_tokens_ = 0;
+  int discard_pile_size_ = 0;
+  std::vector<int> fireworks_;
+  std::vector<int> discard_counts_;
+  // Section offsets, and offset of each card's discard thermometer.
+  int board_offset_ = 0;
+  int discards_offset_ = 0;
+  int last_action_offset_ = 0;
+  int knowledge_offset_ = 0;
+  std::vector<int> discard_card_offsets_;
 };
 
 }  // namespace hanabi_learning_env
@@ -0,0 +1,75 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A small counter-based random number generator, used to give every game
+// state its own independent random stream.
+
+#ifndef __COUNTER_RNG_H__
+#define __COUNTER_RNG_H__
+
+#include <cstdint>
+
+namespace hanabi_learning_env {
+
+// Every output is a pure function of a 64-bit key and a 64-bit counter (the
+// SplitMix64 output function applied to key + counter * golden ratio). A
+// generator is 16 bytes large and costs nothing to seed, and independent
+// streams are obtained by hashing stream identifiers into the key. Satisfies
+// the UniformRandomBitGenerator requirements, so it works with <random>.
+class CounterRng {
+ public:
+  typedef uint32_t result_type;
+
+  CounterRng() = default;
+  explicit CounterRng(uint64_t key) : key_(key) {}
+  // Stream identified by a seed and two stream indices, e.g.
+  // (seed, state index, episode number).
+  CounterRng(uint64_t seed, uint64_t stream, uint64_t substream)
+      : key_(Mix(Mix(Mix(seed) ^ stream) ^ substream)) {}
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return 0xffffffffu; }
+  result_type operator()() { return static_cast<result_type>(Next64() >> 32); }
+  uint64_t Next64() { return Mix(key_ + kGamma * ++counter_); }
+  // Uniformly distributed integer in [0, n), n > 0. Unbiased.
+  uint32_t Below(uint32_t n) {
+    const uint32_t threshold = static_cast<uint32_t>(-n) % n;
+    for (;;) {
+      uint64_t product = static_cast<uint64_t>((*this)()) * n;
+      if (static_cast<uint32_t>(product) >= threshold) {
+        return static_cast<uint32_t>(product >> 32);
+      }
+    }
+  }
+
+  uint64_t Key() const { return key_; }
+  uint64_t Counter() const { return counter_; }
+
+ private:
+  static constexpr uint64_t kGamma = 0x9e3779b97f4a7c15ULL;
+
+  static uint64_t Mix(uint64_t z) {
+    z += kGamma;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  uint64_t key_ = 0;
+  uint64_t counter_ = 0;
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
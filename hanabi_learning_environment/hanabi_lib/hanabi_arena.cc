@@ -0,0 +1,41 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hanabi_arena.h"
+
+namespace hanabi_learning_env {
+
+HanabiState* HanabiArena::Clone(const HanabiState& state) {
+  if (num_states_in_use_ == states_.size()) {
+    states_.emplace_back(new HanabiState(state));
+    return states_[num_states_in_use_++].get();
+  }
+  HanabiState* clone = states_[num_states_in_use_++].get();
+  *clone = state;
+  return clone;
+}
+
+HanabiObservation* HanabiArena::Observe(const HanabiState& state,
+                                        int observing_player) {
+  if (num_observations_in_use_ == observations_.size()) {
+    observations_.emplace_back(new HanabiObservation(state, observing_player));
+    return observations_[num_observations_in_use_++].get();
+  }
+  HanabiObservation* observation =
+      observations_[num_observations_in_use_++].get();
+  observation->Assign(state, observing_player);
+  return observation;
+}
+
+}  // namespace hanabi_learning_env
@@ -0,0 +1,71 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Arenas of states and observations for search and rollouts, which clone
+// states and observe them at every step.
+
+#ifndef __HANABI_ARENA_H__
+#define __HANABI_ARENA_H__
+
+#include <memory>
+#include <vector>
+
+#include "hanabi_observation.h"
+#include "hanabi_state.h"
+
+namespace hanabi_learning_env {
+
+// Monotonic arena of HanabiState and HanabiObservation objects. Clone and
+// Observe hand out objects one after the other until Reset, typically
+// called between episodes or search iterations, takes them all back at once.
+// Objects are never freed before the arena is: after Reset, they are handed
+// out again and assigned to, which reuses the memory of their vectors. Once
+// the arena has grown to the number of objects an iteration needs, and their
+// vectors to the sizes of the game, cloning and observing do not allocate.
+//
+// Arenas are not thread-safe: give each thread its own, so that threads
+// cloning at the same time do not contend for the global allocator.
+class HanabiArena {
+ public:
+  HanabiArena() = default;
+  HanabiArena(const HanabiArena&) = delete;
+  HanabiArena& operator=(const HanabiArena&) = delete;
+
+  // Copy of state, valid until the next Reset.
+  HanabiState* Clone(const HanabiState& state);
+  // Observation of state by observing_player, valid until the next Reset.
+  HanabiObservation* Observe(const HanabiState& state, int observing_player);
+  // Takes back all objects handed out, keeping their memory.
+  void Reset() {
+    num_states_in_use_ = 0;
+    num_observations_in_use_ = 0;
+  }
+
+  int NumStatesInUse() const { return num_states_in_use_; }
+  int NumObservationsInUse() const { return num_observations_in_use_; }
+  // Objects allocated so far, handed out or not.
+  int NumStates() const { return states_.size(); }
+  int NumObservations() const { return observations_.size(); }
+
+ private:
+  // Pointers keep the objects in place as the arena grows.
+  std::vector<std::unique_ptr<HanabiState>> states_;
+  std::vector<std::unique_ptr<HanabiObservation>> observations_;
+  int num_states_in_use_ = 0;
+  int num_observations_in_use_ = 0;
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
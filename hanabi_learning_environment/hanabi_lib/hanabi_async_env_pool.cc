@@ -0,0 +1,222 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hanabi_async_env_pool.h"
+
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "util.h"
+
+namespace {
+
+// Polls of an empty completion queue before the consumer goes to sleep.
+constexpr int kPopSpins = 128;
+
+}  // namespace
+
+hanabi_learning_env::HanabiCompletionQueue::HanabiCompletionQueue(
+    const int capacity)
+  : slots_(nullptr),
+    mask_([capacity]() {
+        uint64_t size = 1;
+        while (size < static_cast<uint64_t>(capacity)) size <<= 1;
+        return size - 1;
+      }()) {
+  slots_.reset(new Slot[mask_ + 1]);
+  for (uint64_t idx = 0; idx <= mask_; ++idx) {
+    slots_[idx].sequence.store(idx, std::memory_order_relaxed);
+  }
+}
+
+void hanabi_learning_env::HanabiCompletionQueue::Push(const int item) {
+  const uint64_t ticket = tail_.fetch_add(1, std::memory_order_relaxed);
+  Slot& slot = slots_[ticket & mask_];
+  // Wait for the pop of ticket - capacity to release the slot.
+  while (slot.sequence.load(std::memory_order_acquire) != ticket) {
+    std::this_thread::yield();
+  }
+  slot.item = item;
+  slot.sequence.store(ticket + 1, std::memory_order_release);
+  // Pairs with the fence in Pop: either the consumer sees the item before
+  // sleeping, or this sees that it sleeps and wakes it.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping_.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wake_.notify_one();
+  }
+}
+
+bool hanabi_learning_env::HanabiCompletionQueue::TryPop(int* item) {
+  Slot& slot = slots_[head_ & mask_];
+  if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) {
+    return false;
+  }
+  *item = slot.item;
+  slot.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+  ++head_;
+  return true;
+}
+
+int hanabi_learning_env::HanabiCompletionQueue::Pop() {
+  int item = -1;
+  for (int spin = 0; spin < kPopSpins; ++spin) {
+    if (TryPop(&item)) {
+      return item;
+    }
+    std::this_thread::yield();
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  sleeping_.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  while (!TryPop(&item)) {
+    wake_.wait(lock);
+  }
+  sleeping_.store(false, std::memory_order_relaxed);
+  return item;
+}
+
+hanabi_learning_env::HanabiAsyncEnvPool::Group::Group(
+    const std::unordered_map<std::string, std::string>& game_params,
+    const int n_states, const int first_stream, const bool packed)
+  : env(game_params, n_states, first_stream),
+    moves(n_states),
+    observation(n_states * (packed ? env.GetPackedObservationLength()
+                                   : env.GetObservationFlatLength())),
+    legal_moves(n_states * env.MaxMoves()),
+    scores(n_states),
+    done(n_states),
+    rewards(n_states),
+    final_scores(n_states),
+    episode_lengths(n_states) {
+  observation_buffers.observation = observation.data();
+  observation_buffers.legal_moves = legal_moves.data();
+  observation_buffers.scores = scores.data();
+  observation_buffers.done = done.data();
+  result_buffers.rewards = rewards.data();
+  result_buffers.final_scores = final_scores.data();
+  result_buffers.episode_lengths = episode_lengths.data();
+  if (packed) {
+    env.ObserveAgentPacked(current_agent, observation_buffers);
+  } else {
+    env.ObserveAgent(current_agent, observation_buffers);
+  }
+}
+
+hanabi_learning_env::HanabiAsyncEnvPool::HanabiAsyncEnvPool(
+    const std::unordered_map<std::string, std::string>& game_params,
+    const int n_groups, const int states_per_group, const bool packed,
+    const int threads_per_group)
+  : states_per_group_(states_per_group),
+    packed_(packed),
+    threads_per_group_(threads_per_group),
+    completions_(n_groups) {
+  REQUIRE(n_groups > 0);
+  REQUIRE(states_per_group > 0);
+  REQUIRE(threads_per_group > 0);
+  // Resolve a random seed once, so that all groups deal from the same one.
+  const auto resolved_params = HanabiGame(game_params).Parameters();
+  for (int group_idx = 0; group_idx < n_groups; ++group_idx) {
+    groups_.emplace_back(new Group(resolved_params, states_per_group,
+                                   group_idx * states_per_group, packed));
+    groups_.back()->in_flight = true;
+    completions_.Push(group_idx);
+  }
+  const auto& env = groups_.front()->env;
+  observation_len_ = packed ? env.GetPackedObservationLength()
+                            : env.GetObservationFlatLength();
+  for (int group_idx = 0; group_idx < n_groups; ++group_idx) {
+    workers_.emplace_back(&HanabiAsyncEnvPool::Work, this, group_idx);
+  }
+}
+
+hanabi_learning_env::HanabiAsyncEnvPool::~HanabiAsyncEnvPool() {
+  stopping_.store(true);
+  for (auto& group : groups_) {
+    // Taking the mutex makes sure a worker is either waiting, and gets the
+    // notification, or has not yet checked stopping_.
+    std::lock_guard<std::mutex> lock(group->mutex);
+    group->wake.notify_one();
+  }
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void hanabi_learning_env::HanabiAsyncEnvPool::Send(
+    const int* move_uids, const int group_idx) {
+  REQUIRE(group_idx >= 0 && group_idx < NumGroups());
+  Group& group = *groups_[group_idx];
+  REQUIRE(!group.in_flight);
+  group.in_flight = true;
+  {
+    std::lock_guard<std::mutex> lock(group.mutex);
+    std::copy(move_uids, move_uids + states_per_group_, group.moves.begin());
+    group.pending = true;
+  }
+  group.wake.notify_one();
+}
+
+int hanabi_learning_env::HanabiAsyncEnvPool::Recv() {
+  const int group_idx = completions_.Pop();
+  groups_[group_idx]->in_flight = false;
+  return group_idx;
+}
+
+void hanabi_learning_env::HanabiAsyncEnvPool::Work(const int group_idx) {
+#ifdef _OPENMP
+  omp_set_num_threads(threads_per_group_);
+#endif
+  Group& group = *groups_[group_idx];
+  const int n_players = group.env.GetGame().NumPlayers();
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(group.mutex);
+      group.wake.wait(lock, [this, &group]() {
+          return group.pending || stopping_.load(); });
+      if (!group.pending) {
+        return;
+      }
+      group.pending = false;
+    }
+    group.env.StepAndObserve(group.moves.data(), group.current_agent,
+                             packed_, group.observation_buffers,
+                             group.result_buffers);
+    group.current_agent = (group.current_agent + 1) % n_players;
+    completions_.Push(group_idx);
+  }
+}
+
+int hanabi_learning_env::HanabiAsyncEnvPool::CurrentAgent(
+    const int group) const {
+  return groups_.at(group)->current_agent;
+}
+
+const hanabi_learning_env::HanabiParallelEnv::HanabiBatchObservationBuffers&
+hanabi_learning_env::HanabiAsyncEnvPool::Observation(const int group) const {
+  return groups_.at(group)->observation_buffers;
+}
+
+const hanabi_learning_env::HanabiParallelEnv::HanabiStepResultBuffers&
+hanabi_learning_env::HanabiAsyncEnvPool::StepResults(const int group) const {
+  return groups_.at(group)->result_buffers;
+}
+
+const hanabi_learning_env::HanabiParallelEnv&
+hanabi_learning_env::HanabiAsyncEnvPool::GroupEnv(const int group) const {
+  return groups_.at(group)->env;
+}
@@ -0,0 +1,230 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __HANABI_ASYNC_ENV_POOL_H__
+#define __HANABI_ASYNC_ENV_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "hanabi_parallel_env.h"
+
+namespace hanabi_learning_env {
+
+/** \brief Bounded queue of completed group indices.
+ *
+ *  Any number of threads may Push, a single thread may Pop. Slots are handed
+ *  from producers to the consumer and back by a sequence number per slot:
+ *  slot i is free for the push of ticket t when its sequence is t, holds the
+ *  item of ticket t when it is t + 1, and is released by the pop of ticket t
+ *  by setting it to t + capacity. Push waits for its slot if the ring is
+ *  full; the pool never has more than one completion per group outstanding,
+ *  so with one slot per group it never has to.
+ */
+class HanabiCompletionQueue {
+ public:
+  explicit HanabiCompletionQueue(const int capacity);
+
+  /** \brief Append an item. Lock-free unless the consumer is asleep in Pop,
+   *  which is then woken up.
+   */
+  void Push(const int item);
+
+  /** \brief Take the oldest item if there is one.
+   *
+   *  \return Whether an item was taken.
+   */
+  bool TryPop(int* item);
+
+  /** \brief Take the oldest item, waiting for one if the queue is empty.
+   *
+   *  Polls a few times before going to sleep until the next Push.
+   */
+  int Pop();
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> sequence;  //< See the class comment.
+    int item;                        //< Stored item.
+  };
+
+  std::unique_ptr<Slot[]> slots_;   //< Ring buffer.
+  const uint64_t mask_;             //< Capacity - 1, capacity is a power of two.
+  std::atomic<uint64_t> tail_{0};   //< Ticket of the next push.
+  uint64_t head_ = 0;               //< Ticket of the next pop, owned by the consumer.
+  std::atomic<bool> sleeping_{false};  //< Whether the consumer may be waiting on wake_.
+  std::mutex mutex_;                //< Guards the consumer going to sleep.
+  std::condition_variable wake_;    //< Signals a push to a sleeping consumer.
+};
+
+/** \brief Pool of parallel environments stepped asynchronously by worker
+ *  threads.
+ *
+ *  The states are split into groups, each a HanabiParallelEnv served by its
+ *  own worker thread. Send hands a batch of moves to a group and returns at
+ *  once; the worker steps the group with HanabiParallelEnv::StepAndObserve.
+ *  Recv returns whichever group finished first, so the caller can compute
+ *  the moves of one group while the others are being simulated.
+ *
+ *  Group g is equivalent to states g * states_per_group ... of a single
+ *  HanabiParallelEnv with the same parameters, so the deals do not depend on
+ *  the number of groups nor on the order in which groups complete. A seed of
+ *  -1 is resolved once, so all groups share the same random seed.
+ *
+ *  Typical loop:
+ *  \code
+ *    while (training) {
+ *      const int group = pool.Recv();
+ *      // Read pool.Observation(group), compute moves for
+ *      // pool.CurrentAgent(group).
+ *      pool.Send(moves, group);
+ *    }
+ *  \endcode
+ *
+ *  Send and Recv must be called from a single thread.
+ */
+class HanabiAsyncEnvPool {
+ public:
+  /** \brief Create the groups, observe their initial states and start the
+   *  workers. Every group is ready to be received right away.
+   *
+   *  \param game_params       Parameters of the game. See HanabiGame.
+   *  \param n_groups          Number of groups, i.e. of worker threads.
+   *  \param states_per_group  Number of parallel states in each group.
+   *  \param packed            Whether observations are bit-packed, see
+   *                           HanabiParallelEnv::ObserveAgentPacked.
+   *  \param threads_per_group Number of OpenMP threads each worker uses to
+   *                           step its group.
+   */
+  HanabiAsyncEnvPool(
+      const std::unordered_map<std::string, std::string>& game_params,
+      const int n_groups, const int states_per_group,
+      const bool packed = false, const int threads_per_group = 1);
+
+  /** \brief Stop and join the workers. Steps in flight are completed first.
+   */
+  ~HanabiAsyncEnvPool();
+
+  HanabiAsyncEnvPool(const HanabiAsyncEnvPool&) = delete;
+  HanabiAsyncEnvPool& operator=(const HanabiAsyncEnvPool&) = delete;
+
+  /** \brief Hand moves to a group and return without waiting for the step.
+   *
+   *  The group must have been returned by Recv since it was last sent to.
+   *  The moves are copied.
+   *
+   *  \param move_uids Uids of the moves of CurrentAgent(group), one for each
+   *                   state of the group.
+   */
+  void Send(const int* move_uids, const int group);
+
+  /** \brief Wait for a group to be ready and return it.
+   *
+   *  Polls briefly, then sleeps until a worker completes a group, so a
+   *  waiting caller does not take a core from the workers. The group's
+   *  observation and step results stay valid until it is sent to again.
+   */
+  int Recv();
+
+  /** \brief Id of the agent whose observation the group holds, i.e. the
+   *  agent to move next in the group.
+   */
+  int CurrentAgent(const int group) const;
+
+  /** \brief Last observation of a group, n states_per_group rows.
+   */
+  const HanabiParallelEnv::HanabiBatchObservationBuffers& Observation(
+      const int group) const;
+
+  /** \brief Results of the last step of a group. All zeros before the first
+   *  step.
+   */
+  const HanabiParallelEnv::HanabiStepResultBuffers& StepResults(
+      const int group) const;
+
+  /** \brief Get a const reference to the environment of a group.
+   *
+   *  Must not be used while the group is in flight.
+   */
+  const HanabiParallelEnv& GroupEnv(const int group) const;
+
+  /** \brief Get a reference to the HanabiGame game.
+   */
+  const HanabiGame& GetGame() const {return groups_.front()->env.GetGame();}
+
+  /** \brief Number of groups.
+   */
+  int NumGroups() const {return groups_.size();}
+
+  /** \brief Number of parallel states in each group.
+   */
+  int StatesPerGroup() const {return states_per_group_;}
+
+  /** \brief Number of bytes of a single row of the observation buffers.
+   */
+  int ObservationLength() const {return observation_len_;}
+
+  /** \brief Whether observations are bit-packed.
+   */
+  bool Packed() const {return packed_;}
+
+ private:
+  /** \brief A group of states and everything its worker needs.
+   */
+  struct Group {
+    Group(const std::unordered_map<std::string, std::string>& game_params,
+          const int n_states, const int first_stream, const bool packed);
+
+    HanabiParallelEnv env;                  //< States of the group.
+    int current_agent = 0;                  //< Agent to move next.
+    std::vector<int> moves;                 //< Moves handed over by Send.
+    bool pending = false;                   //< Whether moves wait to be applied, guarded by mutex.
+    bool in_flight = false;                 //< Whether sent and not yet received, used by the caller thread only.
+    std::mutex mutex;                       //< Guards pending.
+    std::condition_variable wake;           //< Signals pending and stopping.
+    std::vector<int8_t> observation;        //< Observation rows.
+    std::vector<int8_t> legal_moves;        //< Legal move rows.
+    std::vector<int16_t> scores;            //< Scores.
+    std::vector<int8_t> done;               //< Episode ended in the last step.
+    std::vector<int16_t> rewards;           //< Rewards of the last step.
+    std::vector<int16_t> final_scores;      //< Scores of episodes ended in the last step.
+    std::vector<int16_t> episode_lengths;   //< Lengths of episodes ended in the last step.
+    HanabiParallelEnv::HanabiBatchObservationBuffers observation_buffers;  //< Views of the observation vectors.
+    HanabiParallelEnv::HanabiStepResultBuffers result_buffers;             //< Views of the result vectors.
+  };
+
+  /** \brief Body of the worker thread of a group.
+   */
+  void Work(const int group_idx);
+
+  const int states_per_group_;                //< Number of states in each group.
+  const bool packed_;                         //< Whether observations are bit-packed.
+  const int threads_per_group_;               //< OpenMP threads used by each worker.
+  int observation_len_ = 0;                   //< Bytes in an observation row.
+  std::vector<std::unique_ptr<Group>> groups_;  //< Groups, one per worker.
+  HanabiCompletionQueue completions_;         //< Groups ready to be received.
+  std::atomic<bool> stopping_{false};         //< Set to shut the workers down.
+  std::vector<std::thread> workers_;          //< Worker threads, one per group.
+};
+
+}  // namespace hanabi_learning_env
+
+#endif // __HANABI_ASYNC_ENV_POOL_H__
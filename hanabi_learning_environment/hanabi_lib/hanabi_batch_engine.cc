@@ -0,0 +1,573 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hanabi_batch_engine.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "canonical_encoders.h"
+#include "hanabi_move.h"
+#include "util.h"
+
+namespace {
+
+// Games stepped and encoded together. Small enough for a block of state and
+// observation rows to stay in the L2 cache.
+constexpr int kBlockSize = 256;
+
+}  // namespace
+
+hanabi_learning_env::HanabiBatchEngine::HanabiBatchEngine(
+    const std::unordered_map<std::string, std::string>& game_params,
+    const int n_games, const int first_stream, const bool specialize)
+  : game_(game_params),
+    n_games_(n_games),
+    first_stream_(first_stream),
+    num_players_(game_.NumPlayers()),
+    num_colors_(game_.NumColors()),
+    num_ranks_(game_.NumRanks()),
+    num_cards_(game_.NumColors() * game_.NumRanks()),
+    hand_size_max_(game_.HandSize()) {
+  REQUIRE(n_games_ > 0);
+  // Reveal masks are bytes and legal moves fit a 64-bit mask.
+  REQUIRE(hand_size_max_ <= 8);
+  REQUIRE(game_.MaxMoves() <= 64);
+  if (specialize) {
+    fixed_ = NewFixedBatchEngine(&game_, n_games_, first_stream_);
+    if (fixed_ != nullptr) {
+      observation_len_ = fixed_->ObservationLength();
+      return;
+    }
+  }
+
+  for (int uid = 0; uid < game_.MaxMoves(); ++uid) {
+    const HanabiMove move = game_.GetMove(uid);
+    move_type_.push_back(move.MoveType());
+    move_card_index_.push_back(move.CardIndex());
+    move_target_.push_back(move.TargetOffset());
+    move_value_.push_back(move.MoveType() == HanabiMove::kRevealColor
+                              ? move.Color()
+                              : move.Rank());
+  }
+  for (int card = 0; card < num_cards_; ++card) {
+    card_color_.push_back(card / num_ranks_);
+    card_rank_.push_back(card % num_ranks_);
+  }
+
+  // Section layout of CanonicalObservationEncoder.
+  const int deck_len = game_.MaxDeckSize() - num_players_ * hand_size_max_;
+  hands_offset_ = 0;
+  board_offset_ =
+      hands_offset_ + (num_players_ - 1) * hand_size_max_ * num_cards_ +
+      num_players_;
+  discards_offset_ = board_offset_ + deck_len + num_cards_ +
+                     game_.MaxInformationTokens() + game_.MaxLifeTokens();
+  int offset = discards_offset_;
+  for (int card = 0; card < num_cards_; ++card) {
+    discard_card_offsets_.push_back(offset);
+    offset += game_.NumberCardInstances(card_color_[card], card_rank_[card]);
+  }
+  last_action_offset_ = offset;
+  offset += 2 * num_players_ + 4 + num_colors_ + num_ranks_ +
+            2 * hand_size_max_ + num_cards_ + 2;
+  if (game_.ObservationType() != HanabiGame::kMinimal) {
+    knowledge_offset_ = offset;
+    offset += num_players_ * hand_size_max_ *
+              (num_cards_ + num_colors_ + num_ranks_);
+  }
+  observation_len_ = offset;
+  REQUIRE(observation_len_ ==
+          CanonicalObservationEncoder(&game_).Shape().front());
+
+  rng_.resize(n_games_);
+  episode_counters_.assign(n_games_, 0);
+  episode_lengths_.assign(n_games_, 0);
+  cur_player_.resize(n_games_);
+  information_tokens_.resize(n_games_);
+  life_tokens_.resize(n_games_);
+  turns_to_play_.resize(n_games_);
+  deck_size_.resize(n_games_);
+  fireworks_total_.resize(n_games_);
+  last_player_.resize(n_games_);
+  last_type_.resize(n_games_);
+  last_card_index_.resize(n_games_);
+  last_target_.resize(n_games_);
+  last_value_.resize(n_games_);
+  last_card_.resize(n_games_);
+  last_reveal_mask_.resize(n_games_);
+  last_scored_.resize(n_games_);
+  last_information_token_.resize(n_games_);
+  fireworks_.resize(n_games_ * num_colors_);
+  deck_counts_.resize(n_games_ * num_cards_);
+  discard_counts_.resize(n_games_ * num_cards_);
+  hand_size_.resize(n_games_ * num_players_);
+  const int n_slots = n_games_ * num_players_ * hand_size_max_;
+  cards_.resize(n_slots);
+  color_plausible_.resize(n_slots);
+  rank_plausible_.resize(n_slots);
+  color_hinted_.resize(n_slots);
+  rank_hinted_.resize(n_slots);
+
+  Reset();
+}
+
+void hanabi_learning_env::HanabiBatchEngine::Reset() {
+  if (fixed_ != nullptr) {
+    fixed_->Reset();
+    return;
+  }
+  #pragma omp parallel for schedule(static)
+  for (int game = 0; game < n_games_; ++game) {
+    NewGame(game);
+  }
+}
+
+int hanabi_learning_env::HanabiBatchEngine::Score(const int game) const {
+  if (fixed_ != nullptr) {
+    return fixed_->Score(game);
+  }
+  return life_tokens_[game] > 0 ? fireworks_total_[game] : 0;
+}
+
+void hanabi_learning_env::HanabiBatchEngine::NewGame(const int game) {
+  rng_[game] = CounterRng(static_cast<uint64_t>(game_.Seed()),
+                          first_stream_ + game, episode_counters_[game]++);
+  episode_lengths_[game] = 0;
+  cur_player_[game] = game_.GetSampledStartPlayer(&rng_[game]);
+  information_tokens_[game] = game_.MaxInformationTokens();
+  life_tokens_[game] = game_.MaxLifeTokens();
+  turns_to_play_[game] = num_players_;
+  deck_size_[game] = game_.MaxDeckSize();
+  fireworks_total_[game] = 0;
+  last_player_[game] = -1;
+  std::fill_n(&fireworks_[game * num_colors_], num_colors_, 0);
+  for (int card = 0; card < num_cards_; ++card) {
+    deck_counts_[game * num_cards_ + card] =
+        game_.NumberCardInstances(card_color_[card], card_rank_[card]);
+  }
+  std::fill_n(&discard_counts_[game * num_cards_], num_cards_, 0);
+  std::fill_n(&hand_size_[game * num_players_], num_players_, 0);
+  const int first_slot = Slot(game, 0, 0);
+  const int n_slots = num_players_ * hand_size_max_;
+  std::fill_n(&cards_[first_slot], n_slots, -1);
+  std::fill_n(&color_hinted_[first_slot], n_slots, -1);
+  std::fill_n(&rank_hinted_[first_slot], n_slots, -1);
+  for (int player = 0; player < num_players_; ++player) {
+    for (int card = 0; card < hand_size_max_; ++card) {
+      DealCard(game, player);
+    }
+  }
+}
+
+void hanabi_learning_env::HanabiBatchEngine::DealCard(const int game,
+                                                      const int player) {
+  uint8_t* deck_counts = &deck_counts_[game * num_cards_];
+  uint32_t pick = rng_[game].Below(deck_size_[game]);
+  int card = 0;
+  while (pick >= deck_counts[card]) {
+    pick -= deck_counts[card];
+    ++card;
+  }
+  --deck_counts[card];
+  --deck_size_[game];
+
+  const int slot = Slot(game, player, hand_size_[game * num_players_ + player]++);
+  cards_[slot] = card;
+  if (game_.ObservationType() == HanabiGame::kSeer) {
+    color_plausible_[slot] = 1 << card_color_[card];
+    rank_plausible_[slot] = 1 << card_rank_[card];
+    color_hinted_[slot] = card_color_[card];
+    rank_hinted_[slot] = card_rank_[card];
+  } else {
+    color_plausible_[slot] = (1 << num_colors_) - 1;
+    rank_plausible_[slot] = (1 << num_ranks_) - 1;
+    color_hinted_[slot] = -1;
+    rank_hinted_[slot] = -1;
+  }
+}
+
+uint64_t hanabi_learning_env::HanabiBatchEngine::LegalMovesMask(
+    const int game) const {
+  const int player = cur_player_[game];
+  const uint64_t cards_mask =
+      (static_cast<uint64_t>(1) << hand_size_[game * num_players_ + player]) -
+      1;
+  uint64_t mask = cards_mask << hand_size_max_;
+  if (information_tokens_[game] < game_.MaxInformationTokens()) {
+    mask |= cards_mask;
+  }
+  if (information_tokens_[game] > 0) {
+    const int color_hints = 2 * hand_size_max_;
+    const int rank_hints = color_hints + (num_players_ - 1) * num_colors_;
+    for (int offset = 1; offset < num_players_; ++offset) {
+      const int target = (player + offset) % num_players_;
+      uint64_t colors = 0;
+      uint64_t ranks = 0;
+      for (int card_index = 0;
+           card_index < hand_size_[game * num_players_ + target];
+           ++card_index) {
+        const int card = cards_[Slot(game, target, card_index)];
+        colors |= static_cast<uint64_t>(1) << card_color_[card];
+        ranks |= static_cast<uint64_t>(1) << card_rank_[card];
+      }
+      mask |= colors << (color_hints + (offset - 1) * num_colors_);
+      mask |= ranks << (rank_hints + (offset - 1) * num_ranks_);
+    }
+  }
+  return mask;
+}
+
+void hanabi_learning_env::HanabiBatchEngine::LegalMovesMasks(
+    uint64_t* masks) const {
+  if (fixed_ != nullptr) {
+    fixed_->LegalMovesMasks(masks);
+    return;
+  }
+  #pragma omp parallel for schedule(static)
+  for (int game = 0; game < n_games_; ++game) {
+    masks[game] = LegalMovesMask(game);
+  }
+}
+
+void hanabi_learning_env::HanabiBatchEngine::ApplyMove(const int game,
+                                                       const int move_uid) {
+  REQUIRE(move_uid >= 0 && move_uid < game_.MaxMoves());
+  REQUIRE((LegalMovesMask(game) >> move_uid) & 1);
+  const int player = cur_player_[game];
+  if (deck_size_[game] == 0) {
+    --turns_to_play_[game];
+  }
+  const int type = move_type_[move_uid];
+  last_player_[game] = player;
+  last_type_[game] = type;
+  last_card_index_[game] = move_card_index_[move_uid];
+  last_target_[game] = move_target_[move_uid];
+  last_value_[game] = move_value_[move_uid];
+  last_card_[game] = -1;
+  last_reveal_mask_[game] = 0;
+  last_scored_[game] = 0;
+  last_information_token_[game] = 0;
+
+  switch (type) {
+    case HanabiMove::kPlay:
+    case HanabiMove::kDiscard: {
+      const int card_index = move_card_index_[move_uid];
+      const int card = cards_[Slot(game, player, card_index)];
+      last_card_[game] = card;
+      bool to_discards = true;
+      if (type == HanabiMove::kDiscard) {
+        ++information_tokens_[game];
+        last_information_token_[game] = 1;
+      } else if (fireworks_[game * num_colors_ + card_color_[card]] ==
+                 card_rank_[card]) {
+        to_discards = false;
+        last_scored_[game] = 1;
+        ++fireworks_total_[game];
+        if (++fireworks_[game * num_colors_ + card_color_[card]] ==
+                num_ranks_ &&
+            information_tokens_[game] < game_.MaxInformationTokens()) {
+          ++information_tokens_[game];
+          last_information_token_[game] = 1;
+        }
+      } else {
+        --life_tokens_[game];
+      }
+      if (to_discards) {
+        ++discard_counts_[game * num_cards_ + card];
+      }
+      // Close the gap, keeping the cards ordered from oldest to newest.
+      const int hand_size = hand_size_[game * num_players_ + player]--;
+      for (int slot = Slot(game, player, card_index);
+           slot < Slot(game, player, hand_size - 1); ++slot) {
+        cards_[slot] = cards_[slot + 1];
+        color_plausible_[slot] = color_plausible_[slot + 1];
+        rank_plausible_[slot] = rank_plausible_[slot + 1];
+        color_hinted_[slot] = color_hinted_[slot + 1];
+        rank_hinted_[slot] = rank_hinted_[slot + 1];
+      }
+      cards_[Slot(game, player, hand_size - 1)] = -1;
+      if (deck_size_[game] > 0) {
+        DealCard(game, player);
+      }
+      break;
+    }
+    case HanabiMove::kRevealColor:
+    case HanabiMove::kRevealRank: {
+      --information_tokens_[game];
+      const int target = (player + move_target_[move_uid]) % num_players_;
+      const int value = move_value_[move_uid];
+      const bool color = type == HanabiMove::kRevealColor;
+      const std::vector<int8_t>& card_values = color ? card_color_ : card_rank_;
+      std::vector<uint8_t>& plausible =
+          color ? color_plausible_ : rank_plausible_;
+      std::vector<int8_t>& hinted = color ? color_hinted_ : rank_hinted_;
+      uint8_t reveal_mask = 0;
+      for (int card_index = 0;
+           card_index < hand_size_[game * num_players_ + target];
+           ++card_index) {
+        const int slot = Slot(game, target, card_index);
+        if (card_values[cards_[slot]] == value) {
+          reveal_mask |= 1 << card_index;
+          plausible[slot] = 1 << value;
+          hinted[slot] = value;
+        } else {
+          plausible[slot] &= ~(1 << value);
+        }
+      }
+      last_reveal_mask_[game] = reveal_mask;
+      break;
+    }
+    default:
+      std::abort();  // Should not be possible.
+  }
+  ++episode_lengths_[game];
+  cur_player_[game] = (player + 1) % num_players_;
+}
+
+void hanabi_learning_env::HanabiBatchEngine::StepBlock(
+    const int begin, const int end, const int* move_uids, int8_t* done,
+    const HanabiParallelEnv::HanabiStepResultBuffers& results) {
+  for (int game = begin; game < end; ++game) {
+    const int score_before = Score(game);
+    ApplyMove(game, move_uids[game]);
+    results.rewards[game] = Score(game) - score_before;
+    done[game] = life_tokens_[game] < 1 || fireworks_total_[game] >= num_cards_ ||
+                 turns_to_play_[game] <= 0;
+    if (done[game]) {
+      results.final_scores[game] = Score(game);
+      results.episode_lengths[game] = episode_lengths_[game];
+      NewGame(game);
+    } else {
+      results.final_scores[game] = 0;
+      results.episode_lengths[game] = 0;
+    }
+  }
+}
+
+void hanabi_learning_env::HanabiBatchEngine::ObserveBlock(
+    const int begin, const int end,
+    const HanabiParallelEnv::HanabiBatchObservationBuffers& buffers) const {
+  const int num_players = num_players_;
+  const int hand_size_max = hand_size_max_;
+  const int num_cards = num_cards_;
+  const int num_colors = num_colors_;
+  const int num_ranks = num_ranks_;
+  int8_t* const observations = buffers.observation;
+  auto row = [observations, this](int game) {
+    return observations + static_cast<int64_t>(game) * observation_len_;
+  };
+
+  std::fill(row(begin), row(end), 0);
+
+  // Hands of the other players and missing cards.
+  const int missing_offset =
+      hands_offset_ + (num_players - 1) * hand_size_max * num_cards;
+  for (int game = begin; game < end; ++game) {
+    int8_t* encoding = row(game);
+    const int observer = cur_player_[game];
+    for (int offset = 0; offset < num_players; ++offset) {
+      const int player = (observer + offset) % num_players;
+      const int hand_size = hand_size_[game * num_players + player];
+      if (offset > 0) {
+        const int8_t* cards = &cards_[Slot(game, player, 0)];
+        int8_t* hand =
+            encoding + hands_offset_ + (offset - 1) * hand_size_max * num_cards;
+        for (int card_index = 0; card_index < hand_size; ++card_index) {
+          hand[card_index * num_cards + cards[card_index]] = 1;
+        }
+      }
+      encoding[missing_offset + offset] = hand_size < hand_size_max;
+    }
+  }
+
+  // Board: deck size, fireworks, information and life tokens.
+  const int fireworks_offset =
+      board_offset_ + game_.MaxDeckSize() - num_players * hand_size_max;
+  const int information_offset = fireworks_offset + num_cards;
+  const int life_offset = information_offset + game_.MaxInformationTokens();
+  for (int game = begin; game < end; ++game) {
+    int8_t* encoding = row(game);
+    std::fill_n(encoding + board_offset_, deck_size_[game], 1);
+    for (int color = 0; color < num_colors; ++color) {
+      const int fireworks = fireworks_[game * num_colors + color];
+      if (fireworks > 0) {
+        encoding[fireworks_offset + color * num_ranks + fireworks - 1] = 1;
+      }
+    }
+    std::fill_n(encoding + information_offset, information_tokens_[game], 1);
+    std::fill_n(encoding + life_offset, life_tokens_[game], 1);
+  }
+
+  // Discards.
+  for (int game = begin; game < end; ++game) {
+    int8_t* encoding = row(game);
+    const uint8_t* discard_counts = &discard_counts_[game * num_cards];
+    for (int card = 0; card < num_cards; ++card) {
+      std::fill_n(encoding + discard_card_offsets_[card], discard_counts[card],
+                  1);
+    }
+  }
+
+  // Last action, see EncodeLastActionItem.
+  const int type_offset = last_action_offset_ + num_players;
+  const int target_offset = type_offset + 4;
+  const int color_offset = target_offset + num_players;
+  const int rank_offset = color_offset + num_colors;
+  const int outcome_offset = rank_offset + num_ranks;
+  const int position_offset = outcome_offset + hand_size_max;
+  const int card_offset = position_offset + hand_size_max;
+  const int play_offset = card_offset + num_cards;
+  for (int game = begin; game < end; ++game) {
+    if (last_player_[game] < 0) {
+      continue;
+    }
+    int8_t* encoding = row(game);
+    const int player =
+        (last_player_[game] - cur_player_[game] + num_players) % num_players;
+    encoding[last_action_offset_ + player] = 1;
+    switch (last_type_[game]) {
+      case HanabiMove::kPlay:
+        encoding[type_offset] = 1;
+        encoding[play_offset] = last_scored_[game];
+        encoding[play_offset + 1] = last_information_token_[game];
+        encoding[position_offset + last_card_index_[game]] = 1;
+        encoding[card_offset + last_card_[game]] = 1;
+        break;
+      case HanabiMove::kDiscard:
+        encoding[type_offset + 1] = 1;
+        encoding[position_offset + last_card_index_[game]] = 1;
+        encoding[card_offset + last_card_[game]] = 1;
+        break;
+      case HanabiMove::kRevealColor:
+      case HanabiMove::kRevealRank: {
+        const bool color = last_type_[game] == HanabiMove::kRevealColor;
+        encoding[type_offset + (color ? 2 : 3)] = 1;
+        encoding[target_offset +
+                 (player + last_target_[game]) % num_players] = 1;
+        encoding[(color ? color_offset : rank_offset) + last_value_[game]] = 1;
+        for (int card_index = 0; card_index < hand_size_max; ++card_index) {
+          encoding[outcome_offset + card_index] =
+              (last_reveal_mask_[game] >> card_index) & 1;
+        }
+        break;
+      }
+    }
+  }
+
+  // Card knowledge of all players, including the observer.
+  if (knowledge_offset_ >= 0) {
+    const int card_len = num_cards + num_colors + num_ranks;
+    for (int game = begin; game < end; ++game) {
+      int8_t* encoding = row(game);
+      const int observer = cur_player_[game];
+      for (int offset = 0; offset < num_players; ++offset) {
+        const int player = (observer + offset) % num_players;
+        int8_t* knowledge =
+            encoding + knowledge_offset_ + offset * hand_size_max * card_len;
+        for (int card_index = 0;
+             card_index < hand_size_[game * num_players + player];
+             ++card_index, knowledge += card_len) {
+          const int slot = Slot(game, player, card_index);
+          const int ranks = rank_plausible_[slot];
+          for (int colors = color_plausible_[slot]; colors != 0;
+               colors &= colors - 1) {
+            int8_t* plausible = knowledge + LowestSetBit(colors) * num_ranks;
+            for (int rank = 0; rank < num_ranks; ++rank) {
+              plausible[rank] = (ranks >> rank) & 1;
+            }
+          }
+          if (color_hinted_[slot] >= 0) {
+            knowledge[num_cards + color_hinted_[slot]] = 1;
+          }
+          if (rank_hinted_[slot] >= 0) {
+            knowledge[num_cards + num_colors + rank_hinted_[slot]] = 1;
+          }
+        }
+      }
+    }
+  }
+
+  // Legal moves and scores.
+  const int max_moves = game_.MaxMoves();
+  for (int game = begin; game < end; ++game) {
+    const uint64_t mask = LegalMovesMask(game);
+    int8_t* legal_moves = buffers.legal_moves + game * max_moves;
+    for (int uid = 0; uid < max_moves; ++uid) {
+      legal_moves[uid] = (mask >> uid) & 1;
+    }
+    buffers.scores[game] = Score(game);
+  }
+}
+
+void hanabi_learning_env::HanabiBatchEngine::Step(
+    const int* move_uids, int8_t* done,
+    const HanabiParallelEnv::HanabiStepResultBuffers& results) {
+  if (fixed_ != nullptr) {
+    fixed_->Step(move_uids, done, results);
+    return;
+  }
+  REQUIRE(move_uids != nullptr);
+  REQUIRE(done != nullptr);
+  REQUIRE(results.rewards != nullptr);
+  REQUIRE(results.final_scores != nullptr);
+  REQUIRE(results.episode_lengths != nullptr);
+  #pragma omp parallel for schedule(static)
+  for (int begin = 0; begin < n_games_; begin += kBlockSize) {
+    StepBlock(begin, std::min(begin + kBlockSize, n_games_), move_uids, done,
+              results);
+  }
+}
+
+void hanabi_learning_env::HanabiBatchEngine::Observe(
+    const HanabiParallelEnv::HanabiBatchObservationBuffers& buffers) const {
+  if (fixed_ != nullptr) {
+    fixed_->Observe(buffers);
+    return;
+  }
+  REQUIRE(buffers.observation != nullptr);
+  REQUIRE(buffers.legal_moves != nullptr);
+  REQUIRE(buffers.scores != nullptr);
+  REQUIRE(buffers.done != nullptr);
+  #pragma omp parallel for schedule(static)
+  for (int begin = 0; begin < n_games_; begin += kBlockSize) {
+    const int end = std::min(begin + kBlockSize, n_games_);
+    ObserveBlock(begin, end, buffers);
+    std::fill(buffers.done + begin, buffers.done + end, 0);
+  }
+}
+
+void hanabi_learning_env::HanabiBatchEngine::StepAndObserve(
+    const int* move_uids,
+    const HanabiParallelEnv::HanabiBatchObservationBuffers& buffers,
+    const HanabiParallelEnv::HanabiStepResultBuffers& results) {
+  if (fixed_ != nullptr) {
+    fixed_->StepAndObserve(move_uids, buffers, results);
+    return;
+  }
+  REQUIRE(move_uids != nullptr);
+  REQUIRE(buffers.observation != nullptr);
+  REQUIRE(buffers.legal_moves != nullptr);
+  REQUIRE(buffers.scores != nullptr);
+  REQUIRE(buffers.done != nullptr);
+  REQUIRE(results.rewards != nullptr);
+  REQUIRE(results.final_scores != nullptr);
+  REQUIRE(results.episode_lengths != nullptr);
+  #pragma omp parallel for schedule(static)
+  for (int begin = 0; begin < n_games_; begin += kBlockSize) {
+    const int end = std::min(begin + kBlockSize, n_games_);
+    StepBlock(begin, end, move_uids, buffers.done, results);
+    ObserveBlock(begin, end, buffers);
+  }
+}
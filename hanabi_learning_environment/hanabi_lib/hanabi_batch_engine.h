@@ -0,0 +1,259 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __HANABI_BATCH_ENGINE_H__
+#define __HANABI_BATCH_ENGINE_H__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "counter_rng.h"
+#include "hanabi_fixed_engine.h"
+#include "hanabi_game.h"
+#include "hanabi_parallel_env.h"
+
+namespace hanabi_learning_env {
+
+/** \brief Batched game engine storing many games as a structure of arrays.
+ *
+ *  An alternative to HanabiParallelEnv for very large batches. Instead of a
+ *  HanabiState per game, with its hands, knowledge, deck and history in
+ *  separate heap blocks, every field of every game lives in one contiguous
+ *  array (fireworks, tokens, hands, knowledge bitmasks, deck and discard
+ *  counts, ...), indexed by game. Only what the canonical observation needs
+ *  is kept; there is no move history beyond the last move.
+ *
+ *  Chance moves are not exposed: the cards are dealt as part of the move
+ *  which needs them, so every game always waits for its current player.
+ *  Observations are those of the current player, encoded exactly like
+ *  CanonicalObservationEncoder would encode HanabiObservation(state,
+ *  current player). The engine is dealt from its own random streams, so its
+ *  games differ from those of a HanabiParallelEnv with the same seed.
+ *
+ *  Games are processed in blocks; each block is stepped and then encoded one
+ *  section at a time across all its games, so the block stays in cache and
+ *  the section loops run over contiguous arrays.
+ *
+ *  Standard configurations are run by a FixedBatchEngine instead, which
+ *  plays and encodes the same games with compile-time sizes and offsets.
+ */
+class HanabiBatchEngine {
+ public:
+  /** \brief Construct an engine and deal all games.
+   *
+   *  \param game_params Parameters of the game. See HanabiGame.
+   *  \param n_games Number of games.
+   *  \param first_stream Random stream of the first game, see
+   *         HanabiParallelEnv::HanabiParallelEnv.
+   *  \param specialize Use a FixedBatchEngine if there is one for the
+   *         configuration, see NewFixedBatchEngine.
+   */
+  HanabiBatchEngine(
+      const std::unordered_map<std::string, std::string>& game_params,
+      const int n_games, const int first_stream = 0,
+      const bool specialize = true);
+
+  /** \brief Start a new episode in every game.
+   */
+  void Reset();
+
+  /** \brief Apply one move of the current player in every game.
+   *
+   *  Games which end are replaced by new ones; their done flag is set and
+   *  their final score and length are reported in results.
+   *
+   *  \param move_uids Uids of the moves, one for each game.
+   *  \param done Caller-owned buffer of n_games termination flags.
+   */
+  void Step(const int* move_uids, int8_t* done,
+            const HanabiParallelEnv::HanabiStepResultBuffers& results);
+
+  /** \brief Write the observations of the current players.
+   *
+   *  Fills observation, legal moves and scores of buffers, see
+   *  HanabiParallelEnv::ObserveAgent; done flags are cleared.
+   */
+  void Observe(const HanabiParallelEnv::HanabiBatchObservationBuffers& buffers)
+      const;
+
+  /** \brief Step and observe in one pass over the games.
+   *
+   *  Equivalent to Step followed by Observe, except that buffers.done holds
+   *  the done flags of the step.
+   */
+  void StepAndObserve(
+      const int* move_uids,
+      const HanabiParallelEnv::HanabiBatchObservationBuffers& buffers,
+      const HanabiParallelEnv::HanabiStepResultBuffers& results);
+
+  /** \brief Legal moves of the current player of every game, bit uid set
+   *  iff move uid is legal (see HanabiState::LegalMovesMask).
+   */
+  void LegalMovesMasks(uint64_t* masks) const;
+
+  /** \brief Get a reference to the HanabiGame game.
+   */
+  const HanabiGame& GetGame() const {return game_;}
+
+  /** \brief Number of games.
+   */
+  int NumGames() const {return n_games_;}
+
+  /** \brief Length of a single flat encoded observation.
+   */
+  int ObservationLength() const {return observation_len_;}
+
+  /** \brief Whether the games are run by a FixedBatchEngine.
+   */
+  bool IsSpecialized() const {return fixed_ != nullptr;}
+
+  /** \name Read access to the state of a game.
+   *
+   *  Cards are indices color * num_ranks + rank, -1 for no card.
+   *  @{
+   */
+  int CurPlayer(const int game) const {
+    return fixed_ ? fixed_->CurPlayer(game) : cur_player_[game];
+  }
+  int InformationTokens(const int game) const {
+    return fixed_ ? fixed_->InformationTokens(game) : information_tokens_[game];
+  }
+  int LifeTokens(const int game) const {
+    return fixed_ ? fixed_->LifeTokens(game) : life_tokens_[game];
+  }
+  int DeckSize(const int game) const {
+    return fixed_ ? fixed_->DeckSize(game) : deck_size_[game];
+  }
+  int Score(const int game) const;
+  int Fireworks(const int game, const int color) const {
+    return fixed_ ? fixed_->Fireworks(game, color)
+                  : fireworks_[game * num_colors_ + color];
+  }
+  int HandSize(const int game, const int player) const {
+    return fixed_ ? fixed_->HandSize(game, player)
+                  : hand_size_[game * num_players_ + player];
+  }
+  int Card(const int game, const int player, const int slot) const {
+    return fixed_ ? fixed_->Card(game, player, slot)
+                  : cards_[Slot(game, player, slot)];
+  }
+  /** @} */
+
+ private:
+  /** \brief Index of a card slot in the per-slot arrays.
+   */
+  int Slot(const int game, const int player, const int slot) const {
+    return (game * num_players_ + player) * hand_size_max_ + slot;
+  }
+
+  /** \brief Start a new episode in a game and deal the hands.
+   */
+  void NewGame(const int game);
+
+  /** \brief Draw a random card from the deck of a game into a hand.
+   */
+  void DealCard(const int game, const int player);
+
+  /** \brief Apply a move of the current player of a game and the deal which
+   *  follows it.
+   */
+  void ApplyMove(const int game, const int move_uid);
+
+  /** \brief Step games [begin, end).
+   */
+  void StepBlock(const int begin, const int end, const int* move_uids,
+                 int8_t* done,
+                 const HanabiParallelEnv::HanabiStepResultBuffers& results);
+
+  /** \brief Encode games [begin, end), section by section.
+   */
+  void ObserveBlock(
+      const int begin, const int end,
+      const HanabiParallelEnv::HanabiBatchObservationBuffers& buffers) const;
+
+  uint64_t LegalMovesMask(const int game) const;
+
+  HanabiGame game_;                       //< Game parameters.
+  const int n_games_;                     //< Number of games.
+  const int first_stream_;                //< Random stream of game 0.
+  const int num_players_;                 //< Players per game.
+  const int num_colors_;                  //< Colors.
+  const int num_ranks_;                   //< Ranks.
+  const int num_cards_;                   //< Distinct cards, colors x ranks.
+  const int hand_size_max_;               //< Cards in a full hand.
+  int observation_len_ = 0;               //< Length of an encoded observation.
+  std::unique_ptr<FixedBatchEngineBase> fixed_;  //< Specialized engine running the games, if any.
+
+  // Move uid decoding.
+  std::vector<int8_t> move_type_;         //< HanabiMove::Type per uid.
+  std::vector<int8_t> move_card_index_;   //< Card index per uid, -1 if none.
+  std::vector<int8_t> move_target_;       //< Target offset per uid, -1 if none.
+  std::vector<int8_t> move_value_;        //< Hinted color or rank per uid, -1 if none.
+  std::vector<int8_t> card_color_;        //< Color per card index.
+  std::vector<int8_t> card_rank_;         //< Rank per card index.
+
+  // Encoding layout.
+  int hands_offset_ = 0;                  //< Start of the hands section.
+  int board_offset_ = 0;                  //< Start of the board section.
+  int discards_offset_ = 0;               //< Start of the discards section.
+  int last_action_offset_ = 0;            //< Start of the last action section.
+  int knowledge_offset_ = -1;             //< Start of the card knowledge section, -1 if none.
+  std::vector<int> discard_card_offsets_; //< Start of the thermometer of each card in the discards section.
+
+  // Per game, [game].
+  std::vector<CounterRng> rng_;           //< Random stream of the current episode.
+  std::vector<uint64_t> episode_counters_;//< Episodes started.
+  std::vector<int> episode_lengths_;      //< Moves made in the current episode.
+  std::vector<int8_t> cur_player_;        //< Player to move.
+  std::vector<int8_t> information_tokens_;//< Information tokens.
+  std::vector<int8_t> life_tokens_;       //< Life tokens.
+  std::vector<int8_t> turns_to_play_;     //< Moves left once the deck is empty.
+  std::vector<int8_t> deck_size_;         //< Cards left in the deck.
+  std::vector<int8_t> fireworks_total_;   //< Sum of the fireworks.
+
+  // Last move, [game]. last_player_ is -1 if there was none.
+  std::vector<int8_t> last_player_;       //< Player who made it.
+  std::vector<int8_t> last_type_;         //< HanabiMove::Type.
+  std::vector<int8_t> last_card_index_;   //< Position played or discarded.
+  std::vector<int8_t> last_target_;       //< Target offset of a hint.
+  std::vector<int8_t> last_value_;        //< Color or rank of a hint.
+  std::vector<int8_t> last_card_;         //< Card played or discarded.
+  std::vector<uint8_t> last_reveal_mask_; //< Cards a hint touched.
+  std::vector<uint8_t> last_scored_;      //< Play added to the fireworks.
+  std::vector<uint8_t> last_information_token_;  //< Move gained a token.
+
+  // Per game and color or card, [game * num_colors_ + color] and
+  // [game * num_cards_ + card].
+  std::vector<int8_t> fireworks_;         //< Cards played per color.
+  std::vector<uint8_t> deck_counts_;      //< Copies of each card left in the deck.
+  std::vector<uint8_t> discard_counts_;   //< Copies of each card discarded.
+
+  // Per game and player, [game * num_players_ + player].
+  std::vector<int8_t> hand_size_;         //< Cards in the hand.
+
+  // Per card slot, [Slot(game, player, slot)]. Slots are ordered from oldest
+  // to newest card, like HanabiHand.
+  std::vector<int8_t> cards_;             //< Card, -1 if empty.
+  std::vector<uint8_t> color_plausible_;  //< Bit c set iff color c is plausible.
+  std::vector<uint8_t> rank_plausible_;   //< Bit r set iff rank r is plausible.
+  std::vector<int8_t> color_hinted_;      //< Hinted color, -1 if none.
+  std::vector<int8_t> rank_hinted_;       //< Hinted rank, -1 if none.
+};
+
+}  // namespace hanabi_learning_env
+
+#endif // __HANABI_BATCH_ENGINE_H__
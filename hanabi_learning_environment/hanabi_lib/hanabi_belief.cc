@@ -0,0 +1,126 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hanabi_belief.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+namespace {
+
+int CardIndex(int color, int rank, int num_ranks) {
+  return color * num_ranks + rank;
+}
+
+}  // namespace
+
+int BeliefLength(const HanabiGame& game) {
+  return game.HandSize() * game.NumColors() * game.NumRanks();
+}
+
+void UnseenCardCounts(const HanabiState& state, int observer,
+                      uint8_t* counts) {
+  const HanabiGame& game = *state.ParentGame();
+  for (int c = 0; c < game.NumColors(); ++c) {
+    for (int r = 0; r < game.NumRanks(); ++r) {
+      counts[CardIndex(c, r, game.NumRanks())] = state.Deck().CardCount(c, r);
+    }
+  }
+  for (const HanabiCard& card : state.Hands()[observer].Cards()) {
+    ++counts[CardIndex(card.Color(), card.Rank(), game.NumRanks())];
+  }
+}
+
+void EncodeHandBeliefs(const HanabiGame& game, const HanabiHand& hand,
+                       const uint8_t* unseen_counts, float* beliefs) {
+  const int num_cards = game.NumColors() * game.NumRanks();
+  const bool hide_knowledge = game.ObservationType() == HanabiGame::kMinimal;
+  const uint32_t all_cards = (static_cast<uint32_t>(1) << num_cards) - 1;
+  std::fill(beliefs, beliefs + BeliefLength(game), 0.0f);
+  const std::vector<HanabiHand::CardKnowledge>& knowledge = hand.Knowledge();
+  for (int i = 0; i < knowledge.size(); ++i) {
+    const uint32_t plausible =
+        hide_knowledge ? all_cards : knowledge[i].PlausibleMask();
+    float* row = beliefs + i * num_cards;
+    // Branch-free over all cards, so the loops vectorize.
+    float total = 0;
+    for (int card = 0; card < num_cards; ++card) {
+      row[card] = static_cast<float>(((plausible >> card) & 1) *
+                                     unseen_counts[card]);
+      total += row[card];
+    }
+    // The card itself is unseen and plausible, so total > 0.
+    assert(total > 0);
+    const float scale = 1.0f / total;
+    for (int card = 0; card < num_cards; ++card) {
+      row[card] *= scale;
+    }
+  }
+}
+
+HanabiBeliefTracker::HanabiBeliefTracker(const HanabiGame* parent_game)
+    : parent_game_(parent_game),
+      unseen_counts_(parent_game->NumColors() * parent_game->NumRanks(), 0) {}
+
+void HanabiBeliefTracker::Update(const HanabiState& state, int observer) {
+  // Counting from scratch is cheap; what is saved is walking the hands. The
+  // moves since the previous update must all be in the history.
+  if (!valid_ || observer != observer_ || state.NumMoves() < num_moves_ ||
+      state.HistoryStart() > num_moves_) {
+    UnseenCardCounts(state, observer, unseen_counts_.data());
+    valid_ = true;
+    observer_ = observer;
+    num_moves_ = state.NumMoves();
+    return;
+  }
+  const int num_ranks = parent_game_->NumRanks();
+  const auto& history = state.MoveHistory();
+  const int history_start = state.HistoryStart();
+  for (int i = num_moves_; i < state.NumMoves(); ++i) {
+    const HanabiHistoryItem& item = history[i - history_start];
+    switch (item.move.MoveType()) {
+      case HanabiMove::kDeal:
+        // A card dealt to someone else is seen, one dealt to the observer
+        // moves from the deck to the observer's hand and stays unseen.
+        if (item.deal_to_player != observer) {
+          --unseen_counts_[CardIndex(item.move.Color(), item.move.Rank(),
+                                     num_ranks)];
+        }
+        break;
+      case HanabiMove::kPlay:
+      case HanabiMove::kDiscard:
+        // Only the observer's own cards are revealed by playing them.
+        if (item.player == observer) {
+          --unseen_counts_[CardIndex(item.color, item.rank, num_ranks)];
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  num_moves_ = state.NumMoves();
+}
+
+void HanabiBeliefTracker::Beliefs(const HanabiState& state, int observer,
+                                  float* beliefs) {
+  Update(state, observer);
+  EncodeHandBeliefs(*parent_game_, state.Hands()[observer],
+                    unseen_counts_.data(), beliefs);
+}
+
+}  // namespace hanabi_learning_env
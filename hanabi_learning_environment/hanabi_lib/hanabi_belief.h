@@ -0,0 +1,78 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Card beliefs: for every card in the observer's own hand, a probability
+// distribution over (color, rank). The probability of a card is proportional
+// to the number of copies the observer has not seen, if the card knowledge
+// allows it, and zero otherwise. Unseen copies are those in the deck and in
+// the observer's own hand: all copies minus those in the other hands, in the
+// discard pile and on the fireworks.
+
+#ifndef __HANABI_BELIEF_H__
+#define __HANABI_BELIEF_H__
+
+#include <cstdint>
+#include <vector>
+
+#include "hanabi_game.h"
+#include "hanabi_hand.h"
+#include "hanabi_state.h"
+
+namespace hanabi_learning_env {
+
+// Number of floats of the beliefs of a hand: HandSize() rows of
+// NumColors() * NumRanks() probabilities, card color * NumRanks() + rank.
+int BeliefLength(const HanabiGame& game);
+
+// Writes the number of unseen copies of every card, by card index
+// color * NumRanks() + rank, into counts.
+void UnseenCardCounts(const HanabiState& state, int observer,
+                      uint8_t* counts);
+
+// Writes the beliefs of the cards of hand, as known by its holder, into
+// BeliefLength(game) floats starting at beliefs. Rows of absent cards are
+// zero. Card knowledge is ignored in kMinimal games, where the observer
+// does not get to see it.
+void EncodeHandBeliefs(const HanabiGame& game, const HanabiHand& hand,
+                       const uint8_t* unseen_counts, float* beliefs);
+
+// Keeps the unseen card counts of one state, as seen by one observer, up to
+// date across moves, like IncrementalCanonicalEncoder does for the encoding:
+// the first Update counts from scratch, later ones only take out the cards
+// which became visible in the moves since. The state must only advance
+// between updates; call Invalidate when it is replaced by a different one.
+class HanabiBeliefTracker {
+ public:
+  explicit HanabiBeliefTracker(const HanabiGame* parent_game);
+
+  // Forget the cached counts, the next Update counts from scratch.
+  void Invalidate() { valid_ = false; }
+  // Bring the counts up to date with state observed by observer.
+  void Update(const HanabiState& state, int observer);
+  // Update, then write the beliefs of the observer's hand.
+  void Beliefs(const HanabiState& state, int observer, float* beliefs);
+  // Counts as of the last Update, by card index.
+  const std::vector<uint8_t>& UnseenCounts() const { return unseen_counts_; }
+
+ private:
+  const HanabiGame* parent_game_ = nullptr;
+  std::vector<uint8_t> unseen_counts_;
+  bool valid_ = false;
+  int observer_ = -1;
+  int num_moves_ = 0;  // State's NumMoves() as of the counts.
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
@@ -0,0 +1,526 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hanabi_compact_state.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+#include "hanabi_hand.h"
+#include "hanabi_history_item.h"
+
+namespace hanabi_learning_env {
+
+static_assert(std::is_trivially_copyable<HanabiCompactState>::value,
+              "HanabiCompactState must be copyable with memcpy");
+
+constexpr int HanabiCompactState::kMaxPlayers;
+constexpr int HanabiCompactState::kMaxHandSize;
+constexpr int HanabiCompactState::kMaxDeckSize;
+constexpr int HanabiCompactState::kMaxRecentMoves;
+constexpr int8_t HanabiCompactState::kNoCard;
+constexpr uint8_t HanabiCompactState::kScored;
+constexpr uint8_t HanabiCompactState::kInformationToken;
+
+namespace {
+
+// Checks that a game fits the fixed capacities of HanabiCompactState.
+void RequireCompactGame(const HanabiGame& game) {
+  REQUIRE(game.NumPlayers() <= HanabiCompactState::kMaxPlayers);
+  REQUIRE(game.HandSize() <= HanabiCompactState::kMaxHandSize);
+  REQUIRE(game.MaxDeckSize() <= HanabiCompactState::kMaxDeckSize);
+  REQUIRE(game.MaxInformationTokens() <= INT8_MAX);
+  REQUIRE(game.MaxLifeTokens() <= INT8_MAX);
+  REQUIRE(game.MaxMoves() + game.MaxChanceOutcomes() <= UINT8_MAX);
+}
+
+}  // namespace
+
+HanabiCompactState::HanabiCompactState(const HanabiGame* parent_game,
+                                       int start_player) {
+  RequireCompactGame(*parent_game);
+  // Zero everything, padding included, so equal states compare equal with
+  // memcmp.
+  std::memset(static_cast<void*>(this), 0, sizeof(*this));
+  parent_game_ = parent_game;
+  rng_ = CounterRng();
+  num_players_ = parent_game->NumPlayers();
+  hand_size_max_ = parent_game->HandSize();
+  cur_player_ = kChancePlayerId;
+  next_non_chance_player_ =
+      start_player >= 0 && start_player < parent_game->NumPlayers()
+          ? start_player
+          : parent_game->GetSampledStartPlayer();
+  information_tokens_ = parent_game->MaxInformationTokens();
+  life_tokens_ = parent_game->MaxLifeTokens();
+  turns_to_play_ = parent_game->NumPlayers();
+  deck_size_ = parent_game->MaxDeckSize();
+  for (int color = 0; color < parent_game->NumColors(); ++color) {
+    for (int rank = 0; rank < parent_game->NumRanks(); ++rank) {
+      deck_counts_[color * kMaxNumRanks + rank] =
+          parent_game->NumberCardInstances(color, rank);
+    }
+  }
+  std::fill(&cards_[0][0], &cards_[0][0] + kMaxPlayers * kMaxHandSize,
+            kNoCard);
+  std::fill(last_move_index_, last_move_index_ + kMaxPlayers, -1);
+  first_player_move_index_ = -1;
+}
+
+HanabiCompactState::HanabiCompactState(const HanabiState& state) {
+  const HanabiGame* game = state.ParentGame();
+  RequireCompactGame(*game);
+  std::memset(static_cast<void*>(this), 0, sizeof(*this));
+  parent_game_ = game;
+  rng_ = state.rng_;
+  num_players_ = game->NumPlayers();
+  hand_size_max_ = game->HandSize();
+  cur_player_ = state.cur_player_;
+  next_non_chance_player_ = state.next_non_chance_player_;
+  information_tokens_ = state.information_tokens_;
+  life_tokens_ = state.life_tokens_;
+  turns_to_play_ = state.turns_to_play_;
+  deck_size_ = state.Deck().Size();
+  has_random_stream_ = state.has_random_stream_;
+  for (int color = 0; color < game->NumColors(); ++color) {
+    fireworks_[color] = state.fireworks_[color];
+    for (int rank = 0; rank < game->NumRanks(); ++rank) {
+      deck_counts_[color * kMaxNumRanks + rank] =
+          state.Deck().CardCount(color, rank);
+    }
+  }
+  for (const HanabiCard& card : state.DiscardPile()) {
+    discard_pile_[discard_size_++] = CardByte(card);
+  }
+  std::fill(&cards_[0][0], &cards_[0][0] + kMaxPlayers * kMaxHandSize,
+            kNoCard);
+  for (int player = 0; player < num_players_; ++player) {
+    const HanabiHand& hand = state.Hands()[player];
+    hand_size_[player] = hand.Cards().size();
+    for (int card_index = 0; card_index < hand_size_[player]; ++card_index) {
+      const HanabiHand::CardKnowledge& knowledge =
+          hand.Knowledge()[card_index];
+      cards_[player][card_index] = CardByte(hand.Cards()[card_index]);
+      color_hinted_[player][card_index] = knowledge.Color();
+      rank_hinted_[player][card_index] = knowledge.Rank();
+      for (int color = 0; color < game->NumColors(); ++color) {
+        if (knowledge.ColorPlausible(color)) {
+          color_plausible_[player][card_index] |= 1 << color;
+        }
+      }
+      for (int rank = 0; rank < game->NumRanks(); ++rank) {
+        if (knowledge.RankPlausible(rank)) {
+          rank_plausible_[player][card_index] |= 1 << rank;
+        }
+      }
+    }
+  }
+
+  const std::vector<HanabiHistoryItem>& history = state.MoveHistory();
+  num_moves_ = state.NumMoves();
+  std::fill(last_move_index_, last_move_index_ + kMaxPlayers, -1);
+  for (int player = 0; player < num_players_; ++player) {
+    last_move_index_[player] = state.LastMoveIndex(player);
+  }
+  first_player_move_index_ = state.FirstPlayerMoveIndex();
+  num_recent_moves_ = std::min<int>(history.size(), kMaxRecentMoves);
+  for (int i = num_moves_ - num_recent_moves_; i < num_moves_; ++i) {
+    const HanabiHistoryItem& item = history[i - state.HistoryStart()];
+    HistoryItem* compact = &recent_moves_[i % kMaxRecentMoves];
+    compact->move = item.move.MoveType() == HanabiMove::kDeal
+                        ? game->MaxMoves() + game->GetChanceOutcomeUid(item.move)
+                        : game->GetMoveUid(item.move);
+    compact->player = item.player;
+    compact->color = item.color;
+    compact->rank = item.rank;
+    compact->flags = (item.scored ? kScored : 0) |
+                     (item.information_token ? kInformationToken : 0);
+    compact->reveal_bitmask = item.reveal_bitmask;
+    compact->newly_revealed_bitmask = item.newly_revealed_bitmask;
+    compact->deal_to_player = item.deal_to_player;
+  }
+}
+
+HanabiState HanabiCompactState::ToState() const {
+  const HanabiGame* game = parent_game_;
+  HanabiState state(game, next_non_chance_player_);
+  for (int color = 0; color < game->NumColors(); ++color) {
+    state.fireworks_[color] = fireworks_[color];
+    for (int rank = 0; rank < game->NumRanks(); ++rank) {
+      for (int dealt = CardCount(color, rank);
+           dealt < game->NumberCardInstances(color, rank); ++dealt) {
+        state.deck_.DealCard(color, rank);
+      }
+    }
+  }
+  for (int i = 0; i < discard_size_; ++i) {
+    state.discard_pile_.push_back(DiscardedCard(i));
+  }
+  for (int player = 0; player < num_players_; ++player) {
+    for (int card_index = 0; card_index < hand_size_[player]; ++card_index) {
+      HanabiHand::CardKnowledge knowledge(game->NumColors(), game->NumRanks());
+      if (color_hinted_[player][card_index] >= 0) {
+        knowledge.ApplyIsColorHint(color_hinted_[player][card_index]);
+      } else {
+        for (int color = 0; color < game->NumColors(); ++color) {
+          if (!((color_plausible_[player][card_index] >> color) & 1)) {
+            knowledge.ApplyIsNotColorHint(color);
+          }
+        }
+      }
+      if (rank_hinted_[player][card_index] >= 0) {
+        knowledge.ApplyIsRankHint(rank_hinted_[player][card_index]);
+      } else {
+        for (int rank = 0; rank < game->NumRanks(); ++rank) {
+          if (!((rank_plausible_[player][card_index] >> rank) & 1)) {
+            knowledge.ApplyIsNotRankHint(rank);
+          }
+        }
+      }
+      state.hands_[player].AddCard(Card(player, card_index), knowledge);
+    }
+  }
+  // The items are recorded in kFullHistory, so that all of them are kept
+  // and a conversion back gives the same compact state.
+  HanabiState::HistoryMode history_mode = HanabiState::kFullHistory;
+  int num_recorded_moves = num_recent_moves_;
+  if (num_recent_moves_ < num_moves_) {
+    if (num_recent_moves_ >= state.RecentHistoryLength()) {
+      history_mode = HanabiState::kRecentHistory;
+    } else {
+      history_mode = HanabiState::kNoHistory;
+      num_recorded_moves = 0;
+    }
+  }
+  state.num_moves_ = num_moves_ - num_recorded_moves;
+  for (int i = num_recorded_moves - 1; i >= 0; --i) {
+    const HistoryItem& compact = RecentMove(i);
+    HanabiHistoryItem item(
+        compact.move < game->MaxMoves()
+            ? game->GetMove(compact.move)
+            : game->GetChanceOutcome(compact.move - game->MaxMoves()));
+    item.player = compact.player;
+    item.scored = compact.flags & kScored;
+    item.information_token = compact.flags & kInformationToken;
+    item.color = compact.color;
+    item.rank = compact.rank;
+    item.reveal_bitmask = compact.reveal_bitmask;
+    item.newly_revealed_bitmask = compact.newly_revealed_bitmask;
+    item.deal_to_player = compact.deal_to_player;
+    state.RecordMove(item);
+  }
+  state.num_moves_ = num_moves_;
+  for (int player = 0; player < num_players_; ++player) {
+    state.last_move_index_[player] = last_move_index_[player];
+  }
+  state.first_player_move_index_ = first_player_move_index_;
+  state.history_mode_ = history_mode;
+  state.cur_player_ = cur_player_;
+  state.information_tokens_ = information_tokens_;
+  state.life_tokens_ = life_tokens_;
+  state.turns_to_play_ = turns_to_play_;
+  state.rng_ = rng_;
+  state.has_random_stream_ = has_random_stream_;
+  state.ComputeAggregates();
+  return state;
+}
+
+int HanabiCompactState::PlayerToDeal() const {
+  for (int player = 0; player < num_players_; ++player) {
+    if (hand_size_[player] < hand_size_max_) {
+      return player;
+    }
+  }
+  return -1;
+}
+
+void HanabiCompactState::AdvanceToNextPlayer() {
+  if (deck_size_ > 0 && PlayerToDeal() >= 0) {
+    cur_player_ = kChancePlayerId;
+  } else {
+    cur_player_ = next_non_chance_player_;
+    next_non_chance_player_ = (cur_player_ + 1) % num_players_;
+  }
+}
+
+void HanabiCompactState::AddCard(int player, int8_t card) {
+  const int card_index = hand_size_[player]++;
+  cards_[player][card_index] = card;
+  if (parent_game_->ObservationType() == HanabiGame::kSeer) {
+    color_plausible_[player][card_index] = 1 << (card / kMaxNumRanks);
+    rank_plausible_[player][card_index] = 1 << (card % kMaxNumRanks);
+    color_hinted_[player][card_index] = card / kMaxNumRanks;
+    rank_hinted_[player][card_index] = card % kMaxNumRanks;
+  } else {
+    color_plausible_[player][card_index] =
+        (1 << parent_game_->NumColors()) - 1;
+    rank_plausible_[player][card_index] = (1 << parent_game_->NumRanks()) - 1;
+    color_hinted_[player][card_index] = -1;
+    rank_hinted_[player][card_index] = -1;
+  }
+}
+
+void HanabiCompactState::RemoveCard(int player, int card_index) {
+  const int last = --hand_size_[player];
+  for (int i = card_index; i < last; ++i) {
+    cards_[player][i] = cards_[player][i + 1];
+    color_plausible_[player][i] = color_plausible_[player][i + 1];
+    rank_plausible_[player][i] = rank_plausible_[player][i + 1];
+    color_hinted_[player][i] = color_hinted_[player][i + 1];
+    rank_hinted_[player][i] = rank_hinted_[player][i + 1];
+  }
+  cards_[player][last] = kNoCard;
+  color_plausible_[player][last] = 0;
+  rank_plausible_[player][last] = 0;
+  color_hinted_[player][last] = 0;
+  rank_hinted_[player][last] = 0;
+}
+
+void HanabiCompactState::Reveal(int player, bool color, int value,
+                                HistoryItem* history) {
+  uint8_t(&plausible)[kMaxHandSize] =
+      color ? color_plausible_[player] : rank_plausible_[player];
+  int8_t(&hinted)[kMaxHandSize] =
+      color ? color_hinted_[player] : rank_hinted_[player];
+  for (int card_index = 0; card_index < hand_size_[player]; ++card_index) {
+    const int8_t card = cards_[player][card_index];
+    if ((color ? card / kMaxNumRanks : card % kMaxNumRanks) == value) {
+      history->reveal_bitmask |= 1 << card_index;
+      if (hinted[card_index] < 0) {
+        history->newly_revealed_bitmask |= 1 << card_index;
+      }
+      plausible[card_index] = 1 << value;
+      hinted[card_index] = value;
+    } else {
+      plausible[card_index] &= ~(1 << value);
+    }
+  }
+}
+
+bool HanabiCompactState::MoveIsLegal(HanabiMove move) const {
+  switch (move.MoveType()) {
+    case HanabiMove::kDeal:
+      return cur_player_ == kChancePlayerId &&
+             CardCount(move.Color(), move.Rank()) > 0;
+    case HanabiMove::kDiscard:
+      if (information_tokens_ >= parent_game_->MaxInformationTokens()) {
+        return false;
+      }
+      return cur_player_ != kChancePlayerId &&
+             move.CardIndex() < hand_size_[cur_player_];
+    case HanabiMove::kPlay:
+      return cur_player_ != kChancePlayerId &&
+             move.CardIndex() < hand_size_[cur_player_];
+    case HanabiMove::kRevealColor:
+    case HanabiMove::kRevealRank: {
+      if (information_tokens_ <= 0 || move.TargetOffset() < 1 ||
+          move.TargetOffset() >= num_players_) {
+        return false;
+      }
+      const int target = (cur_player_ + move.TargetOffset()) % num_players_;
+      for (int card_index = 0; card_index < hand_size_[target]; ++card_index) {
+        const int8_t card = cards_[target][card_index];
+        if (move.MoveType() == HanabiMove::kRevealColor
+                ? card / kMaxNumRanks == move.Color()
+                : card % kMaxNumRanks == move.Rank()) {
+          return true;
+        }
+      }
+      return false;
+    }
+    default:
+      return false;
+  }
+}
+
+void HanabiCompactState::ApplyMove(HanabiMove move) {
+  REQUIRE(MoveIsLegal(move));
+  if (deck_size_ == 0) {
+    --turns_to_play_;
+  }
+  const HanabiGame* game = parent_game_;
+  HistoryItem history;
+  std::memset(&history, 0, sizeof(history));
+  history.player = cur_player_;
+  history.color = -1;
+  history.rank = -1;
+  history.deal_to_player = -1;
+  switch (move.MoveType()) {
+    case HanabiMove::kDeal: {
+      history.move = game->MaxMoves() + game->GetChanceOutcomeUid(move);
+      history.deal_to_player = PlayerToDeal();
+      const int8_t card = move.Color() * kMaxNumRanks + move.Rank();
+      --deck_counts_[card];
+      --deck_size_;
+      AddCard(history.deal_to_player, card);
+      break;
+    }
+    case HanabiMove::kDiscard:
+    case HanabiMove::kPlay: {
+      history.move = game->GetMoveUid(move);
+      const int8_t card = cards_[cur_player_][move.CardIndex()];
+      history.color = card / kMaxNumRanks;
+      history.rank = card % kMaxNumRanks;
+      bool discarded = true;
+      if (move.MoveType() == HanabiMove::kDiscard) {
+        ++information_tokens_;
+        history.flags |= kInformationToken;
+      } else if (CardPlayableOnFireworks(history.color, history.rank)) {
+        discarded = false;
+        history.flags |= kScored;
+        if (++fireworks_[history.color] == game->NumRanks() &&
+            information_tokens_ < game->MaxInformationTokens()) {
+          ++information_tokens_;
+          history.flags |= kInformationToken;
+        }
+      } else {
+        --life_tokens_;
+      }
+      if (discarded) {
+        discard_pile_[discard_size_++] = card;
+      }
+      RemoveCard(cur_player_, move.CardIndex());
+      break;
+    }
+    case HanabiMove::kRevealColor:
+    case HanabiMove::kRevealRank:
+      history.move = game->GetMoveUid(move);
+      --information_tokens_;
+      Reveal((cur_player_ + move.TargetOffset()) % num_players_,
+             move.MoveType() == HanabiMove::kRevealColor,
+             move.MoveType() == HanabiMove::kRevealColor ? move.Color()
+                                                         : move.Rank(),
+             &history);
+      break;
+    default:
+      std::abort();  // Should not be possible.
+  }
+  if (history.player != kChancePlayerId) {
+    last_move_index_[history.player] = num_moves_;
+    if (first_player_move_index_ < 0) {
+      first_player_move_index_ = num_moves_;
+    }
+  }
+  recent_moves_[num_moves_++ % kMaxRecentMoves] = history;
+  if (num_recent_moves_ < kMaxRecentMoves) {
+    ++num_recent_moves_;
+  }
+  AdvanceToNextPlayer();
+}
+
+std::vector<HanabiMove> HanabiCompactState::LegalMoves(int player) const {
+  std::vector<HanabiMove> movelist;
+  REQUIRE(player >= 0 && player < num_players_);
+  for (uint64_t mask = LegalMovesMask(player); mask != 0; mask &= mask - 1) {
+    movelist.push_back(parent_game_->GetMove(LowestSetBit(mask)));
+  }
+  return movelist;
+}
+
+uint64_t HanabiCompactState::LegalMovesMask(int player) const {
+  REQUIRE(player >= 0 && player < num_players_);
+  REQUIRE(parent_game_->MaxMoves() <= 64);
+  if (player != cur_player_) {
+    return 0;
+  }
+  const int num_colors = parent_game_->NumColors();
+  const int num_ranks = parent_game_->NumRanks();
+  // Uid layout: discards, plays, color hints, rank hints (see HanabiGame).
+  const uint64_t cards_mask =
+      (static_cast<uint64_t>(1) << hand_size_[player]) - 1;
+  uint64_t mask = cards_mask << hand_size_max_;
+  if (information_tokens_ < parent_game_->MaxInformationTokens()) {
+    mask |= cards_mask;
+  }
+  if (information_tokens_ > 0) {
+    const int color_hints = 2 * hand_size_max_;
+    const int rank_hints = color_hints + (num_players_ - 1) * num_colors;
+    for (int offset = 1; offset < num_players_; ++offset) {
+      const int target = (player + offset) % num_players_;
+      uint64_t colors = 0;
+      uint64_t ranks = 0;
+      for (int card_index = 0; card_index < hand_size_[target]; ++card_index) {
+        colors |= static_cast<uint64_t>(1)
+                  << (cards_[target][card_index] / kMaxNumRanks);
+        ranks |= static_cast<uint64_t>(1)
+                 << (cards_[target][card_index] % kMaxNumRanks);
+      }
+      mask |= colors << (color_hints + (offset - 1) * num_colors);
+      mask |= ranks << (rank_hints + (offset - 1) * num_ranks);
+    }
+  }
+  return mask;
+}
+
+std::pair<std::vector<HanabiMove>, std::vector<double>>
+HanabiCompactState::ChanceOutcomes() const {
+  std::pair<std::vector<HanabiMove>, std::vector<double>> rv;
+  int max_outcome_uid = parent_game_->MaxChanceOutcomes();
+  for (int uid = 0; uid < max_outcome_uid; ++uid) {
+    HanabiMove move = parent_game_->GetChanceOutcome(uid);
+    if (MoveIsLegal(move)) {
+      rv.first.push_back(move);
+      rv.second.push_back(ChanceOutcomeProb(move));
+    }
+  }
+  return rv;
+}
+
+void HanabiCompactState::ApplyRandomChance() {
+  REQUIRE(cur_player_ == kChancePlayerId && deck_size_ > 0);
+  // The card at a uniformly drawn deck position, cards ordered by color,
+  // then rank, as in HanabiState::HanabiDeck::CardAt. A scan of the counts
+  // is as fast as a tree for 25 cards.
+  int position = has_random_stream_
+                     ? rng_.Below(deck_size_)
+                     : parent_game_->GetSampledInteger(deck_size_);
+  int color = 0;
+  int rank = 0;
+  while (position >= deck_counts_[color * kMaxNumRanks + rank]) {
+    position -= deck_counts_[color * kMaxNumRanks + rank];
+    if (++rank == parent_game_->NumRanks()) {
+      rank = 0;
+      ++color;
+    }
+  }
+  ApplyMove(parent_game_->GetChanceOutcome(
+      color * parent_game_->NumRanks() + rank));
+}
+
+int HanabiCompactState::Score() const {
+  if (life_tokens_ <= 0) {
+    return 0;
+  }
+  int score = 0;
+  for (int color = 0; color < parent_game_->NumColors(); ++color) {
+    score += fireworks_[color];
+  }
+  return score;
+}
+
+HanabiState::EndOfGameType HanabiCompactState::EndOfGameStatus() const {
+  if (life_tokens_ < 1) {
+    return HanabiState::kOutOfLifeTokens;
+  }
+  if (Score() >= parent_game_->NumColors() * parent_game_->NumRanks()) {
+    return HanabiState::kCompletedFireworks;
+  }
+  if (turns_to_play_ <= 0) {
+    return HanabiState::kOutOfCards;
+  }
+  return HanabiState::kNotFinished;
+}
+
+}  // namespace hanabi_learning_env
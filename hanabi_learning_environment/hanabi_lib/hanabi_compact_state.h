@@ -0,0 +1,188 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A fixed-capacity, trivially copyable game state for search: copying one is
+// a memcpy of a few hundred bytes, against the many heap allocations of a
+// HanabiState copy.
+
+#ifndef __HANABI_COMPACT_STATE_H__
+#define __HANABI_COMPACT_STATE_H__
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "counter_rng.h"
+#include "hanabi_card.h"
+#include "hanabi_game.h"
+#include "hanabi_move.h"
+#include "hanabi_state.h"
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+// Same game as HanabiState, with the same moves, chance nodes, legality
+// rules and random chance outcomes, but stored in inline arrays sized for the
+// largest supported game. Cards are single bytes color * kMaxNumRanks + rank,
+// and only the last kMaxRecentMoves history items are kept, which is enough
+// for HanabiObservation to see every move since the observer's last turn.
+//
+// Convertible to and from HanabiState; a round trip preserves everything but
+// the older history items.
+class HanabiCompactState {
+ public:
+  static constexpr int kMaxPlayers = 5;
+  static constexpr int kMaxHandSize = 8;
+  static constexpr int kMaxDeckSize = 2 * kMaxNumColors * kMaxNumRanks;
+  // A player move and the deal which follows it, for each player.
+  static constexpr int kMaxRecentMoves = 2 * kMaxPlayers;
+  static constexpr int8_t kNoCard = -1;
+
+  // HanabiHistoryItem in 8 bytes. move is the move uid for player moves and
+  // MaxMoves() + the chance outcome uid for deals.
+  struct HistoryItem {
+    uint8_t move;
+    int8_t player;
+    int8_t color;
+    int8_t rank;
+    uint8_t flags;  // kScored | kInformationToken.
+    uint8_t reveal_bitmask;
+    uint8_t newly_revealed_bitmask;
+    int8_t deal_to_player;
+  };
+  static constexpr uint8_t kScored = 1;
+  static constexpr uint8_t kInformationToken = 2;
+
+  // Uninitialized; assign before use.
+  HanabiCompactState() = default;
+  // The start of the game, like HanabiState(parent_game, start_player).
+  explicit HanabiCompactState(const HanabiGame* parent_game,
+                              int start_player = -1);
+  // Copy of state, keeping the last kMaxRecentMoves items of its history.
+  explicit HanabiCompactState(const HanabiState& state);
+
+  // Equivalent HanabiState, with the retained history items as its history.
+  // Its history mode is kFullHistory if every move of the game was retained,
+  // kRecentHistory if at least its RecentHistoryLength() moves were, and
+  // kNoHistory otherwise.
+  HanabiState ToState() const;
+
+  bool MoveIsLegal(HanabiMove move) const;
+  void ApplyMove(HanabiMove move);
+  // See HanabiState::LegalMoves and HanabiState::LegalMovesMask.
+  std::vector<HanabiMove> LegalMoves(int player) const;
+  uint64_t LegalMovesMask(int player) const;
+  bool CardPlayableOnFireworks(int color, int rank) const {
+    return color >= 0 && color < parent_game_->NumColors() &&
+           rank == fireworks_[color];
+  }
+  double ChanceOutcomeProb(HanabiMove move) const {
+    return static_cast<double>(CardCount(move.Color(), move.Rank())) /
+           static_cast<double>(deck_size_);
+  }
+  // Same draws as HanabiState::ApplyRandomChance with the same stream.
+  void ApplyRandomChance();
+  void SetRandomStream(const CounterRng& rng) {
+    rng_ = rng;
+    has_random_stream_ = true;
+  }
+  bool HasRandomStream() const { return has_random_stream_; }
+  std::pair<std::vector<HanabiMove>, std::vector<double>> ChanceOutcomes()
+      const;
+  HanabiState::EndOfGameType EndOfGameStatus() const;
+  bool IsTerminal() const {
+    return EndOfGameStatus() != HanabiState::kNotFinished;
+  }
+  int Score() const;
+
+  const HanabiGame* ParentGame() const { return parent_game_; }
+  int CurPlayer() const { return cur_player_; }
+  int LifeTokens() const { return life_tokens_; }
+  int InformationTokens() const { return information_tokens_; }
+  int Fireworks(int color) const { return fireworks_[color]; }
+  int DeckSize() const { return deck_size_; }
+  int CardCount(int color, int rank) const {
+    return deck_counts_[color * kMaxNumRanks + rank];
+  }
+  int HandSize(int player) const { return hand_size_[player]; }
+  HanabiCard Card(int player, int card_index) const {
+    const int8_t card = cards_[player][card_index];
+    return HanabiCard(card / kMaxNumRanks, card % kMaxNumRanks);
+  }
+  int DiscardPileSize() const { return discard_size_; }
+  HanabiCard DiscardedCard(int index) const {
+    return HanabiCard(discard_pile_[index] / kMaxNumRanks,
+                      discard_pile_[index] % kMaxNumRanks);
+  }
+  // Number of moves applied since the start of the game, deals included.
+  int NumMoves() const { return num_moves_; }
+  // Number of history items kept: the last min(NumMoves(), kMaxRecentMoves),
+  // or fewer if the state was converted from a HanabiState which did not keep
+  // its history.
+  int NumRecentMoves() const { return num_recent_moves_; }
+  // The i-th most recent history item, i < NumRecentMoves().
+  const HistoryItem& RecentMove(int i) const {
+    return recent_moves_[(num_moves_ - 1 - i) % kMaxRecentMoves];
+  }
+
+ private:
+  int PlayerToDeal() const;  // -1 if no player needs a card.
+  void AdvanceToNextPlayer();
+  void AddCard(int player, int8_t card);
+  void RemoveCard(int player, int card_index);
+  // Applies a RevealColor (color = true) or RevealRank move to a hand, and
+  // fills the bitmasks of history.
+  void Reveal(int player, bool color, int value, HistoryItem* history);
+  static int8_t CardByte(HanabiCard card) {
+    return card.Color() * kMaxNumRanks + card.Rank();
+  }
+
+  const HanabiGame* parent_game_;
+  CounterRng rng_;  // Random stream for chance outcomes, if has_random_stream_.
+  int32_t num_moves_;
+  // Kept outside the history, like HanabiState::LastMoveIndex and
+  // HanabiState::FirstPlayerMoveIndex.
+  int32_t last_move_index_[kMaxPlayers];
+  int32_t first_player_move_index_;
+  int8_t num_players_;
+  int8_t hand_size_max_;
+  int8_t cur_player_;
+  int8_t next_non_chance_player_;  // Next non-chance player to act.
+  int8_t information_tokens_;
+  int8_t life_tokens_;
+  int8_t turns_to_play_;  // Number of turns to play once deck is empty.
+  int8_t deck_size_;
+  int8_t discard_size_;
+  int8_t num_recent_moves_;
+  bool has_random_stream_;
+  int8_t fireworks_[kMaxNumColors];
+  uint8_t deck_counts_[kMaxNumColors * kMaxNumRanks];
+  // In order of discarding, like HanabiState::DiscardPile.
+  int8_t discard_pile_[kMaxDeckSize];
+  int8_t hand_size_[kMaxPlayers];
+  // Per card, ordered from oldest to newest like HanabiHand. Knowledge is
+  // HanabiHand::CardKnowledge: bit c of color_plausible_ set iff color c is
+  // plausible, color_hinted_ the hinted color or -1, and the same for ranks.
+  int8_t cards_[kMaxPlayers][kMaxHandSize];
+  uint8_t color_plausible_[kMaxPlayers][kMaxHandSize];
+  uint8_t rank_plausible_[kMaxPlayers][kMaxHandSize];
+  int8_t color_hinted_[kMaxPlayers][kMaxHandSize];
+  int8_t rank_hinted_[kMaxPlayers][kMaxHandSize];
+  // Ring buffer, item i of the game at recent_moves_[i % kMaxRecentMoves].
+  HistoryItem recent_moves_[kMaxRecentMoves];
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
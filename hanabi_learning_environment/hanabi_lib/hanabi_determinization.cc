@@ -0,0 +1,162 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hanabi_determinization.h"
+
+#include <algorithm>
+
+#include "hanabi_belief.h"
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+namespace {
+
+// Draws before SampleOwnHand gives up.
+constexpr int kMaxAttempts = 16;
+
+// Largest hand supported without allocating, more than any real game uses.
+constexpr int kMaxSampledHandSize = 16;
+
+// SampleDeterminization, with a caller-provided buffer for the hand.
+bool Determinize(const HanabiState& state, int observer, CounterRng* rng,
+                 std::vector<HanabiCard>* hand, HanabiState* world,
+                 double* weight) {
+  const bool sampled = SampleOwnHand(state, observer, rng, hand, weight);
+  *world = state;
+  world->ReplaceHandCards(observer, *hand);
+  world->SetRandomStream(CounterRng(rng->Next64()));
+  return sampled;
+}
+
+}  // namespace
+
+bool SampleOwnHand(const HanabiState& state, int observer, CounterRng* rng,
+                   std::vector<HanabiCard>* hand, double* weight) {
+  const HanabiGame& game = *state.ParentGame();
+  const int num_ranks = game.NumRanks();
+  const std::vector<HanabiHand::CardKnowledge>& knowledge =
+      state.Hands()[observer].Knowledge();
+  const int hand_size = knowledge.size();
+  REQUIRE(hand_size <= kMaxSampledHandSize);
+
+  uint8_t unseen[kMaxNumColors * kMaxNumRanks];
+  UnseenCardCounts(state, observer, unseen);
+  uint32_t unseen_mask = 0;
+  for (int card = 0; card < game.NumColors() * num_ranks; ++card) {
+    unseen_mask |= static_cast<uint32_t>(unseen[card] > 0) << card;
+  }
+
+  // Slots with the fewest candidate cards first, so that they are least
+  // likely to find their candidates taken. The order only depends on the
+  // state, which keeps the weights comparable.
+  uint32_t candidates[kMaxSampledHandSize];
+  int order[kMaxSampledHandSize];
+  for (int i = 0; i < hand_size; ++i) {
+    candidates[i] = knowledge[i].PlausibleMask() & unseen_mask;
+    int j = i;
+    for (; j > 0 && PopCount(candidates[order[j - 1]]) >
+                        PopCount(candidates[i]); --j) {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+  }
+
+  hand->resize(hand_size);
+  for (int attempt = 0; attempt < kMaxAttempts; ++attempt) {
+    uint8_t remaining[kMaxNumColors * kMaxNumRanks];
+    std::copy(unseen, unseen + game.NumColors() * num_ranks, remaining);
+    double product = 1;
+    bool complete = true;
+    for (int k = 0; k < hand_size; ++k) {
+      const int slot = order[k];
+      uint32_t total = 0;
+      for (uint32_t bits = candidates[slot]; bits != 0; bits &= bits - 1) {
+        total += remaining[LowestSetBit(bits)];
+      }
+      if (total == 0) {
+        complete = false;
+        break;
+      }
+      uint32_t draw = rng->Below(total);
+      int card = -1;
+      for (uint32_t bits = candidates[slot]; bits != 0; bits &= bits - 1) {
+        card = LowestSetBit(bits);
+        if (draw < remaining[card]) {
+          break;
+        }
+        draw -= remaining[card];
+      }
+      --remaining[card];
+      (*hand)[slot] = HanabiCard(card / num_ranks, card % num_ranks);
+      product *= total;
+    }
+    if (complete) {
+      if (weight != nullptr) {
+        *weight = product;
+      }
+      return true;
+    }
+  }
+  *hand = state.Hands()[observer].Cards();
+  if (weight != nullptr) {
+    *weight = 0;
+  }
+  return false;
+}
+
+bool SampleDeterminization(const HanabiState& state, int observer,
+                           CounterRng* rng, HanabiState* world,
+                           double* weight) {
+  std::vector<HanabiCard> hand;
+  return Determinize(state, observer, rng, &hand, world, weight);
+}
+
+void SampleDeterminizations(const std::vector<const HanabiState*>& states,
+                            const std::vector<int>& observers,
+                            int num_samples, uint64_t seed,
+                            std::vector<HanabiState>* worlds,
+                            std::vector<double>* weights) {
+  REQUIRE(states.size() == observers.size());
+  const int64_t num_worlds =
+      static_cast<int64_t>(states.size()) * num_samples;
+  if (worlds->size() != num_worlds) {
+    // HanabiState has no default constructor: start from copies.
+    worlds->clear();
+    worlds->reserve(num_worlds);
+    for (const HanabiState* state : states) {
+      worlds->insert(worlds->end(), num_samples, *state);
+    }
+  }
+  if (weights != nullptr) {
+    weights->resize(num_worlds);
+  }
+  #pragma omp parallel
+  {
+    std::vector<HanabiCard> hand;
+    #pragma omp for schedule(static)
+    for (int64_t world_idx = 0; world_idx < num_worlds; ++world_idx) {
+      const int64_t state_idx = world_idx / num_samples;
+      CounterRng rng(seed, state_idx, world_idx % num_samples);
+      double weight = 0;
+      Determinize(*states[state_idx], observers[state_idx], &rng, &hand,
+                  &(*worlds)[world_idx], &weight);
+      if (weights != nullptr) {
+        (*weights)[world_idx] = weight;
+      }
+    }
+  }
+}
+
+}  // namespace hanabi_learning_env
@@ -0,0 +1,72 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Determinization for search: complete game states consistent with what one
+// player knows, i.e. the actual state with that player's own hand replaced
+// by cards drawn from the cards the player has not seen.
+
+#ifndef __HANABI_DETERMINIZATION_H__
+#define __HANABI_DETERMINIZATION_H__
+
+#include <cstdint>
+#include <vector>
+
+#include "counter_rng.h"
+#include "hanabi_card.h"
+#include "hanabi_state.h"
+
+namespace hanabi_learning_env {
+
+// Draws the cards of the observer's hand, without rejection. The cards are
+// drawn one slot at a time, most constrained slot first, each from the
+// unseen copies (see UnseenCardCounts) still left which its card knowledge
+// allows. Card knowledge is used whatever the observation type, so that the
+// cards are consistent with the hints in the state.
+//
+// Drawing slot by slot is not the posterior distribution of hands, but the
+// two differ only by the product of the numbers of copies each slot drew
+// from, which is returned in weight: weighting samples by it gives the
+// posterior. Weights of samples for the same state and observer compare.
+//
+// Returns false if a slot had nothing left to draw from too many times in a
+// row, which takes hints constraining several slots to the last copies of
+// the same cards. hand then holds the actual cards and weight is 0.
+bool SampleOwnHand(const HanabiState& state, int observer, CounterRng* rng,
+                   std::vector<HanabiCard>* hand, double* weight);
+
+// Sets world to a copy of state with the observer's hand drawn by
+// SampleOwnHand, and with a new random stream from rng, so that the cards
+// dealt from the world's deck are drawn anew too. Assigning to a world which
+// already holds a state of the same game reuses its memory.
+//
+// The move history of the world is that of state, including the actual
+// cards dealt to the observer; search should not look at it.
+bool SampleDeterminization(const HanabiState& state, int observer,
+                           CounterRng* rng, HanabiState* world,
+                           double* weight = nullptr);
+
+// Draws num_samples worlds of every states[i] as seen by observers[i], in
+// parallel using all OpenMP threads. World k of states[i] is
+// (*worlds)[i * num_samples + k], drawn from random stream (seed, i, k), so
+// results do not depend on the number of threads. worlds is resized if it
+// does not have the right size; weights, if not null, receives the weights.
+void SampleDeterminizations(const std::vector<const HanabiState*>& states,
+                            const std::vector<int>& observers,
+                            int num_samples, uint64_t seed,
+                            std::vector<HanabiState>* worlds,
+                            std::vector<double>* weights = nullptr);
+
+}  // namespace hanabi_learning_env
+
+#endif
@@ -0,0 +1,491 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hanabi_fixed_engine.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "canonical_encoders.h"
+#include "hanabi_move.h"
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+template <class Config>
+FixedBatchEngine<Config>::FixedBatchEngine(const HanabiGame* game,
+                                           const int n_games,
+                                           const int first_stream)
+  : game_(game),
+    first_stream_(first_stream),
+    observation_len_(game->ObservationType() == HanabiGame::kMinimal
+                         ? Config::kKnowledgeOffset
+                         : Config::kObservationLength),
+    games_(n_games) {
+  // Reveal masks are bytes and legal moves fit a 64-bit mask.
+  static_assert(Config::kHandSize <= 8, "hands must fit a byte mask");
+  static_assert(Config::kMaxMoves <= 64, "moves must fit a 64-bit mask");
+  REQUIRE(n_games > 0);
+  REQUIRE(Config::Matches(*game_));
+  REQUIRE(game_->MaxMoves() == Config::kMaxMoves);
+  REQUIRE(observation_len_ ==
+          CanonicalObservationEncoder(game_).Shape().front());
+  Reset();
+}
+
+template <class Config>
+void FixedBatchEngine<Config>::Reset() {
+  const int n_games = games_.size();
+  #pragma omp parallel for schedule(static)
+  for (int game = 0; game < n_games; ++game) {
+    NewGame(game);
+  }
+}
+
+template <class Config>
+void FixedBatchEngine<Config>::NewGame(const int game_index) {
+  Game& game = games_[game_index];
+  game.rng = CounterRng(static_cast<uint64_t>(game_->Seed()),
+                        first_stream_ + game_index, game.episode_counter++);
+  game.episode_length = 0;
+  game.cur_player = game_->GetSampledStartPlayer(&game.rng);
+  game.information_tokens = Config::kMaxInformationTokens;
+  game.life_tokens = Config::kMaxLifeTokens;
+  game.turns_to_play = kNumPlayers;
+  game.deck_size = Config::kMaxDeckSize;
+  game.fireworks_total = 0;
+  game.last_player = -1;
+  std::fill_n(game.fireworks, kNumColors, 0);
+  for (int card = 0; card < kNumCards; ++card) {
+    game.deck_counts[card] = FixedCardInstances(kNumRanks, card % kNumRanks);
+  }
+  std::fill_n(game.discard_counts, kNumCards, 0);
+  std::fill_n(game.hand_size, kNumPlayers, 0);
+  std::fill_n(&game.cards[0][0], kNumPlayers * kHandSize, -1);
+  std::fill_n(&game.color_hinted[0][0], kNumPlayers * kHandSize, -1);
+  std::fill_n(&game.rank_hinted[0][0], kNumPlayers * kHandSize, -1);
+  for (int player = 0; player < kNumPlayers; ++player) {
+    for (int card = 0; card < kHandSize; ++card) {
+      DealCard(&game, player);
+    }
+  }
+}
+
+template <class Config>
+void FixedBatchEngine<Config>::DealCard(Game* game, const int player) const {
+  uint32_t pick = game->rng.Below(game->deck_size);
+  int card = 0;
+  while (pick >= game->deck_counts[card]) {
+    pick -= game->deck_counts[card];
+    ++card;
+  }
+  --game->deck_counts[card];
+  --game->deck_size;
+
+  const int slot = game->hand_size[player]++;
+  game->cards[player][slot] = card;
+  if (game_->ObservationType() == HanabiGame::kSeer) {
+    game->color_plausible[player][slot] = 1 << (card / kNumRanks);
+    game->rank_plausible[player][slot] = 1 << (card % kNumRanks);
+    game->color_hinted[player][slot] = card / kNumRanks;
+    game->rank_hinted[player][slot] = card % kNumRanks;
+  } else {
+    game->color_plausible[player][slot] = (1 << kNumColors) - 1;
+    game->rank_plausible[player][slot] = (1 << kNumRanks) - 1;
+    game->color_hinted[player][slot] = -1;
+    game->rank_hinted[player][slot] = -1;
+  }
+}
+
+template <class Config>
+uint64_t FixedBatchEngine<Config>::LegalMovesMask(const Game& game) const {
+  const int player = game.cur_player;
+  const uint64_t cards_mask =
+      (static_cast<uint64_t>(1) << game.hand_size[player]) - 1;
+  uint64_t mask = cards_mask << kHandSize;
+  if (game.information_tokens < Config::kMaxInformationTokens) {
+    mask |= cards_mask;
+  }
+  if (game.information_tokens > 0) {
+    constexpr int kColorHints = 2 * kHandSize;
+    constexpr int kRankHints = kColorHints + (kNumPlayers - 1) * kNumColors;
+    for (int offset = 1; offset < kNumPlayers; ++offset) {
+      const int target = (player + offset) % kNumPlayers;
+      uint64_t colors = 0;
+      uint64_t ranks = 0;
+      for (int card_index = 0; card_index < game.hand_size[target];
+           ++card_index) {
+        const int card = game.cards[target][card_index];
+        colors |= static_cast<uint64_t>(1) << (card / kNumRanks);
+        ranks |= static_cast<uint64_t>(1) << (card % kNumRanks);
+      }
+      mask |= colors << (kColorHints + (offset - 1) * kNumColors);
+      mask |= ranks << (kRankHints + (offset - 1) * kNumRanks);
+    }
+  }
+  return mask;
+}
+
+template <class Config>
+void FixedBatchEngine<Config>::LegalMovesMasks(uint64_t* masks) const {
+  const int n_games = games_.size();
+  #pragma omp parallel for schedule(static)
+  for (int game = 0; game < n_games; ++game) {
+    masks[game] = LegalMovesMask(games_[game]);
+  }
+}
+
+template <class Config>
+void FixedBatchEngine<Config>::ApplyMove(Game* game,
+                                         const int move_uid) const {
+  REQUIRE(move_uid >= 0 && move_uid < Config::kMaxMoves);
+  REQUIRE((LegalMovesMask(*game) >> move_uid) & 1);
+  const int player = game->cur_player;
+  if (game->deck_size == 0) {
+    --game->turns_to_play;
+  }
+  game->last_player = player;
+  game->last_card = -1;
+  game->last_reveal_mask = 0;
+  game->last_scored = 0;
+  game->last_information_token = 0;
+
+  // Uid layout of HanabiGame::ConstructMove.
+  if (move_uid < 2 * kHandSize) {
+    const bool discard = move_uid < kHandSize;
+    const int card_index = discard ? move_uid : move_uid - kHandSize;
+    const int card = game->cards[player][card_index];
+    game->last_type = discard ? HanabiMove::kDiscard : HanabiMove::kPlay;
+    game->last_card_index = card_index;
+    game->last_target = -1;
+    game->last_value = -1;
+    game->last_card = card;
+    int8_t& fireworks = game->fireworks[card / kNumRanks];
+    bool to_discards = true;
+    if (discard) {
+      ++game->information_tokens;
+      game->last_information_token = 1;
+    } else if (fireworks == card % kNumRanks) {
+      to_discards = false;
+      game->last_scored = 1;
+      ++game->fireworks_total;
+      if (++fireworks == kNumRanks &&
+          game->information_tokens < Config::kMaxInformationTokens) {
+        ++game->information_tokens;
+        game->last_information_token = 1;
+      }
+    } else {
+      --game->life_tokens;
+    }
+    if (to_discards) {
+      ++game->discard_counts[card];
+    }
+    // Close the gap, keeping the cards ordered from oldest to newest.
+    const int hand_size = game->hand_size[player]--;
+    for (int slot = card_index; slot < hand_size - 1; ++slot) {
+      game->cards[player][slot] = game->cards[player][slot + 1];
+      game->color_plausible[player][slot] =
+          game->color_plausible[player][slot + 1];
+      game->rank_plausible[player][slot] =
+          game->rank_plausible[player][slot + 1];
+      game->color_hinted[player][slot] = game->color_hinted[player][slot + 1];
+      game->rank_hinted[player][slot] = game->rank_hinted[player][slot + 1];
+    }
+    game->cards[player][hand_size - 1] = -1;
+    if (game->deck_size > 0) {
+      DealCard(game, player);
+    }
+  } else {
+    constexpr int kColorHints = (kNumPlayers - 1) * kNumColors;
+    const int hint = move_uid - 2 * kHandSize;
+    const bool color = hint < kColorHints;
+    int target_offset;
+    int value;
+    if (color) {
+      target_offset = 1 + hint / kNumColors;
+      value = hint % kNumColors;
+    } else {
+      target_offset = 1 + (hint - kColorHints) / kNumRanks;
+      value = (hint - kColorHints) % kNumRanks;
+    }
+    game->last_type =
+        color ? HanabiMove::kRevealColor : HanabiMove::kRevealRank;
+    game->last_card_index = -1;
+    game->last_target = target_offset;
+    game->last_value = value;
+    --game->information_tokens;
+    const int target = (player + target_offset) % kNumPlayers;
+    uint8_t* plausible =
+        color ? game->color_plausible[target] : game->rank_plausible[target];
+    int8_t* hinted =
+        color ? game->color_hinted[target] : game->rank_hinted[target];
+    uint8_t reveal_mask = 0;
+    for (int card_index = 0; card_index < game->hand_size[target];
+         ++card_index) {
+      const int card = game->cards[target][card_index];
+      if ((color ? card / kNumRanks : card % kNumRanks) == value) {
+        reveal_mask |= 1 << card_index;
+        plausible[card_index] = 1 << value;
+        hinted[card_index] = value;
+      } else {
+        plausible[card_index] &= ~(1 << value);
+      }
+    }
+    game->last_reveal_mask = reveal_mask;
+  }
+  ++game->episode_length;
+  game->cur_player = (player + 1) % kNumPlayers;
+}
+
+template <class Config>
+void FixedBatchEngine<Config>::StepGame(
+    const int game_index, const int move_uid, int8_t* done,
+    const HanabiParallelEnv::HanabiStepResultBuffers& results) {
+  Game& game = games_[game_index];
+  const int score_before = Score(game);
+  ApplyMove(&game, move_uid);
+  results.rewards[game_index] = Score(game) - score_before;
+  done[game_index] = game.life_tokens < 1 ||
+                     game.fireworks_total >= kNumCards ||
+                     game.turns_to_play <= 0;
+  if (done[game_index]) {
+    results.final_scores[game_index] = Score(game);
+    results.episode_lengths[game_index] = game.episode_length;
+    NewGame(game_index);
+  } else {
+    results.final_scores[game_index] = 0;
+    results.episode_lengths[game_index] = 0;
+  }
+}
+
+template <class Config>
+void FixedBatchEngine<Config>::ObserveGame(
+    const int game_index,
+    const HanabiParallelEnv::HanabiBatchObservationBuffers& buffers) const {
+  const Game& game = games_[game_index];
+  int8_t* const encoding =
+      buffers.observation + static_cast<int64_t>(game_index) * observation_len_;
+  const bool encode_knowledge = observation_len_ > Config::kKnowledgeOffset;
+  if (encode_knowledge) {
+    std::fill_n(encoding, Config::kObservationLength, 0);
+  } else {
+    std::fill_n(encoding, Config::kKnowledgeOffset, 0);
+  }
+  const int observer = game.cur_player;
+
+  // Hands of the other players and missing cards.
+  for (int offset = 0; offset < kNumPlayers; ++offset) {
+    const int player = (observer + offset) % kNumPlayers;
+    if (offset > 0) {
+      int8_t* hand = encoding + Config::kHandsOffset +
+                     (offset - 1) * kHandSize * kNumCards;
+      for (int card_index = 0; card_index < game.hand_size[player];
+           ++card_index) {
+        hand[card_index * kNumCards + game.cards[player][card_index]] = 1;
+      }
+    }
+    encoding[Config::kMissingCardsOffset + offset] =
+        game.hand_size[player] < kHandSize;
+  }
+
+  // Board: deck size, fireworks, information and life tokens.
+  std::fill_n(encoding + Config::kBoardOffset, game.deck_size, 1);
+  for (int color = 0; color < kNumColors; ++color) {
+    if (game.fireworks[color] > 0) {
+      encoding[Config::kFireworksOffset + color * kNumRanks +
+               game.fireworks[color] - 1] = 1;
+    }
+  }
+  std::fill_n(encoding + Config::kInformationOffset, game.information_tokens,
+              1);
+  std::fill_n(encoding + Config::kLifeOffset, game.life_tokens, 1);
+
+  // Discards.
+  for (int card = 0; card < kNumCards; ++card) {
+    std::fill_n(encoding + Config::DiscardOffset(card),
+                game.discard_counts[card], 1);
+  }
+
+  // Last action, see EncodeLastActionItem.
+  if (game.last_player >= 0) {
+    const int player =
+        (game.last_player - observer + kNumPlayers) % kNumPlayers;
+    encoding[Config::kLastActionOffset + player] = 1;
+    switch (game.last_type) {
+      case HanabiMove::kPlay:
+        encoding[Config::kLastTypeOffset] = 1;
+        encoding[Config::kLastPlayOffset] = game.last_scored;
+        encoding[Config::kLastPlayOffset + 1] = game.last_information_token;
+        encoding[Config::kLastPositionOffset + game.last_card_index] = 1;
+        encoding[Config::kLastCardOffset + game.last_card] = 1;
+        break;
+      case HanabiMove::kDiscard:
+        encoding[Config::kLastTypeOffset + 1] = 1;
+        encoding[Config::kLastPositionOffset + game.last_card_index] = 1;
+        encoding[Config::kLastCardOffset + game.last_card] = 1;
+        break;
+      case HanabiMove::kRevealColor:
+      case HanabiMove::kRevealRank: {
+        const bool color = game.last_type == HanabiMove::kRevealColor;
+        encoding[Config::kLastTypeOffset + (color ? 2 : 3)] = 1;
+        encoding[Config::kLastTargetOffset +
+                 (player + game.last_target) % kNumPlayers] = 1;
+        if (color) {
+          encoding[Config::kLastColorOffset + game.last_value] = 1;
+        } else {
+          encoding[Config::kLastRankOffset + game.last_value] = 1;
+        }
+        for (int card_index = 0; card_index < kHandSize; ++card_index) {
+          encoding[Config::kLastOutcomeOffset + card_index] =
+              (game.last_reveal_mask >> card_index) & 1;
+        }
+        break;
+      }
+    }
+  }
+
+  // Card knowledge of all players, including the observer.
+  if (encode_knowledge) {
+    for (int offset = 0; offset < kNumPlayers; ++offset) {
+      const int player = (observer + offset) % kNumPlayers;
+      int8_t* knowledge = encoding + Config::kKnowledgeOffset +
+                          offset * kHandSize * Config::kKnowledgeCardLength;
+      for (int card_index = 0; card_index < game.hand_size[player];
+           ++card_index, knowledge += Config::kKnowledgeCardLength) {
+        // The plausible ranks are the same row for every plausible color.
+        const int ranks = game.rank_plausible[player][card_index];
+        int8_t plausible_ranks[kNumRanks];
+        for (int rank = 0; rank < kNumRanks; ++rank) {
+          plausible_ranks[rank] = (ranks >> rank) & 1;
+        }
+        for (int colors = game.color_plausible[player][card_index];
+             colors != 0; colors &= colors - 1) {
+          std::memcpy(knowledge + LowestSetBit(colors) * kNumRanks,
+                      plausible_ranks, sizeof(plausible_ranks));
+        }
+        if (game.color_hinted[player][card_index] >= 0) {
+          knowledge[kNumCards + game.color_hinted[player][card_index]] = 1;
+        }
+        if (game.rank_hinted[player][card_index] >= 0) {
+          knowledge[kNumCards + kNumColors +
+                    game.rank_hinted[player][card_index]] = 1;
+        }
+      }
+    }
+  }
+
+  // Legal moves and score.
+  const uint64_t mask = LegalMovesMask(game);
+  int8_t* legal_moves = buffers.legal_moves + game_index * Config::kMaxMoves;
+  for (int uid = 0; uid < Config::kMaxMoves; ++uid) {
+    legal_moves[uid] = (mask >> uid) & 1;
+  }
+  buffers.scores[game_index] = Score(game);
+}
+
+template <class Config>
+void FixedBatchEngine<Config>::Step(
+    const int* move_uids, int8_t* done,
+    const HanabiParallelEnv::HanabiStepResultBuffers& results) {
+  REQUIRE(move_uids != nullptr);
+  REQUIRE(done != nullptr);
+  REQUIRE(results.rewards != nullptr);
+  REQUIRE(results.final_scores != nullptr);
+  REQUIRE(results.episode_lengths != nullptr);
+  const int n_games = games_.size();
+  #pragma omp parallel for schedule(static)
+  for (int game = 0; game < n_games; ++game) {
+    StepGame(game, move_uids[game], done, results);
+  }
+}
+
+template <class Config>
+void FixedBatchEngine<Config>::Observe(
+    const HanabiParallelEnv::HanabiBatchObservationBuffers& buffers) const {
+  REQUIRE(buffers.observation != nullptr);
+  REQUIRE(buffers.legal_moves != nullptr);
+  REQUIRE(buffers.scores != nullptr);
+  REQUIRE(buffers.done != nullptr);
+  const int n_games = games_.size();
+  #pragma omp parallel for schedule(static)
+  for (int game = 0; game < n_games; ++game) {
+    ObserveGame(game, buffers);
+    buffers.done[game] = 0;
+  }
+}
+
+template <class Config>
+void FixedBatchEngine<Config>::StepAndObserve(
+    const int* move_uids,
+    const HanabiParallelEnv::HanabiBatchObservationBuffers& buffers,
+    const HanabiParallelEnv::HanabiStepResultBuffers& results) {
+  REQUIRE(move_uids != nullptr);
+  REQUIRE(buffers.observation != nullptr);
+  REQUIRE(buffers.legal_moves != nullptr);
+  REQUIRE(buffers.scores != nullptr);
+  REQUIRE(buffers.done != nullptr);
+  REQUIRE(results.rewards != nullptr);
+  REQUIRE(results.final_scores != nullptr);
+  REQUIRE(results.episode_lengths != nullptr);
+  const int n_games = games_.size();
+  #pragma omp parallel for schedule(static)
+  for (int game = 0; game < n_games; ++game) {
+    StepGame(game, move_uids[game], buffers.done, results);
+    ObserveGame(game, buffers);
+  }
+}
+
+// Standard configurations: 5 colors and ranks, 8 information and 3 life
+// tokens, and hands of 5 cards for 2 and 3 players, 4 cards otherwise.
+template class FixedBatchEngine<FixedGameConfig<2, 5, 5, 5>>;
+template class FixedBatchEngine<FixedGameConfig<3, 5, 5, 5>>;
+template class FixedBatchEngine<FixedGameConfig<4, 5, 5, 4>>;
+template class FixedBatchEngine<FixedGameConfig<5, 5, 5, 4>>;
+
+namespace {
+
+template <class Config>
+std::unique_ptr<FixedBatchEngineBase> NewFixedBatchEngineIfMatches(
+    const HanabiGame* game, const int n_games, const int first_stream) {
+  if (!Config::Matches(*game)) {
+    return nullptr;
+  }
+  return std::unique_ptr<FixedBatchEngineBase>(
+      new FixedBatchEngine<Config>(game, n_games, first_stream));
+}
+
+}  // namespace
+
+std::unique_ptr<FixedBatchEngineBase> NewFixedBatchEngine(
+    const HanabiGame* game, const int n_games, const int first_stream) {
+  switch (game->NumPlayers()) {
+    case 2:
+      return NewFixedBatchEngineIfMatches<FixedGameConfig<2, 5, 5, 5>>(
+          game, n_games, first_stream);
+    case 3:
+      return NewFixedBatchEngineIfMatches<FixedGameConfig<3, 5, 5, 5>>(
+          game, n_games, first_stream);
+    case 4:
+      return NewFixedBatchEngineIfMatches<FixedGameConfig<4, 5, 5, 4>>(
+          game, n_games, first_stream);
+    case 5:
+      return NewFixedBatchEngineIfMatches<FixedGameConfig<5, 5, 5, 4>>(
+          game, n_games, first_stream);
+    default:
+      return nullptr;
+  }
+}
+
+}  // namespace hanabi_learning_env
@@ -0,0 +1,278 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __HANABI_FIXED_ENGINE_H__
+#define __HANABI_FIXED_ENGINE_H__
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "counter_rng.h"
+#include "hanabi_game.h"
+#include "hanabi_parallel_env.h"
+
+namespace hanabi_learning_env {
+
+/** \brief Copies of each card of rank in games with num_ranks ranks, see
+ *  HanabiGame::NumberCardInstances.
+ */
+constexpr int FixedCardInstances(int num_ranks, int rank) {
+  return rank == 0 ? 3 : rank == num_ranks - 1 ? 1 : 2;
+}
+
+/** \brief Copies of the cards of a color of rank lower than rank.
+ */
+constexpr int FixedLowerRankInstances(int num_ranks, int rank) {
+  return rank == 0 ? 0
+                   : FixedCardInstances(num_ranks, rank - 1) +
+                         FixedLowerRankInstances(num_ranks, rank - 1);
+}
+
+/** \brief Game configuration known at compile time, with the section layout
+ *  of CanonicalObservationEncoder for it.
+ *
+ *  Cards are indices color * kNumRanks + rank.
+ */
+template <int kNumPlayers_, int kNumColors_, int kNumRanks_, int kHandSize_,
+          int kMaxInformationTokens_ = 8, int kMaxLifeTokens_ = 3>
+struct FixedGameConfig {
+  static constexpr int kNumPlayers = kNumPlayers_;
+  static constexpr int kNumColors = kNumColors_;
+  static constexpr int kNumRanks = kNumRanks_;
+  static constexpr int kHandSize = kHandSize_;
+  static constexpr int kMaxInformationTokens = kMaxInformationTokens_;
+  static constexpr int kMaxLifeTokens = kMaxLifeTokens_;
+
+  static constexpr int kNumCards = kNumColors * kNumRanks;
+  static constexpr int kCardsPerColor =
+      FixedLowerRankInstances(kNumRanks, kNumRanks);
+  static constexpr int kMaxDeckSize = kNumColors * kCardsPerColor;
+  static constexpr int kMaxMoves =
+      2 * kHandSize + (kNumPlayers - 1) * (kNumColors + kNumRanks);
+
+  /** \name Section offsets of the canonical observation.
+   *  @{
+   */
+  static constexpr int kHandsOffset = 0;
+  static constexpr int kMissingCardsOffset =
+      kHandsOffset + (kNumPlayers - 1) * kHandSize * kNumCards;
+  static constexpr int kBoardOffset = kMissingCardsOffset + kNumPlayers;
+  static constexpr int kFireworksOffset =
+      kBoardOffset + kMaxDeckSize - kNumPlayers * kHandSize;
+  static constexpr int kInformationOffset = kFireworksOffset + kNumCards;
+  static constexpr int kLifeOffset = kInformationOffset + kMaxInformationTokens;
+  static constexpr int kDiscardsOffset = kLifeOffset + kMaxLifeTokens;
+  static constexpr int DiscardOffset(int card) {
+    return kDiscardsOffset + card / kNumRanks * kCardsPerColor +
+           FixedLowerRankInstances(kNumRanks, card % kNumRanks);
+  }
+  static constexpr int kLastActionOffset = kDiscardsOffset + kMaxDeckSize;
+  static constexpr int kLastTypeOffset = kLastActionOffset + kNumPlayers;
+  static constexpr int kLastTargetOffset = kLastTypeOffset + 4;
+  static constexpr int kLastColorOffset = kLastTargetOffset + kNumPlayers;
+  static constexpr int kLastRankOffset = kLastColorOffset + kNumColors;
+  static constexpr int kLastOutcomeOffset = kLastRankOffset + kNumRanks;
+  static constexpr int kLastPositionOffset = kLastOutcomeOffset + kHandSize;
+  static constexpr int kLastCardOffset = kLastPositionOffset + kHandSize;
+  static constexpr int kLastPlayOffset = kLastCardOffset + kNumCards;
+  static constexpr int kKnowledgeOffset = kLastPlayOffset + 2;
+  static constexpr int kKnowledgeCardLength =
+      kNumCards + kNumColors + kNumRanks;
+  static constexpr int kObservationLength =
+      kKnowledgeOffset + kNumPlayers * kHandSize * kKnowledgeCardLength;
+  /** @} */
+
+  /** \brief Whether game has this configuration.
+   */
+  static bool Matches(const HanabiGame& game) {
+    return game.NumPlayers() == kNumPlayers &&
+           game.NumColors() == kNumColors && game.NumRanks() == kNumRanks &&
+           game.HandSize() == kHandSize &&
+           game.MaxInformationTokens() == kMaxInformationTokens &&
+           game.MaxLifeTokens() == kMaxLifeTokens;
+  }
+};
+
+/** \brief Interface of the specializations of FixedBatchEngine, for runtime
+ *  dispatch. See HanabiBatchEngine for the meaning of the methods.
+ */
+class FixedBatchEngineBase {
+ public:
+  virtual ~FixedBatchEngineBase() = default;
+
+  virtual int ObservationLength() const = 0;
+  virtual void Reset() = 0;
+  virtual void Step(
+      const int* move_uids, int8_t* done,
+      const HanabiParallelEnv::HanabiStepResultBuffers& results) = 0;
+  virtual void Observe(
+      const HanabiParallelEnv::HanabiBatchObservationBuffers& buffers)
+      const = 0;
+  virtual void StepAndObserve(
+      const int* move_uids,
+      const HanabiParallelEnv::HanabiBatchObservationBuffers& buffers,
+      const HanabiParallelEnv::HanabiStepResultBuffers& results) = 0;
+  virtual void LegalMovesMasks(uint64_t* masks) const = 0;
+
+  virtual int CurPlayer(const int game) const = 0;
+  virtual int InformationTokens(const int game) const = 0;
+  virtual int LifeTokens(const int game) const = 0;
+  virtual int DeckSize(const int game) const = 0;
+  virtual int Score(const int game) const = 0;
+  virtual int Fireworks(const int game, const int color) const = 0;
+  virtual int HandSize(const int game, const int player) const = 0;
+  virtual int Card(const int game, const int player, const int slot) const = 0;
+};
+
+/** \brief HanabiBatchEngine for one configuration known at compile time.
+ *
+ *  Plays and encodes exactly like HanabiBatchEngine, draws included, but
+ *  every size, loop bound and section offset is a constant, so hands,
+ *  knowledge and counts are fixed-size arrays and the encoding loops can be
+ *  unrolled and vectorized. A game's fields are stored together in one
+ *  fixed-size block, and each game is encoded right after it is stepped.
+ *
+ *  The members are defined in hanabi_fixed_engine.cc, which instantiates
+ *  the standard configurations, see NewFixedBatchEngine.
+ */
+template <class Config>
+class FixedBatchEngine final : public FixedBatchEngineBase {
+ public:
+  /** \brief Construct an engine and deal all games.
+   *
+   *  \param game Game of configuration Config; must outlive the engine.
+   *  \param n_games Number of games.
+   *  \param first_stream Random stream of the first game, see
+   *         HanabiBatchEngine::HanabiBatchEngine.
+   */
+  FixedBatchEngine(const HanabiGame* game, const int n_games,
+                   const int first_stream);
+
+  int ObservationLength() const override { return observation_len_; }
+  void Reset() override;
+  void Step(const int* move_uids, int8_t* done,
+            const HanabiParallelEnv::HanabiStepResultBuffers& results) override;
+  void Observe(const HanabiParallelEnv::HanabiBatchObservationBuffers& buffers)
+      const override;
+  void StepAndObserve(
+      const int* move_uids,
+      const HanabiParallelEnv::HanabiBatchObservationBuffers& buffers,
+      const HanabiParallelEnv::HanabiStepResultBuffers& results) override;
+  void LegalMovesMasks(uint64_t* masks) const override;
+
+  int CurPlayer(const int game) const override {
+    return games_[game].cur_player;
+  }
+  int InformationTokens(const int game) const override {
+    return games_[game].information_tokens;
+  }
+  int LifeTokens(const int game) const override {
+    return games_[game].life_tokens;
+  }
+  int DeckSize(const int game) const override {
+    return games_[game].deck_size;
+  }
+  int Score(const int game) const override { return Score(games_[game]); }
+  int Fireworks(const int game, const int color) const override {
+    return games_[game].fireworks[color];
+  }
+  int HandSize(const int game, const int player) const override {
+    return games_[game].hand_size[player];
+  }
+  int Card(const int game, const int player, const int slot) const override {
+    return games_[game].cards[player][slot];
+  }
+
+ private:
+  static constexpr int kNumPlayers = Config::kNumPlayers;
+  static constexpr int kNumColors = Config::kNumColors;
+  static constexpr int kNumRanks = Config::kNumRanks;
+  static constexpr int kNumCards = Config::kNumCards;
+  static constexpr int kHandSize = Config::kHandSize;
+
+  /** \brief State of one game. Same fields as in HanabiBatchEngine.
+   */
+  struct Game {
+    CounterRng rng;                 //< Random stream of the current episode.
+    uint64_t episode_counter = 0;   //< Episodes started.
+    int episode_length = 0;         //< Moves made in the current episode.
+    int8_t cur_player;              //< Player to move.
+    int8_t information_tokens;      //< Information tokens.
+    int8_t life_tokens;             //< Life tokens.
+    int8_t turns_to_play;           //< Moves left once the deck is empty.
+    int8_t deck_size;               //< Cards left in the deck.
+    int8_t fireworks_total;         //< Sum of the fireworks.
+
+    // Last move. last_player is -1 if there was none.
+    int8_t last_player;             //< Player who made it.
+    int8_t last_type;               //< HanabiMove::Type.
+    int8_t last_card_index;         //< Position played or discarded.
+    int8_t last_target;             //< Target offset of a hint.
+    int8_t last_value;              //< Color or rank of a hint.
+    int8_t last_card;               //< Card played or discarded.
+    uint8_t last_reveal_mask;       //< Cards a hint touched.
+    uint8_t last_scored;            //< Play added to the fireworks.
+    uint8_t last_information_token; //< Move gained a token.
+
+    int8_t fireworks[kNumColors];         //< Cards played per color.
+    uint8_t deck_counts[kNumCards];       //< Copies of each card left in the deck.
+    uint8_t discard_counts[kNumCards];    //< Copies of each card discarded.
+    int8_t hand_size[kNumPlayers];        //< Cards in each hand.
+
+    // Per card slot, ordered from oldest to newest card like HanabiHand.
+    int8_t cards[kNumPlayers][kHandSize];            //< Card, -1 if empty.
+    uint8_t color_plausible[kNumPlayers][kHandSize]; //< Bit c set iff color c is plausible.
+    uint8_t rank_plausible[kNumPlayers][kHandSize];  //< Bit r set iff rank r is plausible.
+    int8_t color_hinted[kNumPlayers][kHandSize];     //< Hinted color, -1 if none.
+    int8_t rank_hinted[kNumPlayers][kHandSize];      //< Hinted rank, -1 if none.
+  };
+
+  static int Score(const Game& game) {
+    return game.life_tokens > 0 ? game.fireworks_total : 0;
+  }
+  void NewGame(const int game_index);
+  void DealCard(Game* game, const int player) const;
+  uint64_t LegalMovesMask(const Game& game) const;
+  void ApplyMove(Game* game, const int move_uid) const;
+  /** \brief Step a game, replacing it by a new one if it ends.
+   */
+  void StepGame(const int game_index, const int move_uid, int8_t* done,
+                const HanabiParallelEnv::HanabiStepResultBuffers& results);
+  /** \brief Write the observation row, legal moves and score of a game.
+   */
+  void ObserveGame(
+      const int game_index,
+      const HanabiParallelEnv::HanabiBatchObservationBuffers& buffers) const;
+
+  const HanabiGame* game_;        //< Game parameters.
+  const int first_stream_;        //< Random stream of game 0.
+  int observation_len_;           //< Length of an encoded observation.
+  std::vector<Game> games_;       //< State of every game.
+};
+
+/** \brief Specialized engine for game, or null if game's configuration is
+ *  not among the instantiated ones: 2 to 5 players with the standard colors,
+ *  ranks, hand sizes and tokens.
+ *
+ *  \param game Game of the engine; must outlive it.
+ *  \param n_games Number of games.
+ *  \param first_stream Random stream of the first game.
+ */
+std::unique_ptr<FixedBatchEngineBase> NewFixedBatchEngine(
+    const HanabiGame* game, const int n_games, const int first_stream);
+
+}  // namespace hanabi_learning_env
+
+#endif // __HANABI_FIXED_ENGINE_H__
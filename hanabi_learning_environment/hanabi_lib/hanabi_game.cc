@@ -106,9 +106,26 @@ int HanabiGame::GetChanceOutcomeUid(HanabiMove move) const {
 HanabiMove HanabiGame::PickRandomChance(
     const std::pair<std::vector<HanabiMove>, std::vector<double>>&
         chance_outcomes) const {
-  std::discrete_distribution<std::mt19937::result_type> dist(
-      chance_outcomes.second.begin(), chance_outcomes.second.end());
-  return chance_outcomes.first[dist(rng_)];
+  const std::vector<double>& probabilities = chance_outcomes.second;
+  REQUIRE(probabilities.size() == chance_outcomes.first.size());
+  double total = 0;
+  for (const double probability : probabilities) {
+    total += probability;
+  }
+  REQUIRE(total > 0);
+  double pick = std::uniform_real_distribution<double>(0, total)(rng_);
+  // Rounding may leave pick at or past the last positive probability.
+  int outcome = -1;
+  for (int i = 0; i < probabilities.size(); ++i) {
+    if (probabilities[i] > 0) {
+      outcome = i;
+      if (pick < probabilities[i]) {
+        break;
+      }
+      pick -= probabilities[i];
+    }
+  }
+  return chance_outcomes.first[outcome];
 }
 
 std::unordered_map<std::string, std::string> HanabiGame::Parameters() const {
@@ -144,6 +161,18 @@ int HanabiGame::GetSampledStartPlayer() const {
   return 0;
 }
 
+int HanabiGame::GetSampledStartPlayer(CounterRng* rng) const {
+  if (random_start_player_) {
+    return rng->Below(num_players_);
+  }
+  return 0;
+}
+
+int HanabiGame::GetSampledInteger(int n) const {
+  std::uniform_int_distribution<std::mt19937::result_type> dist(0, n - 1);
+  return dist(rng_);
+}
+
 int HanabiGame::HandSizeFromRules() const {
   if (num_players_ < 4) {
     return 5;
@@ -20,6 +20,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "counter_rng.h"
 #include "hanabi_card.h"
 #include "hanabi_move.h"
 
@@ -56,7 +57,8 @@ class HanabiGame {
   // Get unique id for a chance-outcome move. Returns -1 for invalid move.
   int GetChanceOutcomeUid(HanabiMove move) const;
   // Randomly sample a random chance-outcome move from list of moves and
-  // associated probability distribution.
+  // associated probability distribution. The probabilities need not sum to
+  // one. Draws a single number and allocates nothing.
   HanabiMove PickRandomChance(
       const std::pair<std::vector<HanabiMove>, std::vector<double>>&
           chance_outcomes) const;
@@ -84,6 +86,13 @@ class HanabiGame {
 
   // Get the first player to act. Might be randomly generated at each call.
   int GetSampledStartPlayer() const;
+  // As above, but draws from the given random stream.
+  int GetSampledStartPlayer(CounterRng* rng) const;
+  // Uniformly distributed integer in [0, n), n > 0, drawn from the game's
+  // shared generator.
+  int GetSampledInteger(int n) const;
+  // Seed of the game's random number generator (never -1).
+  int Seed() const { return seed_; }
 
  private:
   // Calculating max moves by move type.
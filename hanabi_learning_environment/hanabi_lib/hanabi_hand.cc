@@ -22,39 +22,76 @@
 namespace hanabi_learning_env {
 
 HanabiHand::ValueKnowledge::ValueKnowledge(int value_range)
-    : value_(-1), value_plausible_(std::max(value_range, 0), true) {
-  assert(value_range > 0);
+    : value_(-1),
+      range_(std::max(value_range, 0)),
+      value_plausible_((1 << std::max(value_range, 0)) - 1) {
+  assert(value_range > 0 && value_range <= 8);
 }
 
 void HanabiHand::ValueKnowledge::ApplyIsValueHint(int value) {
-  assert(value >= 0 && value < value_plausible_.size());
+  assert(value >= 0 && value < range_);
   assert(value_ < 0 || value_ == value);
-  assert(value_plausible_[value] == true);
+  assert(IsPlausible(value));
   value_ = value;
-  std::fill(value_plausible_.begin(), value_plausible_.end(), false);
-  value_plausible_[value] = true;
+  value_plausible_ = 1 << value;
 }
 
 void HanabiHand::ValueKnowledge::ApplyIsNotValueHint(int value) {
-  assert(value >= 0 && value < value_plausible_.size());
+  assert(value >= 0 && value < range_);
   assert(value_ < 0 || value_ != value);
-  value_plausible_[value] = false;
+  value_plausible_ &= ~(1 << value);
 }
 
 HanabiHand::CardKnowledge::CardKnowledge(int num_colors, int num_ranks)
-    : color_(num_colors), rank_(num_ranks) {}
+    : plausible_((static_cast<uint32_t>(1) << (num_colors * num_ranks)) - 1),
+      first_rank_mask_(0),
+      num_colors_(num_colors),
+      num_ranks_(num_ranks) {
+  assert(num_colors > 0 && num_ranks > 0 && num_colors * num_ranks <= 32);
+  for (int color = 0; color < num_colors; ++color) {
+    first_rank_mask_ |= static_cast<uint32_t>(1) << (color * num_ranks);
+  }
+}
+
+void HanabiHand::CardKnowledge::ApplyIsColorHint(int color) {
+  assert(color >= 0 && color < num_colors_);
+  assert(color_ < 0 || color_ == color);
+  assert(ColorPlausible(color));
+  color_ = color;
+  plausible_ &= ColorMask(color);
+}
+
+void HanabiHand::CardKnowledge::ApplyIsNotColorHint(int color) {
+  assert(color >= 0 && color < num_colors_);
+  assert(color_ < 0 || color_ != color);
+  plausible_ &= ~ColorMask(color);
+}
+
+void HanabiHand::CardKnowledge::ApplyIsRankHint(int rank) {
+  assert(rank >= 0 && rank < num_ranks_);
+  assert(rank_ < 0 || rank_ == rank);
+  assert(RankPlausible(rank));
+  rank_ = rank;
+  plausible_ &= RankMask(rank);
+}
+
+void HanabiHand::CardKnowledge::ApplyIsNotRankHint(int rank) {
+  assert(rank >= 0 && rank < num_ranks_);
+  assert(rank_ < 0 || rank_ != rank);
+  plausible_ &= ~RankMask(rank);
+}
 
 std::string HanabiHand::CardKnowledge::ToString() const {
   std::string result;
   result = result + (ColorHinted() ? ColorIndexToChar(Color()) : 'X') +
            (RankHinted() ? RankIndexToChar(Rank()) : 'X') + '|';
-  for (int c = 0; c < color_.Range(); ++c) {
-    if (color_.IsPlausible(c)) {
+  for (int c = 0; c < num_colors_; ++c) {
+    if (ColorPlausible(c)) {
       result += ColorIndexToChar(c);
     }
   }
-  for (int r = 0; r < rank_.Range(); ++r) {
-    if (rank_.IsPlausible(r)) {
+  for (int r = 0; r < num_ranks_; ++r) {
+    if (RankPlausible(r)) {
       result += RankIndexToChar(r);
     }
   }
@@ -63,13 +100,18 @@ std::string HanabiHand::CardKnowledge::ToString() const {
 
 HanabiHand::HanabiHand(const HanabiHand& hand, bool hide_cards,
                        bool hide_knowledge) {
+  Assign(hand, hide_cards, hide_knowledge);
+}
+
+void HanabiHand::Assign(const HanabiHand& hand, bool hide_cards,
+                        bool hide_knowledge) {
   if (hide_cards) {
-    cards_.resize(hand.cards_.size(), HanabiCard());
+    cards_.assign(hand.cards_.size(), HanabiCard());
   } else {
     cards_ = hand.cards_;
   }
   if (hide_knowledge && !hand.cards_.empty()) {
-    card_knowledge_.resize(hand.cards_.size(),
+    card_knowledge_.assign(hand.cards_.size(),
                            CardKnowledge(hand.card_knowledge_[0].NumColors(),
                                          hand.card_knowledge_[0].NumRanks()));
   } else {
@@ -84,6 +126,11 @@ void HanabiHand::AddCard(HanabiCard card,
   card_knowledge_.push_back(initial_knowledge);
 }
 
+void HanabiHand::ReplaceCard(int card_index, HanabiCard card) {
+  REQUIRE(card.IsValid());
+  cards_[card_index] = card;
+}
+
 void HanabiHand::RemoveFromHand(int card_index,
                                 std::vector<HanabiCard>* discard_pile) {
   if (discard_pile != nullptr) {
@@ -93,34 +140,68 @@ void HanabiHand::RemoveFromHand(int card_index,
   card_knowledge_.erase(card_knowledge_.begin() + card_index);
 }
 
+void HanabiHand::InsertCard(int card_index, HanabiCard card,
+                            const CardKnowledge& knowledge) {
+  REQUIRE(card.IsValid());
+  REQUIRE(card_index >= 0 && card_index <= cards_.size());
+  cards_.insert(cards_.begin() + card_index, card);
+  card_knowledge_.insert(card_knowledge_.begin() + card_index, knowledge);
+}
+
+void HanabiHand::RestoreKnowledge(
+    const std::vector<CardKnowledge>& knowledge) {
+  REQUIRE(knowledge.size() == cards_.size());
+  card_knowledge_ = knowledge;
+}
+
 uint8_t HanabiHand::RevealColor(const int color) {
-  uint8_t mask = 0;
   assert(cards_.size() <= 8);  // More than 8 cards is currently not supported.
+  if (cards_.empty()) {
+    return 0;
+  }
+  // Matching cards keep only the plausible cards of the color, the others
+  // lose them.
+  const uint32_t color_mask = card_knowledge_[0].ColorMask(color);
+  uint8_t mask = 0;
   for (int i = 0; i < cards_.size(); ++i) {
-    if (cards_[i].Color() == color) {
-      if (!card_knowledge_[i].ColorHinted()) {
-        mask |= static_cast<uint8_t>(1) << i;
-      }
-      card_knowledge_[i].ApplyIsColorHint(color);
-    } else {
-      card_knowledge_[i].ApplyIsNotColorHint(color);
-    }
+    CardKnowledge& knowledge = card_knowledge_[i];
+    const bool match = cards_[i].Color() == color;
+    mask |= static_cast<uint8_t>(match && knowledge.color_ < 0) << i;
+    knowledge.plausible_ &= match ? color_mask : ~color_mask;
+    knowledge.color_ = match ? color : knowledge.color_;
   }
   return mask;
 }
 
 uint8_t HanabiHand::RevealRank(const int rank) {
-  uint8_t mask = 0;
   assert(cards_.size() <= 8);  // More than 8 cards is currently not supported.
+  if (cards_.empty()) {
+    return 0;
+  }
+  const uint32_t rank_mask = card_knowledge_[0].RankMask(rank);
+  uint8_t mask = 0;
   for (int i = 0; i < cards_.size(); ++i) {
-    if (cards_[i].Rank() == rank) {
-      if (!card_knowledge_[i].RankHinted()) {
-        mask |= static_cast<uint8_t>(1) << i;
-      }
-      card_knowledge_[i].ApplyIsRankHint(rank);
-    } else {
-      card_knowledge_[i].ApplyIsNotRankHint(rank);
-    }
+    CardKnowledge& knowledge = card_knowledge_[i];
+    const bool match = cards_[i].Rank() == rank;
+    mask |= static_cast<uint8_t>(match && knowledge.rank_ < 0) << i;
+    knowledge.plausible_ &= match ? rank_mask : ~rank_mask;
+    knowledge.rank_ = match ? rank : knowledge.rank_;
+  }
+  return mask;
+}
+
+uint8_t HanabiHand::ColorPresenceMask() const {
+  uint8_t mask = 0;
+  for (const HanabiCard& card : cards_) {
+    mask |= static_cast<uint8_t>(1) << card.Color();
+  }
+  return mask;
+}
+
+uint8_t HanabiHand::RankPresenceMask() const {
+  uint8_t mask = 0;
+  for (const HanabiCard& card : cards_) {
+    mask |= static_cast<uint8_t>(1) << card.Rank();
   }
   return mask;
 }
@@ -38,13 +38,13 @@ class HanabiHand {
     // ValueHinted()=true, value()=0, and ValueCouldBe(v)=false for v=1, and 2.
    public:
     explicit ValueKnowledge(int value_range);
-    int Range() const { return value_plausible_.size(); }
+    int Range() const { return range_; }
     // Returns true if and only if the exact value was revealed.
     // Does not perform inference to get a known value from not-value hints.
     bool ValueHinted() const { return value_ >= 0; }
     int Value() const { return value_; }  // -1 if value was not hinted.
     // Returns true if we have no hint saying variable is not the given value.
-    bool IsPlausible(int value) const { return value_plausible_[value]; }
+    bool IsPlausible(int value) const { return (value_plausible_ >> value) & 1; }
     // Record a hint that gives the value of the variable.
     void ApplyIsValueHint(int value);
     // Record a hint that the variable does not have the given value.
@@ -52,41 +52,65 @@ class HanabiHand {
 
    private:
     // Value if hint directly provided the value, or -1 with no direct hint.
-    int value_ = -1;
-    std::vector<bool> value_plausible_;  // Knowledge from not-value hints.
+    int8_t value_ = -1;
+    int8_t range_ = 0;
+    uint8_t value_plausible_ = 0;  // Bit v set iff v is plausible.
   };
 
   class CardKnowledge {
     // Hinted knowledge about color and rank of an initially unknown card.
+    // The plausible cards are a bitmask with bit color * num_ranks + rank
+    // set iff the card could have that color and rank, the same order as
+    // the plausible cards of the canonical encoding. Hints only ever remove
+    // whole colors or ranks, so a color is plausible iff some card of that
+    // color is.
    public:
     CardKnowledge(int num_colors, int num_ranks);
     // Returns number of possible colors being tracked.
-    int NumColors() const { return color_.Range(); }
+    int NumColors() const { return num_colors_; }
     // Returns true if and only if the exact color was revealed.
     // Does not perform inference to get a known color from not-color hints.
-    bool ColorHinted() const { return color_.ValueHinted(); }
+    bool ColorHinted() const { return color_ >= 0; }
     // Color of card if it was hinted, -1 if not hinted.
-    int Color() const { return color_.Value(); }
+    int Color() const { return color_; }
     // Returns true if we have no hint saying card is not the given color.
-    bool ColorPlausible(int color) const { return color_.IsPlausible(color); }
-    void ApplyIsColorHint(int color) { color_.ApplyIsValueHint(color); }
-    void ApplyIsNotColorHint(int color) { color_.ApplyIsNotValueHint(color); }
+    bool ColorPlausible(int color) const {
+      return (plausible_ & ColorMask(color)) != 0;
+    }
+    void ApplyIsColorHint(int color);
+    void ApplyIsNotColorHint(int color);
     // Returns number of possible ranks being tracked.
-    int NumRanks() const { return rank_.Range(); }
+    int NumRanks() const { return num_ranks_; }
     // Returns true if and only if the exact rank was revealed.
     // Does not perform inference to get a known rank from not-rank hints.
-    bool RankHinted() const { return rank_.ValueHinted(); }
+    bool RankHinted() const { return rank_ >= 0; }
     // Rank of card if it was hinted, -1 if not hinted.
-    int Rank() const { return rank_.Value(); }
+    int Rank() const { return rank_; }
     // Returns true if we have no hint saying card is not the given rank.
-    bool RankPlausible(int rank) const { return rank_.IsPlausible(rank); }
-    void ApplyIsRankHint(int rank) { rank_.ApplyIsValueHint(rank); }
-    void ApplyIsNotRankHint(int rank) { rank_.ApplyIsNotValueHint(rank); }
+    bool RankPlausible(int rank) const {
+      return (plausible_ & RankMask(rank)) != 0;
+    }
+    void ApplyIsRankHint(int rank);
+    void ApplyIsNotRankHint(int rank);
+    // Bit color * NumRanks() + rank set iff the card could be (color, rank).
+    uint32_t PlausibleMask() const { return plausible_; }
+    // Bits of PlausibleMask() of all cards of a color, or of a rank.
+    uint32_t ColorMask(int color) const {
+      return ((static_cast<uint32_t>(1) << num_ranks_) - 1)
+             << (color * num_ranks_);
+    }
+    uint32_t RankMask(int rank) const { return first_rank_mask_ << rank; }
     std::string ToString() const;
 
    private:
-    ValueKnowledge color_;
-    ValueKnowledge rank_;
+    friend class HanabiHand;  // Applies reveals to whole hands.
+
+    uint32_t plausible_;
+    uint32_t first_rank_mask_;  // RankMask(0), bit c * num_ranks_ per color.
+    int8_t num_colors_;
+    int8_t num_ranks_;
+    int8_t color_ = -1;  // Hinted color, -1 if not hinted.
+    int8_t rank_ = -1;   // Hinted rank, -1 if not hinted.
   };
 
   HanabiHand() {}
@@ -95,6 +119,8 @@ class HanabiHand {
   // Copy hand. Hide cards (set to invalid) if hide_cards is true.
   // Hide card knowledge (set to unknown) if hide_knowledge is true.
   HanabiHand(const HanabiHand& hand, bool hide_cards, bool hide_knowledge);
+  // Same as the constructor above, reusing the memory of this hand.
+  void Assign(const HanabiHand& hand, bool hide_cards, bool hide_knowledge);
   // Cards and corresponding card knowledge are always arranged from oldest to
   // newest, with the oldest card or knowledge at index 0.
   const std::vector<HanabiCard>& Cards() const { return cards_; }
@@ -102,9 +128,16 @@ class HanabiHand {
     return card_knowledge_;
   }
   void AddCard(HanabiCard card, const CardKnowledge& initial_knowledge);
+  // Replace the card at card_index, keeping its knowledge.
+  void ReplaceCard(int card_index, HanabiCard card);
   // Remove card_index card from hand. Put in discard_pile if not nullptr
   // (pushes the card to the back of the discard_pile vector).
   void RemoveFromHand(int card_index, std::vector<HanabiCard>* discard_pile);
+  // Put back a card removed by RemoveFromHand, with its knowledge.
+  void InsertCard(int card_index, HanabiCard card,
+                  const CardKnowledge& knowledge);
+  // Replace the knowledge of all cards, e.g. by a copy from before a reveal.
+  void RestoreKnowledge(const std::vector<CardKnowledge>& knowledge);
   // Make cards with the given rank visible.
   // Returns new information bitmask, bit_i set if card_i color was revealed
   // and was previously unknown.
@@ -113,6 +146,12 @@ class HanabiHand {
   // Returns new information bitmask, bit_i set if card_i color was revealed
   // and was previously unknown.
   uint8_t RevealColor(int color);
+  // Bitmask of the colors present in the hand, bit c set iff some card has
+  // color c.
+  uint8_t ColorPresenceMask() const;
+  // Bitmask of the ranks present in the hand, bit r set iff some card has
+  // rank r.
+  uint8_t RankPresenceMask() const;
   std::string ToString() const;
 
  private:
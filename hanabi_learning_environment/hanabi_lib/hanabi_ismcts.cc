@@ -0,0 +1,230 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hanabi_ismcts.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "hanabi_determinization.h"
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+namespace {
+
+// Iterations between two looks at the clock.
+constexpr int kClockInterval = 16;
+
+double Now() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Uid of a uniformly drawn set bit of mask, which must not be 0.
+int DrawSetBit(uint64_t mask, CounterRng* rng) {
+  for (uint32_t k = rng->Below(PopCount(mask)); k > 0; --k) {
+    mask &= mask - 1;
+  }
+  return LowestSetBit(mask);
+}
+
+}  // namespace
+
+HanabiIsmcts::HanabiIsmcts(const IsmctsConfig& config,
+                           const HanabiPolicy* rollout_policy)
+    : config_(config),
+      rollout_policy_(rollout_policy != nullptr ? rollout_policy
+                                                : &random_policy_) {
+  REQUIRE(config_.max_iterations > 0 || config_.time_limit > 0);
+  REQUIRE(config_.max_nodes > 0);
+}
+
+int HanabiIsmcts::FindChild(const std::vector<Node>& nodes, int node,
+                            int uid) {
+  int child = nodes[node].first_child;
+  while (nodes[child].move_uid != uid) {
+    child = nodes[child].next_sibling;
+  }
+  return child;
+}
+
+std::vector<int64_t> HanabiIsmcts::Search(const HanabiState& state) {
+  REQUIRE(!state.IsTerminal());
+  REQUIRE(state.CurPlayer() != kChancePlayerId);
+  const int max_moves = state.ParentGame()->MaxMoves();
+  const double deadline = config_.time_limit > 0
+                              ? Now() + config_.time_limit
+                              : std::numeric_limits<double>::infinity();
+
+  // Worlds are copied from the root on every iteration: leave the history
+  // behind.
+  HanabiState root(state);
+  root.SetHistoryMode(HanabiState::kNoHistory);
+
+  int num_threads = config_.num_threads;
+#ifdef _OPENMP
+  if (num_threads <= 0) {
+    num_threads = omp_get_max_threads();
+  }
+#endif
+  num_threads = std::max(num_threads, 1);
+  if (trees_.size() < static_cast<size_t>(num_threads)) {
+    trees_.resize(num_threads);
+  }
+  const uint64_t search = num_searches_++;
+
+  std::vector<int64_t> thread_iterations(num_threads, 0);
+  #pragma omp parallel for schedule(static, 1) num_threads(num_threads)
+  for (int thread = 0; thread < num_threads; ++thread) {
+    // Iterations are shared out evenly; 0 stands for no limit.
+    int64_t max_iterations = 0;
+    if (config_.max_iterations > 0) {
+      max_iterations = config_.max_iterations / num_threads +
+                       (thread < config_.max_iterations % num_threads);
+      if (max_iterations == 0) {
+        continue;
+      }
+    }
+    CounterRng rng(config_.seed, search, thread);
+    thread_iterations[thread] =
+        SearchTree(root, max_iterations, deadline, &rng, &trees_[thread]);
+  }
+
+  std::vector<int64_t> visits(max_moves, 0);
+  num_iterations_ = 0;
+  for (int thread = 0; thread < num_threads; ++thread) {
+    if (thread_iterations[thread] == 0) {
+      continue;
+    }
+    num_iterations_ += thread_iterations[thread];
+    const std::vector<Node>& nodes = trees_[thread];
+    for (int child = nodes[0].first_child; child >= 0;
+         child = nodes[child].next_sibling) {
+      visits[nodes[child].move_uid] += nodes[child].visits;
+    }
+  }
+  return visits;
+}
+
+int64_t HanabiIsmcts::SearchTree(const HanabiState& root,
+                                 int64_t max_iterations, double deadline,
+                                 CounterRng* rng,
+                                 std::vector<Node>* nodes) const {
+  const int observer = root.CurPlayer();
+  const double reward_scale = 1.0 / root.ParentGame()->MaxScore();
+  nodes->clear();
+  nodes->emplace_back();
+  HanabiState world(root);
+  std::vector<int> path;
+
+  int64_t iteration = 0;
+  for (; max_iterations == 0 || iteration < max_iterations; ++iteration) {
+    if (iteration % kClockInterval == 0 && Now() >= deadline) {
+      break;
+    }
+    if (!SampleDeterminization(root, observer, rng, &world)) {
+      // The world holds the observer's actual cards; searching it would leak
+      // them into the visits.
+      continue;
+    }
+
+    // Selection and expansion.
+    int node = 0;
+    path.assign(1, 0);
+    while (!world.IsTerminal()) {
+      if (world.CurPlayer() == kChancePlayerId) {
+        world.ApplyRandomChance();
+        continue;
+      }
+      const uint64_t legal = world.LegalMovesMask(world.CurPlayer());
+      const uint64_t untried = legal & ~(*nodes)[node].children_mask;
+      if (untried != 0 && nodes->size() < static_cast<size_t>(config_.max_nodes)) {
+        const int uid = DrawSetBit(untried, rng);
+        const int child = nodes->size();
+        nodes->emplace_back();
+        Node& new_node = nodes->back();
+        new_node.move_uid = uid;
+        new_node.next_sibling = (*nodes)[node].first_child;
+        new_node.availability = 1;
+        (*nodes)[node].first_child = child;
+        (*nodes)[node].children_mask |= static_cast<uint64_t>(1) << uid;
+        // The other legal children were available too.
+        for (uint64_t bits = legal & ~untried; bits != 0; bits &= bits - 1) {
+          ++(*nodes)[FindChild(*nodes, node, LowestSetBit(bits))]
+                .availability;
+        }
+        world.ApplyMove(world.ParentGame()->GetMove(uid));
+        path.push_back(child);
+        break;
+      }
+      if ((legal & (*nodes)[node].children_mask) == 0) {
+        break;  // Tree is full.
+      }
+      int best = -1;
+      double best_value = -std::numeric_limits<double>::infinity();
+      for (int child = (*nodes)[node].first_child; child >= 0;
+           child = (*nodes)[child].next_sibling) {
+        Node& candidate = (*nodes)[child];
+        if (((legal >> candidate.move_uid) & 1) == 0) {
+          continue;
+        }
+        ++candidate.availability;
+        const double value =
+            candidate.total_reward / candidate.visits +
+            config_.exploration *
+                std::sqrt(std::log(candidate.availability) / candidate.visits);
+        if (value > best_value) {
+          best_value = value;
+          best = child;
+        }
+      }
+      world.ApplyMove(world.ParentGame()->GetMove((*nodes)[best].move_uid));
+      path.push_back(best);
+      node = best;
+    }
+
+    // Rollout.
+    while (!world.IsTerminal()) {
+      if (world.CurPlayer() == kChancePlayerId) {
+        world.ApplyRandomChance();
+      } else {
+        world.ApplyMove(rollout_policy_->Act(world, rng));
+      }
+    }
+
+    // Backpropagation. The game is cooperative: one reward for everyone.
+    int score = world.Score();
+    if (config_.fireworks_reward) {
+      const std::vector<int>& fireworks = world.Fireworks();
+      score = std::accumulate(fireworks.begin(), fireworks.end(), 0);
+    }
+    const float reward = score * reward_scale;
+    for (int n : path) {
+      ++(*nodes)[n].visits;
+      (*nodes)[n].total_reward += reward;
+    }
+  }
+  return iteration;
+}
+
+}  // namespace hanabi_learning_env
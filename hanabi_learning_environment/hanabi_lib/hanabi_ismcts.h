@@ -0,0 +1,111 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Information set Monte Carlo tree search (single observer ISMCTS) over
+// HanabiState, for search-time policy improvement.
+
+#ifndef __HANABI_ISMCTS_H__
+#define __HANABI_ISMCTS_H__
+
+#include <cstdint>
+#include <vector>
+
+#include "counter_rng.h"
+#include "hanabi_game.h"
+#include "hanabi_rollout.h"
+#include "hanabi_state.h"
+
+namespace hanabi_learning_env {
+
+struct IsmctsConfig {
+  // Iterations of a search, over all threads; 0 for no limit, in which case
+  // time_limit must be set. Each iteration adds at most one node.
+  int64_t max_iterations = 1000;
+  // Wall-clock limit of a search in seconds, 0 for none.
+  double time_limit = 0;
+  // Nodes of the tree of one thread. Once it is full, iterations go on
+  // without expanding the tree.
+  int max_nodes = 1 << 20;
+  // UCB exploration constant. Rewards are final scores divided by the
+  // maximum score.
+  double exploration = 0.1;
+  // Whether games lost for want of life tokens score the cards on the
+  // fireworks rather than 0. Weak rollout policies lose nearly every game,
+  // which would leave the search without a signal.
+  bool fireworks_reward = true;
+  // Threads, each growing its own tree (root parallelization); 0 for all
+  // OpenMP threads.
+  int num_threads = 0;
+  uint64_t seed = 0;
+};
+
+// Searches from the point of view of the current player of a state. Every
+// iteration draws a world consistent with what the player knows (see
+// SampleDeterminization), walks down the tree choosing among the moves legal
+// in that world by UCB, with the number of iterations in which a move was
+// legal in place of its parent's visits, adds one node, and plays the game
+// out with the rollout policy. Nodes stand for sequences of moves; deals are
+// drawn from the world's deck and are not part of the tree.
+//
+// Worlds come from the slot-by-slot proposal of SampleOwnHand, not from the
+// posterior: their weights are ignored. Iterations whose world cannot be
+// drawn are skipped; they count against max_iterations but add no visits.
+//
+// Trees live in arenas which are reused across searches.
+class HanabiIsmcts {
+ public:
+  // rollout_policy must outlive the search; nullptr for RandomPolicy.
+  explicit HanabiIsmcts(const IsmctsConfig& config,
+                        const HanabiPolicy* rollout_policy = nullptr);
+
+  // Returns the visits of every move of the root by move uid, MaxMoves()
+  // entries summed over the threads. state must not be terminal nor at a
+  // chance node. Searches draw from random streams derived from the seed and
+  // the number of searches made so far, so that they are reproducible when
+  // not limited by time.
+  std::vector<int64_t> Search(const HanabiState& state);
+  // Iterations made by the last search.
+  int64_t NumIterations() const { return num_iterations_; }
+  const IsmctsConfig& Config() const { return config_; }
+
+ private:
+  struct Node {
+    uint64_t children_mask = 0;  // Bit uid set iff a child has move uid.
+    int32_t first_child = -1;
+    int32_t next_sibling = -1;
+    int32_t move_uid = -1;       // Move leading to this node.
+    int32_t visits = 0;
+    int32_t availability = 0;    // Iterations the move was legal in.
+    float total_reward = 0;
+  };
+
+  // Grows the tree of one thread from root until the iterations or the time
+  // are used up, returns the number of iterations.
+  int64_t SearchTree(const HanabiState& root, int64_t max_iterations,
+                     double deadline, CounterRng* rng,
+                     std::vector<Node>* nodes) const;
+  // Index of the child of a node with move uid.
+  static int FindChild(const std::vector<Node>& nodes, int node, int uid);
+
+  IsmctsConfig config_;
+  RandomPolicy random_policy_;
+  const HanabiPolicy* rollout_policy_;
+  std::vector<std::vector<Node>> trees_;  // Node arena per thread.
+  uint64_t num_searches_ = 0;
+  int64_t num_iterations_ = 0;
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
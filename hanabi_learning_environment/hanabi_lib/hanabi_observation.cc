@@ -50,44 +50,64 @@ void ChangeHistoryItemToObserverRelative(int observer_pid, int num_players,
 }  // namespace
 
 HanabiObservation::HanabiObservation(const HanabiState& state,
-                                     int observing_player)
-    : cur_player_offset_(PlayerToOffset(state.CurPlayer(), observing_player,
-                                        state.ParentGame()->NumPlayers())),
-      discard_pile_(state.DiscardPile()),
-      fireworks_(state.Fireworks()),
-      deck_size_(state.Deck().Size()),
-      information_tokens_(state.InformationTokens()),
-      life_tokens_(state.LifeTokens()),
-      legal_moves_(state.LegalMoves(observing_player)),
-      parent_game_(state.ParentGame()) {
-  REQUIRE(observing_player >= 0 &&
-          observing_player < state.ParentGame()->NumPlayers());
-  hands_.reserve(state.Hands().size());
+                                     int observing_player) {
+  Assign(state, observing_player);
+}
+
+void HanabiObservation::Assign(const HanabiState& state,
+                               int observing_player) {
+  const int num_players = state.ParentGame()->NumPlayers();
+  REQUIRE(observing_player >= 0 && observing_player < num_players);
+  // Without a history, the last moves would be silently missing.
+  REQUIRE(state.GetHistoryMode() != HanabiState::kNoHistory);
+  cur_player_offset_ =
+      PlayerToOffset(state.CurPlayer(), observing_player, num_players);
+  discard_pile_ = state.DiscardPile();
+  for (int color = 0; color < state.ParentGame()->NumColors(); ++color) {
+    for (int rank = 0; rank < state.ParentGame()->NumRanks(); ++rank) {
+      discard_counts_[color * state.ParentGame()->NumRanks() + rank] =
+          state.DiscardCount(color, rank);
+    }
+  }
+  fireworks_ = state.Fireworks();
+  deck_size_ = state.Deck().Size();
+  information_tokens_ = state.InformationTokens();
+  life_tokens_ = state.LifeTokens();
+  parent_game_ = state.ParentGame();
+  legal_moves_.clear();
+  for (uint64_t mask = state.LegalMovesMask(observing_player); mask != 0;
+       mask &= mask - 1) {
+    legal_moves_.push_back(state.ParentGame()->GetMove(LowestSetBit(mask)));
+  }
+
+  hands_.resize(num_players);
   const bool hide_knowledge =
       state.ParentGame()->ObservationType() == HanabiGame::kMinimal;
   const bool show_cards = state.ParentGame()->ObservationType() == HanabiGame::kSeer;
-  hands_.push_back(
-      HanabiHand(state.Hands()[observing_player], !show_cards, hide_knowledge));
-  for (int offset = 1; offset < state.ParentGame()->NumPlayers(); ++offset) {
-    hands_.push_back(HanabiHand(state.Hands()[(observing_player + offset) %
-                                              state.ParentGame()->NumPlayers()],
-                                false, hide_knowledge));
+  hands_[0].Assign(state.Hands()[observing_player], !show_cards,
+                   hide_knowledge);
+  for (int offset = 1; offset < num_players; ++offset) {
+    hands_[offset].Assign(
+        state.Hands()[(observing_player + offset) % num_players], false,
+        hide_knowledge);
   }
 
-  const auto& history = state.MoveHistory();
-  auto start = std::find_if(history.begin(), history.end(),
-                            [](const HanabiHistoryItem& item) {
-                              return item.player != kChancePlayerId;
-                            });
-  std::reverse_iterator<decltype(start)> rend(start);
-  for (auto it = history.rbegin(); it != rend; ++it) {
-    last_moves_.push_back(*it);
-    ChangeHistoryItemToObserverRelative(observing_player,
-                                        state.ParentGame()->NumPlayers(),
-                                        show_cards,
-                                        &last_moves_.back());
-    if (it->player == observing_player) {
-      break;
+  // The moves since the observer's last move, that move included, or since
+  // the first player move if the observer has not moved yet. Only those
+  // still in the history, if the state does not keep all of it.
+  last_moves_.clear();
+  int first_move = state.LastMoveIndex(observing_player);
+  if (first_move < 0) {
+    first_move = state.FirstPlayerMoveIndex();
+  }
+  if (first_move >= 0) {
+    const auto& history = state.MoveHistory();
+    const int history_start = state.HistoryStart();
+    for (int i = state.NumMoves() - 1;
+         i >= std::max(first_move, history_start); --i) {
+      last_moves_.push_back(history[i - history_start]);
+      ChangeHistoryItemToObserverRelative(observing_player, num_players,
+                                          show_cards, &last_moves_.back());
     }
   }
 }
@@ -126,4 +146,45 @@ bool HanabiObservation::CardPlayableOnFireworks(int color, int rank) const {
   return rank == fireworks_[color];
 }
 
+HanabiObservationView::HanabiObservationView(const HanabiState& state,
+                                             int observing_player)
+    : state_(&state),
+      observer_(observing_player),
+      num_players_(state.ParentGame()->NumPlayers()) {
+  REQUIRE(observing_player >= 0 && observing_player < num_players_);
+  REQUIRE(state.GetHistoryMode() != HanabiState::kNoHistory);
+}
+
+int HanabiObservationView::CurPlayerOffset() const {
+  return PlayerToOffset(state_->CurPlayer(), observer_, num_players_);
+}
+
+HanabiCard HanabiObservationView::Card(int offset, int card_index) const {
+  if (offset == 0 && ParentGame()->ObservationType() != HanabiGame::kSeer) {
+    return HanabiCard();
+  }
+  return Hand(offset).Cards()[card_index];
+}
+
+HanabiHand::CardKnowledge HanabiObservationView::Knowledge(
+    int offset, int card_index) const {
+  if (ParentGame()->ObservationType() == HanabiGame::kMinimal) {
+    return HanabiHand::CardKnowledge(ParentGame()->NumColors(),
+                                     ParentGame()->NumRanks());
+  }
+  return Hand(offset).Knowledge()[card_index];
+}
+
+bool HanabiObservationView::LastNonDealMove(HanabiHistoryItem* item) const {
+  const auto& history = state_->MoveHistory();
+  for (auto it = history.rbegin(); it != history.rend(); ++it) {
+    if (it->move.MoveType() != HanabiMove::kDeal) {
+      *item = *it;
+      item->player = PlayerToOffset(item->player, observer_, num_players_);
+      return true;
+    }
+  }
+  return false;
+}
+
 }  // namespace hanabi_learning_env
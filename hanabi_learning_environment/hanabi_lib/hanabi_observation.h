@@ -24,13 +24,19 @@
 #include "hanabi_history_item.h"
 #include "hanabi_move.h"
 #include "hanabi_state.h"
+#include "util.h"
 
 namespace hanabi_learning_env {
 
 // Agent observation of a HanabiState
 class HanabiObservation {
  public:
+  // The state must keep at least its recent history (see
+  // HanabiState::SetHistoryMode), which holds the moves observed.
   HanabiObservation(const HanabiState& state, int observing_player);
+  // Makes this the observation of state by observing_player, reusing the
+  // memory of the observation it was. See HanabiArena.
+  void Assign(const HanabiState& state, int observing_player);
 
   std::string ToString() const;
 
@@ -42,6 +48,10 @@ class HanabiObservation {
   const std::vector<HanabiHand>& Hands() const { return hands_; }
   // The element at the back is the most recent discard.
   const std::vector<HanabiCard>& DiscardPile() const { return discard_pile_; }
+  // Number of cards of color and rank in the discard pile.
+  int DiscardCount(int color, int rank) const {
+    return discard_counts_[color * parent_game_->NumRanks() + rank];
+  }
   const std::vector<int>& Fireworks() const { return fireworks_; }
   int DeckSize() const { return deck_size_; }  // number of remaining cards
   const HanabiGame* ParentGame() const { return parent_game_; }
@@ -66,6 +76,7 @@ class HanabiObservation {
   int cur_player_offset_;  // offset of current_player from observing_player
   std::vector<HanabiHand> hands_;         // observing player is element 0
   std::vector<HanabiCard> discard_pile_;  // back is most recent discard
+  uint8_t discard_counts_[kMaxNumColors * kMaxNumRanks] = {};
   std::vector<int> fireworks_;
   int deck_size_;
   std::vector<HanabiHistoryItem> last_moves_;
@@ -75,6 +86,67 @@ class HanabiObservation {
   const HanabiGame* parent_game_ = nullptr;
 };
 
+// Lightweight alternative to HanabiObservation: an observer-relative view
+// of a HanabiState which copies nothing and computes every field on demand,
+// for encoding observations without allocating. The view must not outlive
+// the state, and reflects later changes to it.
+//
+// Unlike HanabiObservation, Hand() returns the hands as they are in the
+// state: the observer's own cards are not hidden, and neither is card
+// knowledge in kMinimal games. Use Card() and Knowledge() for what the
+// observer may see.
+class HanabiObservationView {
+ public:
+  // Like HanabiObservation, the state must not be in kNoHistory.
+  HanabiObservationView(const HanabiState& state, int observing_player);
+
+  // offset of current player from observing player.
+  int CurPlayerOffset() const;
+  // Hand of the player at offset clock-wise from the observing player, not
+  // hidden, see above.
+  const HanabiHand& Hand(int offset) const {
+    return state_->Hands()[(observer_ + offset) % num_players_];
+  }
+  // Card card_index of the player at offset, an invalid card if the
+  // observer may not see it.
+  HanabiCard Card(int offset, int card_index) const;
+  // Knowledge of card card_index of the player at offset, all unknown in
+  // kMinimal games.
+  HanabiHand::CardKnowledge Knowledge(int offset, int card_index) const;
+  // The element at the back is the most recent discard.
+  const std::vector<HanabiCard>& DiscardPile() const {
+    return state_->DiscardPile();
+  }
+  int DiscardCount(int color, int rank) const {
+    return state_->DiscardCount(color, rank);
+  }
+  const std::vector<int>& Fireworks() const { return state_->Fireworks(); }
+  int DeckSize() const { return state_->Deck().Size(); }
+  const HanabiGame* ParentGame() const { return state_->ParentGame(); }
+  // The most recent move other than a deal, observer-relative like
+  // HanabiObservation::LastMoves. Returns false if there was none.
+  bool LastNonDealMove(HanabiHistoryItem* item) const;
+  int InformationTokens() const { return state_->InformationTokens(); }
+  int LifeTokens() const { return state_->LifeTokens(); }
+  // Legal moves of the observer, see HanabiState::LegalMovesMask.
+  uint64_t LegalMovesMask() const { return state_->LegalMovesMask(observer_); }
+  std::vector<HanabiMove> LegalMoves() const {
+    return state_->LegalMoves(observer_);
+  }
+
+  bool CardPlayableOnFireworks(int color, int rank) const {
+    return state_->CardPlayableOnFireworks(color, rank);
+  }
+  bool CardPlayableOnFireworks(HanabiCard card) const {
+    return CardPlayableOnFireworks(card.Color(), card.Rank());
+  }
+
+ private:
+  const HanabiState* state_;
+  int observer_;
+  int num_players_;
+};
+
 }  // namespace hanabi_learning_env
 
 #endif
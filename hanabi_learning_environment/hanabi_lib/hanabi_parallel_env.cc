@@ -26,35 +26,36 @@
 hanabi_learning_env::HanabiParallelEnv::HanabiParallelEnv(
     const std::unordered_map<std::string,
     std::string>& game_params,
-    const int n_states)
+    const int n_states,
+    const int first_stream)
   : game_(HanabiGame(game_params)),
     observation_encoder_(&game_),
-    n_states_(n_states)
+    n_states_(n_states),
+    first_stream_(first_stream),
+    episode_counters_(n_states, 0),
+    episode_lengths_(n_states, 0),
+    belief_trackers_(n_states * game_.NumPlayers(),
+                     HanabiBeliefTracker(&game_))
 {
   Reset();
 }
 
 void hanabi_learning_env::HanabiParallelEnv::Reset() {
-  parallel_states_.clear();
-  agent_player_mapping_.clear();
-
-  const auto n_players = game_.NumPlayers();
-  agent_player_mapping_.resize(n_players);
-  for (int state_id = 0; state_id < n_states_; ++state_id) {
-    parallel_states_.push_back(NewState());
-    for (size_t agent_idx = 0; agent_idx < n_players; ++agent_idx) {
-      agent_player_mapping_[agent_idx].push_back(
-          (parallel_states_.back().CurPlayer() + agent_idx) % n_players);
-    }
+  parallel_states_.assign(n_states_, HanabiState(&game_));
+  agent_player_mapping_.assign(game_.NumPlayers(), std::vector<int>(n_states_));
+  #pragma omp parallel for
+  for (int state_idx = 0; state_idx < n_states_; ++state_idx) {
+    ResetState(state_idx, 0);
   }
 }
 
 hanabi_learning_env::HanabiState
-hanabi_learning_env::HanabiParallelEnv::NewState() {
-  HanabiState state(&game_);
-  while (state.CurPlayer() == kChancePlayerId) {
-    state.ApplyRandomChance();
-  }
+hanabi_learning_env::HanabiParallelEnv::NewState(const int state_idx) {
+  CounterRng rng(static_cast<uint64_t>(game_.Seed()),
+                 first_stream_ + state_idx, episode_counters_[state_idx]++);
+  HanabiState state(&game_, game_.GetSampledStartPlayer(&rng));
+  state.SetRandomStream(rng);
+  state.SetDirectDeal(true);
   return state;
 }
 
@@ -72,35 +73,80 @@ void hanabi_learning_env::HanabiParallelEnv::ResetStates(
     const int current_agent_id) {
   #pragma omp parallel for
   for (size_t idx = 0; idx < states.size(); ++idx) {
-    const size_t state_idx = states[idx];
-    auto& state = parallel_states_[state_idx];
-    state = NewState();
-    for (int player_idx = 0; player_idx < game_.NumPlayers(); ++player_idx) {
-      const int agent_id =
-        (current_agent_id + player_idx) % game_.NumPlayers();
-      const int corresponding_player_id =
-        (state.CurPlayer() + player_idx) % game_.NumPlayers();
-      agent_player_mapping_[agent_id][state_idx] = corresponding_player_id;
-    }
-    REQUIRE(!parallel_states_[state_idx].IsTerminal());
+    ResetState(states[idx], current_agent_id);
   }
 }
 
+void hanabi_learning_env::HanabiParallelEnv::ResetState(
+    const int state_idx, const int current_agent_id) {
+  auto& state = parallel_states_[state_idx];
+  state = NewState(state_idx);
+  episode_lengths_[state_idx] = 0;
+  InvalidateEncodings(state_idx);
+  for (int player_idx = 0; player_idx < game_.NumPlayers(); ++player_idx) {
+    const int agent_id =
+      (current_agent_id + player_idx) % game_.NumPlayers();
+    const int corresponding_player_id =
+      (state.CurPlayer() + player_idx) % game_.NumPlayers();
+    agent_player_mapping_[agent_id][state_idx] = corresponding_player_id;
+  }
+  REQUIRE(!state.IsTerminal());
+}
+
+void hanabi_learning_env::HanabiParallelEnv::ApplyStateMove(
+    const int state_idx, const HanabiMove& move) {
+  auto& state = parallel_states_[state_idx];
+  state.ApplyMove(move);
+  ++episode_lengths_[state_idx];
+}
+
 void hanabi_learning_env::HanabiParallelEnv::ApplyBatchMove(
     const std::vector<HanabiMove>& batch_move, const int agent_id) {
   const auto& player_ids = agent_player_mapping_[agent_id];
   #pragma omp parallel for
-  for (size_t state_idx = 0; state_idx < parallel_states_.size(); ++state_idx) {
-    const int cur_player = player_ids[state_idx];
-    auto& state = parallel_states_[state_idx];
-    REQUIRE(cur_player == state.CurPlayer());
-    const auto& move = batch_move[state_idx];
-    state.ApplyMove(move);
-    int next_player = state.CurPlayer();
-    while (next_player == kChancePlayerId) {
-      state.ApplyRandomChance();
-      next_player = state.CurPlayer();
+  for (int state_idx = 0; state_idx < n_states_; ++state_idx) {
+    REQUIRE(player_ids[state_idx] == parallel_states_[state_idx].CurPlayer());
+    ApplyStateMove(state_idx, batch_move[state_idx]);
+  }
+}
+
+void hanabi_learning_env::HanabiParallelEnv::StepAndObserve(
+    const int* move_uids, const int agent_id, const bool packed,
+    const HanabiBatchObservationBuffers& buffers,
+    const HanabiStepResultBuffers& results) {
+  REQUIRE(move_uids != nullptr);
+  REQUIRE(buffers.observation != nullptr);
+  REQUIRE(buffers.legal_moves != nullptr);
+  REQUIRE(buffers.scores != nullptr);
+  REQUIRE(buffers.done != nullptr);
+  REQUIRE(results.rewards != nullptr);
+  REQUIRE(results.final_scores != nullptr);
+  REQUIRE(results.episode_lengths != nullptr);
+  const int next_agent_id = (agent_id + 1) % game_.NumPlayers();
+  const int row_len =
+      packed ? GetPackedObservationLength() : GetObservationFlatLength();
+  const auto& player_ids = agent_player_mapping_[agent_id];
+  const auto& next_player_ids = agent_player_mapping_[next_agent_id];
+  #pragma omp parallel for schedule(static)
+  for (int state_idx = 0; state_idx < n_states_; ++state_idx) {
+    const auto& state = parallel_states_[state_idx];
+    REQUIRE(player_ids[state_idx] == state.CurPlayer());
+    const int score_before = state.Score();
+    ApplyStateMove(state_idx, game_.GetMove(move_uids[state_idx]));
+    results.rewards[state_idx] = state.Score() - score_before;
+    const bool done = state.IsTerminal();
+    if (done) {
+      results.final_scores[state_idx] = state.Score();
+      results.episode_lengths[state_idx] = episode_lengths_[state_idx];
+      ResetState(state_idx, next_agent_id);
+    } else {
+      results.final_scores[state_idx] = 0;
+      results.episode_lengths[state_idx] = 0;
     }
+    EncodeState(state_idx, next_player_ids[state_idx], packed,
+                buffers.observation + state_idx * row_len);
+    WriteStateStatus(state_idx, next_player_ids[state_idx], buffers);
+    buffers.done[state_idx] = done;
   }
 }
 
@@ -139,8 +185,8 @@ hanabi_learning_env::HanabiParallelEnv::ObserveAgent(const int agent_id) {
   for (size_t state_idx = 0; state_idx < parallel_states_.size(); ++state_idx) {
     const int player_idx = player_ids[state_idx];
     const auto& state = parallel_states_[state_idx];
-    const HanabiObservation observation(state, player_idx);
-    const auto encoded_observation = observation_encoder_.Encode(observation);
+    const auto encoded_observation =
+        observation_encoder_.Encode(HanabiObservationView(state, player_idx));
     auto vec_observ_iter = batch_observation.observation.begin() +
         state_idx * encoded_observation.size();
     vec_observ_iter = std::copy(encoded_observation.begin(),
@@ -157,3 +203,125 @@ hanabi_learning_env::HanabiParallelEnv::ObserveAgent(const int agent_id) {
   }
   return batch_observation;
 }
+
+void hanabi_learning_env::HanabiParallelEnv::ObserveAgent(
+    const int agent_id, const HanabiBatchObservationBuffers& buffers) const {
+  REQUIRE(buffers.observation != nullptr);
+  REQUIRE(buffers.legal_moves != nullptr);
+  REQUIRE(buffers.scores != nullptr);
+  REQUIRE(buffers.done != nullptr);
+  const int observation_len = GetObservationFlatLength();
+  const auto& player_ids = agent_player_mapping_[agent_id];
+  // Static schedule: every thread writes one contiguous block of rows.
+  #pragma omp parallel for schedule(static)
+  for (int state_idx = 0; state_idx < n_states_; ++state_idx) {
+    EncodeState(state_idx, player_ids[state_idx], false,
+                buffers.observation + state_idx * observation_len);
+    WriteStateStatus(state_idx, player_ids[state_idx], buffers);
+  }
+}
+
+void hanabi_learning_env::HanabiParallelEnv::ObserveAgentPacked(
+    const int agent_id, const HanabiBatchObservationBuffers& buffers) const {
+  REQUIRE(buffers.observation != nullptr);
+  REQUIRE(buffers.legal_moves != nullptr);
+  REQUIRE(buffers.scores != nullptr);
+  REQUIRE(buffers.done != nullptr);
+  const int packed_len = GetPackedObservationLength();
+  const auto& player_ids = agent_player_mapping_[agent_id];
+  #pragma omp parallel for schedule(static)
+  for (int state_idx = 0; state_idx < n_states_; ++state_idx) {
+    EncodeState(state_idx, player_ids[state_idx], true,
+                buffers.observation + state_idx * packed_len);
+    WriteStateStatus(state_idx, player_ids[state_idx], buffers);
+  }
+}
+
+void hanabi_learning_env::HanabiParallelEnv::EncodeState(
+    const int state_idx, const int player_idx, const bool packed,
+    int8_t* row) const {
+  const auto& state = parallel_states_[state_idx];
+  if (IncrementalEncoding()) {
+    const auto& encoding =
+        incremental_encoders_[state_idx * game_.NumPlayers() + player_idx]
+            .Update(state, player_idx);
+    if (packed) {
+      PackBits(encoding.data(), encoding.size(),
+               reinterpret_cast<uint8_t*>(row));
+    } else {
+      std::copy(encoding.begin(), encoding.end(), row);
+    }
+  } else if (packed) {
+    observation_encoder_.EncodePacked(HanabiObservationView(state, player_idx),
+                                      reinterpret_cast<uint8_t*>(row));
+  } else {
+    observation_encoder_.Encode(HanabiObservationView(state, player_idx), row);
+  }
+}
+
+void hanabi_learning_env::HanabiParallelEnv::WriteStateStatus(
+    const int state_idx, const int player_idx,
+    const HanabiBatchObservationBuffers& buffers) const {
+  const int max_moves = MaxMoves();
+  const auto& state = parallel_states_[state_idx];
+  int8_t* legal_moves = buffers.legal_moves + state_idx * max_moves;
+  const uint64_t legal_moves_mask = state.LegalMovesMask(player_idx);
+  for (int uid = 0; uid < max_moves; ++uid) {
+    legal_moves[uid] = (legal_moves_mask >> uid) & 1;
+  }
+  buffers.scores[state_idx] = state.Score();
+  buffers.done[state_idx] = state.IsTerminal();
+  if (buffers.beliefs != nullptr) {
+    WriteStateBeliefs(state_idx, player_idx,
+                      buffers.beliefs + state_idx * GetBeliefLength());
+  }
+}
+
+void hanabi_learning_env::HanabiParallelEnv::WriteStateBeliefs(
+    const int state_idx, const int player_idx, float* row) const {
+  belief_trackers_[state_idx * game_.NumPlayers() + player_idx].Beliefs(
+      parallel_states_[state_idx], player_idx, row);
+}
+
+void hanabi_learning_env::HanabiParallelEnv::GetBeliefs(
+    const int agent_id, float* beliefs) const {
+  const int belief_len = GetBeliefLength();
+  const auto& player_ids = agent_player_mapping_[agent_id];
+  #pragma omp parallel for schedule(static)
+  for (int state_idx = 0; state_idx < n_states_; ++state_idx) {
+    WriteStateBeliefs(state_idx, player_ids[state_idx],
+                      beliefs + state_idx * belief_len);
+  }
+}
+
+void hanabi_learning_env::HanabiParallelEnv::GetLegalMovesMasks(
+    const int agent_id, uint64_t* masks) const {
+  const auto& player_ids = agent_player_mapping_[agent_id];
+  #pragma omp parallel for schedule(static)
+  for (int state_idx = 0; state_idx < n_states_; ++state_idx) {
+    masks[state_idx] =
+        parallel_states_[state_idx].LegalMovesMask(player_ids[state_idx]);
+  }
+}
+
+void hanabi_learning_env::HanabiParallelEnv::SetIncrementalEncoding(
+    const bool enable) {
+  incremental_encoders_.clear();
+  if (enable) {
+    incremental_encoders_.assign(n_states_ * game_.NumPlayers(),
+                                 IncrementalCanonicalEncoder(&game_));
+  }
+}
+
+void hanabi_learning_env::HanabiParallelEnv::InvalidateEncodings(
+    const int state_idx) {
+  for (int player_idx = 0; player_idx < game_.NumPlayers(); ++player_idx) {
+    belief_trackers_[state_idx * game_.NumPlayers() + player_idx].Invalidate();
+  }
+  if (IncrementalEncoding()) {
+    for (int player_idx = 0; player_idx < game_.NumPlayers(); ++player_idx) {
+      incremental_encoders_[state_idx * game_.NumPlayers() + player_idx]
+          .Invalidate();
+    }
+  }
+}
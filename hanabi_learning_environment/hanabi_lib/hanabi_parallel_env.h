@@ -16,6 +16,8 @@
 #define __HANABI_PARALLEL_ENV_H__
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
 #include <random>
 #include <string>
 #include <unordered_map>
@@ -27,6 +29,7 @@
 #include "hanabi_state.h"
 #include "hanabi_observation.h"
 #include "canonical_encoders.h"
+#include "hanabi_belief.h"
 
 #include <iostream>
 
@@ -57,19 +60,52 @@ class HanabiParallelEnv {
     std::vector<int> observation; //< Concatenated flat encoded observations.
     std::vector<int> legal_moves; //< Concatenated legal moves.
     std::vector<int> scores;      //< Concatenated scores.
-    std::vector<bool> done;       //< Concatenated termination statuses.
+    std::vector<int8_t> done;     //< Concatenated termination statuses.
     std::array<int, 2> observation_shape{0, 0}; //< Shape of batched observation (n_states x encoded_observation_length).
     std::array<int, 2> legal_moves_shape{0, 0}; //< Shape of legal moves (n_states x max_moves).
   };
 
+  /** \brief Caller-owned output buffers for batched observations.
+   *
+   *  Every buffer holds one row per state, rows are contiguous:
+   *  observation is n_states x observation length, legal_moves is
+   *  n_states x max_moves, scores and done are n_states. The buffers are
+   *  written in place, so they should be aligned to cache lines to keep the
+   *  threads that write neighbouring rows from sharing lines.
+   *
+   *  beliefs is optional: if set, it is n_states x GetBeliefLength() and
+   *  receives the card beliefs of the observer, see GetBeliefs, as an extra
+   *  float section of the observation.
+   */
+  struct HanabiBatchObservationBuffers {
+    int8_t* observation = nullptr;  //< Flat encoded observations.
+    int8_t* legal_moves = nullptr;  //< One-hot legal moves.
+    int16_t* scores = nullptr;      //< Scores.
+    int8_t* done = nullptr;         //< Termination statuses.
+    float* beliefs = nullptr;       //< Card beliefs, if not null.
+  };
+
+  /** \brief Caller-owned per-state outputs of StepAndObserve.
+   *
+   *  Every buffer holds n_states entries.
+   */
+  struct HanabiStepResultBuffers {
+    int16_t* rewards = nullptr;          //< Change of score caused by the step.
+    int16_t* final_scores = nullptr;     //< Score of an episode which ended in this step, 0 otherwise.
+    int16_t* episode_lengths = nullptr;  //< Number of moves of an episode which ended in this step, 0 otherwise.
+  };
+
   /** \brief Construct and environment with a single game with several parallel states.
    *
    *  \param game_params Parameters of the game. See HanabiGame.
    *  \param n_states Number of parallel states.
+   *  \param first_stream Random stream of the first state. State i draws its
+   *         deals from stream first_stream + i, so environments with the same
+   *         seed and disjoint stream ranges deal independent games.
    */
   explicit HanabiParallelEnv(
       const std::unordered_map<std::string, std::string>& game_params,
-      const int n_states);
+      const int n_states, const int first_stream = 0);
 
   /** \brief Make a step: apply moves to states.
    *
@@ -83,10 +119,86 @@ class HanabiParallelEnv {
   void ApplyBatchMove(
       const std::vector<int>& batch_move, const int agent_id);
 
+  /** \brief Make a step and observe the result, in a single pass.
+   *
+   *  Fuses ApplyBatchMove, ResetStates and ObserveAgent: every state is
+   *  stepped, rewarded, reset if it became terminal and encoded for the next
+   *  agent by the same thread, in a single parallel region. States that ended
+   *  are replaced by new ones with the next agent to move, their done flag is
+   *  set and their final score and length are reported in results; all other
+   *  output rows describe the new state.
+   *
+   *  \param move_uids Uids of the moves, one for each state.
+   *  \param agent_id  Id of the agent making the moves. The observations
+   *                   are made by agent (agent_id + 1) % NumPlayers.
+   *  \param packed    Whether to write bit-packed observations, see
+   *                   ObserveAgentPacked.
+   */
+  void StepAndObserve(const int* move_uids, const int agent_id,
+                      const bool packed,
+                      const HanabiBatchObservationBuffers& buffers,
+                      const HanabiStepResultBuffers& results);
+
   /** \brief Get observations for a specific agent.
    */
   HanabiEncodedBatchObservation ObserveAgent(const int agent_id);
 
+  /** \overload writing the observations straight into caller-owned buffers.
+   *
+   *  Nothing is allocated and every state's row is written exactly once, by
+   *  the thread which encodes that state.
+   */
+  void ObserveAgent(const int agent_id,
+                    const HanabiBatchObservationBuffers& buffers) const;
+
+  /** \brief Like ObserveAgent, but with bit-packed encoded observations.
+   *
+   *  Each row of buffers.observation holds GetPackedObservationLength()
+   *  bytes, the observation packed 8 bits per byte in little-endian bit
+   *  order (see CanonicalObservationEncoder::EncodePacked).
+   */
+  void ObserveAgentPacked(const int agent_id,
+                          const HanabiBatchObservationBuffers& buffers) const;
+
+  /** \brief Get the legal moves of an agent in every state as bitmasks.
+   *
+   *  Bit uid of masks[state_idx] is set iff the move with that uid is legal
+   *  in state state_idx, see HanabiState::LegalMovesMask.
+   *
+   *  \param masks Caller-owned buffer of n_states entries.
+   */
+  void GetLegalMovesMasks(const int agent_id, uint64_t* masks) const;
+
+  /** \brief Get the card beliefs of an agent in every state.
+   *
+   *  For every card in the agent's hand, the probability of each color and
+   *  rank given its card knowledge and the cards the agent has not seen (see
+   *  EncodeHandBeliefs). The unseen card counts are kept per state and player
+   *  and only updated with the cards revealed since the previous call.
+   *
+   *  \param beliefs Caller-owned buffer of n_states x GetBeliefLength()
+   *         floats.
+   */
+  void GetBeliefs(const int agent_id, float* beliefs) const;
+
+  /** \brief Number of floats of the card beliefs of one state.
+   */
+  int GetBeliefLength() const {return BeliefLength(game_);}
+
+  /** \brief Switch incremental observation encoding on or off.
+   *
+   *  When on, the environment keeps the last encoded observation of every
+   *  player in every state and ObserveAgent only patches the bits changed by
+   *  the moves applied since (see IncrementalCanonicalEncoder), instead of
+   *  re-encoding whole observations. Costs n_states x n_players x observation
+   *  length bytes of memory.
+   */
+  void SetIncrementalEncoding(const bool enable);
+
+  /** \brief Whether observations are encoded incrementally.
+   */
+  bool IncrementalEncoding() const {return !incremental_encoders_.empty();}
+
   /** \brief Get a reference to the HanabiGame game.
    */
   const HanabiGame& GetGame() const {return game_;}
@@ -113,6 +225,12 @@ class HanabiParallelEnv {
    */
   int GetObservationFlatLength() const;
 
+  /** \brief Number of bytes of a single bit-packed encoded observation.
+   */
+  int GetPackedObservationLength() const {
+    return observation_encoder_.PackedLength();
+  }
+
   /** \brief Number of parallel states in this environment.
    */
   int GetNumStates() const {return n_states_;};
@@ -133,17 +251,65 @@ class HanabiParallelEnv {
   void Reset();
 
  private:
-  /** \brief Create a new state and deal the cards.
+  /** \brief Create a new state for a slot and deal the cards.
    *
+   *  Every new state gets its own random stream, derived from the game seed,
+   *  the stream of the slot and the number of episodes played in that slot
+   *  so far.
+   *  Dealing is thus lock-free and the deals do not depend on the number of
+   *  threads or on the order in which the states are processed.
+   *
+   *  \param state_idx Index of the slot the state is created for.
    *  \return New HanabiState with cards dealt to players.
    */
-  HanabiState NewState();
+  HanabiState NewState(const int state_idx);
+
+  /** \brief Replace the state in a slot with a new one.
+   *
+   *  \param current_agent_id Id of the agent to move in the new state.
+   */
+  void ResetState(const int state_idx, const int current_agent_id);
+
+  /** \brief Apply a move of the current player and the chance moves which
+   *  follow it.
+   */
+  void ApplyStateMove(const int state_idx, const HanabiMove& move);
+
+  /** \brief Encode the observation of a state by a player into a row.
+   *
+   *  \param packed Whether to write a bit-packed row.
+   */
+  void EncodeState(const int state_idx, const int player_idx,
+                   const bool packed, int8_t* row) const;
+
+  /** \brief Write legal moves, score and termination status of a state into
+   *  its rows of the output buffers.
+   */
+  void WriteStateStatus(const int state_idx, const int player_idx,
+                        const HanabiBatchObservationBuffers& buffers) const;
+
+  /** \brief Write the card beliefs of a state by a player into a row.
+   */
+  void WriteStateBeliefs(const int state_idx, const int player_idx,
+                         float* row) const;
+
+  /** \brief Forget the cached incremental encodings and belief counts of a
+   *  state.
+   */
+  void InvalidateEncodings(const int state_idx);
 
   HanabiGame game_;                                     //< Underlying instance of HanabiGame.
   std::vector<HanabiState> parallel_states_;            //< List with game states.
   std::vector<std::vector<int>> agent_player_mapping_;  //< List of players associated with each agent.
   CanonicalObservationEncoder observation_encoder_;     //< Observation encoder.
   const int n_states_ = 1;                              //< Number of parallel states.
+  const int first_stream_ = 0;                          //< Random stream of the first state.
+  std::vector<uint64_t> episode_counters_;              //< Number of episodes started in each slot.
+  std::vector<int> episode_lengths_;                    //< Number of moves made in the current episode of each slot.
+  mutable std::vector<IncrementalCanonicalEncoder>
+      incremental_encoders_;                            //< Per state and player encoders, if incremental.
+  mutable std::vector<HanabiBeliefTracker>
+      belief_trackers_;                                 //< Per state and player unseen card counts.
 };
 
 }  // namespace hanabi_learning_env
@@ -0,0 +1,228 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hanabi_rollout.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+namespace {
+
+// Random streams of a game: one for the deals, one for the policies.
+constexpr uint64_t kDealStream = 0;
+constexpr uint64_t kPolicyStream = 1;
+
+// Plays the game of deal_seed to the end and returns its final state, which
+// records its move history only if record_history.
+HanabiState PlayGame(const HanabiGame& game,
+                     const std::vector<const HanabiPolicy*>& policies,
+                     uint64_t deal_seed, CounterRng policy_rng,
+                     bool record_history) {
+  HanabiState state = NewSeededState(game, deal_seed);
+  if (!record_history) {
+    state.SetHistoryMode(HanabiState::kNoHistory);
+  }
+  while (!state.IsTerminal()) {
+    if (state.CurPlayer() == kChancePlayerId) {
+      state.ApplyRandomChance();
+      continue;
+    }
+    const HanabiPolicy* policy =
+        policies.size() == 1 ? policies[0] : policies[state.CurPlayer()];
+    state.ApplyMove(policy->Act(state, &policy_rng));
+  }
+  return state;
+}
+
+HanabiTrajectory MakeTrajectory(const HanabiState& state) {
+  const HanabiGame& game = *state.ParentGame();
+  HanabiTrajectory trajectory;
+  trajectory.score = state.Score();
+  for (const HanabiHistoryItem& item : state.MoveHistory()) {
+    if (item.move.MoveType() == HanabiMove::kDeal) {
+      trajectory.deals.push_back(game.GetChanceOutcomeUid(item.move));
+    } else {
+      if (trajectory.start_player < 0) {
+        trajectory.start_player = item.player;
+      }
+      trajectory.moves.push_back(game.GetMoveUid(item.move));
+    }
+  }
+  return trajectory;
+}
+
+}  // namespace
+
+HanabiState NewSeededState(const HanabiGame& game, uint64_t deal_seed) {
+  CounterRng rng(deal_seed);
+  HanabiState state(&game, game.GetSampledStartPlayer(&rng));
+  state.SetRandomStream(rng);
+  return state;
+}
+
+HanabiMove RandomPolicy::Act(const HanabiState& state, CounterRng* rng) const {
+  uint64_t mask = state.LegalMovesMask(state.CurPlayer());
+  REQUIRE(mask != 0);
+  // Drop the lowest set bits until the chosen one is the lowest.
+  for (uint32_t skip = rng->Below(PopCount(mask)); skip > 0; --skip) {
+    mask &= mask - 1;
+  }
+  return state.ParentGame()->GetMove(LowestSetBit(mask));
+}
+
+HanabiMove SimplePolicy::Act(const HanabiState& state,
+                             CounterRng* /*rng*/) const {
+  const HanabiGame& game = *state.ParentGame();
+  const int num_players = game.NumPlayers();
+  const int cur_player = state.CurPlayer();
+  const auto& knowledge = state.Hands()[cur_player].Knowledge();
+
+  // Play a card we received a hint about.
+  for (int card_index = 0; card_index < knowledge.size(); ++card_index) {
+    if (knowledge[card_index].ColorHinted() ||
+        knowledge[card_index].RankHinted()) {
+      return HanabiMove(HanabiMove::kPlay, card_index, -1, -1, -1);
+    }
+  }
+
+  // Hint the color of a playable card which the holder does not know yet.
+  if (state.InformationTokens() > 0) {
+    const auto& fireworks = state.Fireworks();
+    for (int offset = 1; offset < num_players; ++offset) {
+      const HanabiHand& hand =
+          state.Hands()[(cur_player + offset) % num_players];
+      for (int card_index = 0; card_index < hand.Cards().size(); ++card_index) {
+        const HanabiCard& card = hand.Cards()[card_index];
+        if (card.Rank() == fireworks[card.Color()] &&
+            !hand.Knowledge()[card_index].ColorHinted()) {
+          return HanabiMove(HanabiMove::kRevealColor, -1, offset, card.Color(),
+                            -1);
+        }
+      }
+    }
+  }
+
+  if (state.InformationTokens() < game.MaxInformationTokens()) {
+    return HanabiMove(HanabiMove::kDiscard, 0, -1, -1, -1);
+  }
+  return HanabiMove(HanabiMove::kPlay, 0, -1, -1, -1);
+}
+
+std::unique_ptr<HanabiPolicy> MakePolicy(const std::string& name) {
+  if (name == "random") {
+    return std::unique_ptr<HanabiPolicy>(new RandomPolicy());
+  } else if (name == "simple") {
+    return std::unique_ptr<HanabiPolicy>(new SimplePolicy());
+  }
+  return nullptr;
+}
+
+HanabiRolloutResult RunRollouts(
+    const HanabiGame& game, const std::vector<const HanabiPolicy*>& policies,
+    int64_t num_games, bool record_trajectories, int64_t first_game) {
+  REQUIRE(policies.size() == 1 || policies.size() == game.NumPlayers());
+  REQUIRE(num_games >= 0);
+  HanabiRolloutResult result;
+  result.num_games = num_games;
+  result.score_histogram.assign(game.MaxScore() + 1, 0);
+  if (record_trajectories) {
+    result.trajectories.resize(num_games);
+  }
+
+  #pragma omp parallel
+  {
+    std::vector<int64_t> score_histogram(game.MaxScore() + 1, 0);
+    int64_t num_moves = 0;
+    // Games differ a lot in length, hence the dynamic schedule.
+    #pragma omp for schedule(dynamic, 64) nowait
+    for (int64_t game_idx = 0; game_idx < num_games; ++game_idx) {
+      const uint64_t seed = static_cast<uint64_t>(game.Seed());
+      const CounterRng deal_rng(seed, first_game + game_idx, kDealStream);
+      const HanabiState state = PlayGame(
+          game, policies, deal_rng.Key(),
+          CounterRng(seed, first_game + game_idx, kPolicyStream),
+          record_trajectories);
+      ++score_histogram[state.Score()];
+      // Every card which left the deck was dealt by a chance move.
+      num_moves +=
+          state.NumMoves() - (game.MaxDeckSize() - state.Deck().Size());
+      if (record_trajectories) {
+        result.trajectories[game_idx] = MakeTrajectory(state);
+      }
+    }
+    #pragma omp critical
+    {
+      for (int score = 0; score < score_histogram.size(); ++score) {
+        result.score_histogram[score] += score_histogram[score];
+      }
+      result.num_moves += num_moves;
+    }
+  }
+  return result;
+}
+
+HanabiEvaluationResult EvaluatePolicies(
+    const HanabiGame& game, const std::vector<const HanabiPolicy*>& policies,
+    const std::vector<uint64_t>& deal_seeds) {
+  REQUIRE(!policies.empty());
+  const int num_policies = policies.size();
+  const int64_t num_games = deal_seeds.size();
+  HanabiEvaluationResult result;
+  result.scores.assign(num_policies, std::vector<int>(num_games, 0));
+
+  // Games differ a lot in length, hence the dynamic schedule.
+  #pragma omp parallel for schedule(dynamic, 16)
+  for (int64_t run = 0; run < num_policies * num_games; ++run) {
+    const int policy = run % num_policies;
+    const int64_t game_idx = run / num_policies;
+    const uint64_t deal_seed = deal_seeds[game_idx];
+    result.scores[policy][game_idx] =
+        PlayGame(game, {policies[policy]}, deal_seed,
+                 CounterRng(deal_seed, kPolicyStream, 0), false)
+            .Score();
+  }
+
+  for (int policy = 0; policy < num_policies; ++policy) {
+    double score_sum = 0;
+    double difference_sum = 0;
+    double difference_square_sum = 0;
+    for (int64_t game_idx = 0; game_idx < num_games; ++game_idx) {
+      const int score = result.scores[policy][game_idx];
+      const double difference = score - result.scores[0][game_idx];
+      score_sum += score;
+      difference_sum += difference;
+      difference_square_sum += difference * difference;
+    }
+    const double mean_difference =
+        num_games > 0 ? difference_sum / num_games : 0;
+    double std_error = 0;
+    if (num_games > 1) {
+      const double variance =
+          (difference_square_sum - num_games * mean_difference *
+                                       mean_difference) /
+          (num_games - 1);
+      std_error = std::sqrt(std::max(variance, 0.0) / num_games);
+    }
+    result.mean_scores.push_back(num_games > 0 ? score_sum / num_games : 0);
+    result.mean_differences.push_back(mean_difference);
+    result.difference_std_errors.push_back(std_error);
+  }
+  return result;
+}
+
+}  // namespace hanabi_learning_env
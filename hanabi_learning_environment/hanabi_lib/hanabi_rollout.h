@@ -0,0 +1,129 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Native policies and a multi-threaded engine playing many games with them,
+// for measuring simulator throughput and generating baseline self-play data
+// without leaving C++.
+
+#ifndef __HANABI_ROLLOUT_H__
+#define __HANABI_ROLLOUT_H__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "counter_rng.h"
+#include "hanabi_game.h"
+#include "hanabi_move.h"
+#include "hanabi_state.h"
+
+namespace hanabi_learning_env {
+
+// Chooses the move of the current player of a state. Policies only look at
+// what the current player can observe: the other hands, the card knowledge
+// and the public state. Act is const and is called concurrently from many
+// threads, so a policy must not keep mutable state.
+class HanabiPolicy {
+ public:
+  virtual ~HanabiPolicy() = default;
+  // state must not be terminal nor at a chance node. Randomness must only
+  // come from rng, so games are reproducible.
+  virtual HanabiMove Act(const HanabiState& state, CounterRng* rng) const = 0;
+};
+
+// Plays a uniformly random legal move.
+class RandomPolicy : public HanabiPolicy {
+ public:
+  HanabiMove Act(const HanabiState& state, CounterRng* rng) const override;
+};
+
+// Port of agents/simple_agent.py: plays a card which was hinted, else hints
+// the color of a playable card with unknown color, else discards the oldest
+// card, or plays it if the information tokens are full.
+class SimplePolicy : public HanabiPolicy {
+ public:
+  HanabiMove Act(const HanabiState& state, CounterRng* rng) const override;
+};
+
+// Returns the built-in policy with the given name ("random" or "simple"), or
+// nullptr for an unknown name.
+std::unique_ptr<HanabiPolicy> MakePolicy(const std::string& name);
+
+// Start of the game with deal seed deal_seed, whose start player (if the
+// game draws it) and deck order are fixed up front: both are drawn from the
+// state's own random stream CounterRng(deal_seed). Cards only leave the deck
+// by being dealt, so the k-th card dealt only depends on deal_seed, and the
+// game on deal_seed and the moves made. Games of the same deal seed deal
+// the same cards whatever the moves, as long as no cards are put back
+// (ReplaceHandCards, SampleDeterminization). The shared generator of the
+// game is not used.
+HanabiState NewSeededState(const HanabiGame& game, uint64_t deal_seed);
+
+// Record of a game, enough to replay it: start from
+// HanabiState(&game, start_player), apply deals[i] (chance outcome uids) in
+// order whenever the current player is the chance player, and moves[i]
+// (move uids) in order otherwise.
+struct HanabiTrajectory {
+  int start_player = -1;
+  int score = 0;
+  std::vector<int> moves;
+  std::vector<int> deals;
+};
+
+struct HanabiRolloutResult {
+  int64_t num_games = 0;
+  // Number of moves made by players (chance moves excluded).
+  int64_t num_moves = 0;
+  // score_histogram[s] is the number of games which ended with score s,
+  // s = 0 ... game.MaxScore().
+  std::vector<int64_t> score_histogram;
+  // One per game, in game order, if requested.
+  std::vector<HanabiTrajectory> trajectories;
+};
+
+// Plays num_games games using all OpenMP threads. policies holds either one
+// policy used by every player, or one policy per player. Game i (counting
+// from first_game) deals and samples its moves from random streams derived
+// from the game seed and i only, so the result does not depend on the
+// number of threads, and disjoint game ranges give independent games.
+HanabiRolloutResult RunRollouts(
+    const HanabiGame& game, const std::vector<const HanabiPolicy*>& policies,
+    int64_t num_games, bool record_trajectories = false,
+    int64_t first_game = 0);
+
+struct HanabiEvaluationResult {
+  // scores[p][i] is the score of policies[p] in the game of deal_seeds[i].
+  std::vector<std::vector<int>> scores;
+  std::vector<double> mean_scores;
+  // Mean and standard error of the paired differences
+  // scores[p][i] - scores[0][i], against the first policy (0 for it).
+  std::vector<double> mean_differences;
+  std::vector<double> difference_std_errors;
+};
+
+// Plays the game of every deal seed (see NewSeededState) with every policy,
+// played by all players, using all OpenMP threads. The policies of a game
+// also draw from the same random stream, derived from its deal seed: the
+// policies only differ by their moves (common random numbers). Comparing
+// policies game by game cancels the luck of the deal, which makes the
+// standard error of a difference much smaller than that of two independent
+// evaluations of the same size.
+HanabiEvaluationResult EvaluatePolicies(
+    const HanabiGame& game, const std::vector<const HanabiPolicy*>& policies,
+    const std::vector<uint64_t>& deal_seeds);
+
+}  // namespace hanabi_learning_env
+
+#endif
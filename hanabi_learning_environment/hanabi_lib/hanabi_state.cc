@@ -48,17 +48,63 @@ uint8_t HandRankBitmask(const HanabiHand& hand, int rank) {
   }
   return mask;
 }
+
+// Zobrist keys. Every value of a feature of a position has a pseudo-random
+// key, and the hash of a position is the XOR of the keys of its values.
+// Keys are a bijective mix of (feature, value), so no two values share a key
+// and no table has to be sized for the largest game.
+enum ZobristFeature {
+  kSlotFeature = 1,  // Card and card knowledge of a hand slot.
+  kDeckFeature,
+  kDiscardFeature,
+  kFireworkFeature,
+  kCountersFeature,
+  kColorFeature  // Values involving a color, without the color.
+};
+
+inline uint64_t ZobristKey(ZobristFeature feature, uint64_t value) {
+  // Odd multiplication then SplitMix64's finalizer, both bijective.
+  uint64_t z = ((static_cast<uint64_t>(feature) << 56) | value) *
+               0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// Key of a hand slot holding card index color * NumRanks() + rank, with the
+// plausible cards and hinted color and rank of its card knowledge.
+inline uint64_t SlotKey(int player, int slot, int card_index,
+                        uint32_t plausible, int hinted_color,
+                        int hinted_rank) {
+  // Plausible cards in bits 0-24, hints in 25-30, card in 31-35, slot in
+  // 36-43 and player above.
+  return ZobristKey(kSlotFeature,
+                    plausible | static_cast<uint64_t>(hinted_rank + 1) << 25 |
+                        static_cast<uint64_t>(hinted_color + 1) << 28 |
+                        static_cast<uint64_t>(card_index) << 31 |
+                        static_cast<uint64_t>(slot) << 36 |
+                        static_cast<uint64_t>(player) << 44);
+}
+
+// Key of the number of copies of card index color * NumRanks() + rank in the
+// deck.
+uint64_t DeckCountKey(int card_index, int count) {
+  return ZobristKey(kDeckFeature,
+                    (static_cast<uint64_t>(card_index) << 8) | count);
+}
+
+const int kIdentityColorMap[kMaxNumColors] = {0, 1, 2, 3, 4};
 }  // namespace
 
 HanabiState::HanabiDeck::HanabiDeck(const HanabiGame& game)
     : card_count_(game.NumColors() * game.NumRanks(), 0),
       total_count_(0),
       num_ranks_(game.NumRanks()) {
+  REQUIRE(card_count_.size() <= kTreeSize);
   for (int color = 0; color < game.NumColors(); ++color) {
     for (int rank = 0; rank < game.NumRanks(); ++rank) {
-      auto count = game.NumberCardInstances(color, rank);
-      card_count_[CardToIndex(color, rank)] = count;
-      total_count_ += count;
+      AddCount(CardToIndex(color, rank),
+               game.NumberCardInstances(color, rank));
     }
   }
 }
@@ -67,13 +113,11 @@ HanabiCard HanabiState::HanabiDeck::DealCard(std::mt19937* rng) {
   if (Empty()) {
     return HanabiCard();
   }
-  std::discrete_distribution<std::mt19937::result_type> dist(
-      card_count_.begin(), card_count_.end());
-  int index = dist(*rng);
-  assert(card_count_[index] > 0);
-  --card_count_[index];
-  --total_count_;
-  return HanabiCard(IndexToColor(index), IndexToRank(index));
+  std::uniform_int_distribution<std::mt19937::result_type> dist(
+      0, total_count_ - 1);
+  const HanabiCard card = CardAt(dist(*rng));
+  AddCount(CardToIndex(card.Color(), card.Rank()), -1);
+  return card;
 }
 
 HanabiCard HanabiState::HanabiDeck::DealCard(int color, int rank) {
@@ -82,15 +126,41 @@ HanabiCard HanabiState::HanabiDeck::DealCard(int color, int rank) {
     return HanabiCard();
   }
   assert(card_count_[index] > 0);
-  --card_count_[index];
-  --total_count_;
+  AddCount(index, -1);
   return HanabiCard(IndexToColor(index), IndexToRank(index));
 }
 
+void HanabiState::HanabiDeck::ReturnCard(int color, int rank) {
+  AddCount(CardToIndex(color, rank), 1);
+}
+
+HanabiCard HanabiState::HanabiDeck::CardAt(int position) const {
+  assert(position >= 0 && position < total_count_);
+  // Descend the tree: index is the number of card indices whose counts sum
+  // to at most position.
+  int index = 0;
+  for (int step = kTreeSize / 2; step > 0; step >>= 1) {
+    if (count_tree_[index + step - 1] <= position) {
+      index += step;
+      position -= count_tree_[index - 1];
+    }
+  }
+  return HanabiCard(IndexToColor(index), IndexToRank(index));
+}
+
+void HanabiState::HanabiDeck::AddCount(int index, int delta) {
+  card_count_[index] += delta;
+  total_count_ += delta;
+  for (int i = index + 1; i <= kTreeSize; i += i & -i) {
+    count_tree_[i - 1] += delta;
+  }
+}
+
 HanabiState::HanabiState(const HanabiGame* parent_game, int start_player)
     : parent_game_(parent_game),
       deck_(*parent_game),
       hands_(parent_game->NumPlayers()),
+      last_move_index_(parent_game->NumPlayers(), -1),
       cur_player_(kChancePlayerId),
       next_non_chance_player_(start_player >= 0 &&
                                       start_player < parent_game->NumPlayers()
@@ -99,7 +169,9 @@ HanabiState::HanabiState(const HanabiGame* parent_game, int start_player)
       information_tokens_(parent_game->MaxInformationTokens()),
       life_tokens_(parent_game->MaxLifeTokens()),
       fireworks_(parent_game->NumColors(), 0),
-      turns_to_play_(parent_game->NumPlayers()) {}
+      turns_to_play_(parent_game->NumPlayers()) {
+  ComputeAggregates();
+}
 
 void HanabiState::AdvanceToNextPlayer() {
   if (!deck_.Empty() && PlayerToDeal() >= 0) {
@@ -154,13 +226,51 @@ bool HanabiState::HintingIsLegal(HanabiMove move) const {
   return true;
 }
 
-int HanabiState::PlayerToDeal() const {
-  for (int i = 0; i < hands_.size(); ++i) {
-    if (hands_[i].Cards().size() < ParentGame()->HandSize()) {
-      return i;
+void HanabiState::ComputeAggregates() {
+  const int num_ranks = ParentGame()->NumRanks();
+  fireworks_total_ = 0;
+  playable_mask_ = 0;
+  for (int color = 0; color < ParentGame()->NumColors(); ++color) {
+    fireworks_total_ += fireworks_[color];
+    UpdatePlayable(color);
+    for (int rank = 0; rank < num_ranks; ++rank) {
+      discard_counts_[color * num_ranks + rank] = 0;
+      remaining_counts_[color * num_ranks + rank] =
+          ParentGame()->NumberCardInstances(color, rank) -
+          (rank < fireworks_[color]);
     }
   }
-  return -1;
+  for (const HanabiCard& card : discard_pile_) {
+    const int index = card.Color() * num_ranks + card.Rank();
+    ++discard_counts_[index];
+    --remaining_counts_[index];
+  }
+  short_hands_ = 0;
+  for (int player = 0; player < hands_.size(); ++player) {
+    UpdateShortHand(player);
+  }
+}
+
+void HanabiState::UpdatePlayable(int color) {
+  const int num_ranks = ParentGame()->NumRanks();
+  const uint32_t color_mask = ((static_cast<uint32_t>(1) << num_ranks) - 1)
+                              << (color * num_ranks);
+  playable_mask_ &= ~color_mask;
+  if (fireworks_[color] < num_ranks) {
+    playable_mask_ |= static_cast<uint32_t>(1)
+                      << (color * num_ranks + fireworks_[color]);
+  }
+}
+
+void HanabiState::CountCardOut(HanabiCard card, bool scored, int delta) {
+  const int index = card.Color() * ParentGame()->NumRanks() + card.Rank();
+  remaining_counts_[index] -= delta;
+  if (scored) {
+    fireworks_total_ += delta;
+    UpdatePlayable(card.Color());
+  } else {
+    discard_counts_[index] += delta;
+  }
 }
 
 bool HanabiState::MoveIsLegal(HanabiMove move) const {
@@ -218,8 +328,39 @@ bool HanabiState::MoveIsLegal(HanabiMove move) const {
   return true;
 }
 
-void HanabiState::ApplyMove(HanabiMove move) {
+void HanabiState::ApplyMove(HanabiMove move, UndoRecord* undo) {
   REQUIRE(MoveIsLegal(move));
+  // In direct-deal mode, a play or discard from a non-empty deck also deals
+  // the replacement card, which UndoMove cannot take back.
+  REQUIRE(undo == nullptr || !direct_deal_ || deck_.Empty() ||
+          (move.MoveType() != HanabiMove::kPlay &&
+           move.MoveType() != HanabiMove::kDiscard));
+  if (undo != nullptr) {
+    SaveUndoRecord(move, undo);
+  }
+  // The keys of the hand slots and card counts the move changes are taken out
+  // of the hash before the change and put back in after.
+  int keyed_player = cur_player_;
+  int first_keyed_slot = move.CardIndex();
+  HanabiCard keyed_card(move.Color(), move.Rank());
+  uint64_t hash = 0;
+  if (incremental_hash_) {
+    switch (move.MoveType()) {
+      case HanabiMove::kDeal:
+        keyed_player = PlayerToDeal();
+        first_keyed_slot = hands_[keyed_player].Cards().size();
+        break;
+      case HanabiMove::kDiscard:
+      case HanabiMove::kPlay:
+        keyed_card = hands_[cur_player_].Cards()[move.CardIndex()];
+        break;
+      default:
+        keyed_player = (cur_player_ + move.TargetOffset()) % hands_.size();
+        first_keyed_slot = 0;
+    }
+    hash = hash_ ^ MoveKeys(move.MoveType(), keyed_player, first_keyed_slot,
+                            keyed_card);
+  }
   if (deck_.Empty()) {
     --turns_to_play_;
   }
@@ -237,6 +378,7 @@ void HanabiState::ApplyMove(HanabiMove move) {
         hands_[history.deal_to_player].AddCard(
             deck_.DealCard(move.Color(), move.Rank()),
             card_knowledge);
+        UpdateShortHand(history.deal_to_player);
       }
       break;
     case HanabiMove::kDiscard:
@@ -244,6 +386,8 @@ void HanabiState::ApplyMove(HanabiMove move) {
       history.color = hands_[cur_player_].Cards()[move.CardIndex()].Color();
       history.rank = hands_[cur_player_].Cards()[move.CardIndex()].Rank();
       hands_[cur_player_].RemoveFromHand(move.CardIndex(), &discard_pile_);
+      CountCardOut(HanabiCard(history.color, history.rank), false, 1);
+      UpdateShortHand(cur_player_);
       break;
     case HanabiMove::kPlay:
       history.color = hands_[cur_player_].Cards()[move.CardIndex()].Color();
@@ -252,6 +396,8 @@ void HanabiState::ApplyMove(HanabiMove move) {
           AddToFireworks(hands_[cur_player_].Cards()[move.CardIndex()]);
       hands_[cur_player_].RemoveFromHand(
           move.CardIndex(), history.scored ? nullptr : &discard_pile_);
+      CountCardOut(HanabiCard(history.color, history.rank), history.scored, 1);
+      UpdateShortHand(cur_player_);
       break;
     case HanabiMove::kRevealColor:
       DecrementInformationTokens();
@@ -270,8 +416,333 @@ void HanabiState::ApplyMove(HanabiMove move) {
     default:
       std::abort();  // Should not be possible.
   }
-  move_history_.push_back(history);
+  if (undo != nullptr) {
+    undo->history = history;
+  }
+  RecordMove(history);
   AdvanceToNextPlayer();
+  if (incremental_hash_) {
+    if (move.MoveType() == HanabiMove::kDiscard ||
+        (move.MoveType() == HanabiMove::kPlay && !history.scored)) {
+      discard_keys_ += DiscardKey(keyed_card.Color(), keyed_card.Rank());
+    }
+    hash_ = hash ^ MoveKeys(move.MoveType(), keyed_player, first_keyed_slot,
+                            keyed_card);
+  }
+  if (direct_deal_ && move.MoveType() != HanabiMove::kDeal) {
+    while (cur_player_ == kChancePlayerId) {
+      ApplyMove(SampleChanceOutcome());
+    }
+  }
+}
+
+void HanabiState::SaveUndoRecord(HanabiMove move, UndoRecord* undo) const {
+  switch (move.MoveType()) {
+    case HanabiMove::kDiscard:
+    case HanabiMove::kPlay:
+      undo->knowledge.assign(
+          1, hands_[cur_player_].Knowledge()[move.CardIndex()]);
+      break;
+    case HanabiMove::kRevealColor:
+    case HanabiMove::kRevealRank:
+      undo->knowledge = HandByOffset(move.TargetOffset()).Knowledge();
+      break;
+    default:
+      undo->knowledge.clear();
+  }
+  undo->num_moves = num_moves_;
+  undo->last_move_index =
+      cur_player_ == kChancePlayerId ? -1 : last_move_index_[cur_player_];
+  undo->first_player_move_index = first_player_move_index_;
+  undo->next_non_chance_player = next_non_chance_player_;
+  undo->information_tokens = information_tokens_;
+  undo->life_tokens = life_tokens_;
+  undo->turns_to_play = turns_to_play_;
+  undo->rng = rng_;
+  undo->hash = hash_;
+  undo->discard_keys = discard_keys_;
+}
+
+void HanabiState::UndoMove(const UndoRecord& undo) {
+  REQUIRE(undo.num_moves == num_moves_ - 1);
+  const HanabiHistoryItem& history = undo.history;
+  const HanabiMove& move = history.move;
+  switch (move.MoveType()) {
+    case HanabiMove::kDeal: {
+      HanabiHand* hand = &hands_[history.deal_to_player];
+      const HanabiCard card = hand->Cards().back();
+      hand->RemoveFromHand(hand->Cards().size() - 1, nullptr);
+      deck_.ReturnCard(card.Color(), card.Rank());
+      UpdateShortHand(history.deal_to_player);
+      break;
+    }
+    case HanabiMove::kDiscard:
+    case HanabiMove::kPlay:
+      if (history.scored) {
+        --fireworks_[history.color];
+      } else {
+        discard_pile_.pop_back();
+      }
+      hands_[history.player].InsertCard(
+          move.CardIndex(), HanabiCard(history.color, history.rank),
+          undo.knowledge[0]);
+      CountCardOut(HanabiCard(history.color, history.rank), history.scored,
+                   -1);
+      UpdateShortHand(history.player);
+      break;
+    case HanabiMove::kRevealColor:
+    case HanabiMove::kRevealRank:
+      hands_[(history.player + move.TargetOffset()) % hands_.size()]
+          .RestoreKnowledge(undo.knowledge);
+      break;
+    default:
+      std::abort();  // Should not be possible.
+  }
+  // In kRecentHistory, the move may have been dropped already.
+  if (!move_history_.empty()) {
+    move_history_.pop_back();
+  }
+  num_moves_ = undo.num_moves;
+  if (history.player != kChancePlayerId) {
+    last_move_index_[history.player] = undo.last_move_index;
+  }
+  first_player_move_index_ = undo.first_player_move_index;
+  cur_player_ = history.player;
+  next_non_chance_player_ = undo.next_non_chance_player;
+  information_tokens_ = undo.information_tokens;
+  life_tokens_ = undo.life_tokens;
+  turns_to_play_ = undo.turns_to_play;
+  rng_ = undo.rng;
+  hash_ = undo.hash;
+  discard_keys_ = undo.discard_keys;
+}
+
+void HanabiState::RecordMove(const HanabiHistoryItem& history) {
+  if (history.player != kChancePlayerId) {
+    last_move_index_[history.player] = num_moves_;
+    if (first_player_move_index_ < 0) {
+      first_player_move_index_ = num_moves_;
+    }
+  }
+  ++num_moves_;
+  switch (history_mode_) {
+    case kFullHistory:
+      move_history_.push_back(history);
+      break;
+    case kRecentHistory:
+      // Drop the older moves in chunks, for amortized constant time.
+      if (move_history_.size() >= 2 * RecentHistoryLength()) {
+        move_history_.erase(move_history_.begin(),
+                            move_history_.end() - RecentHistoryLength() + 1);
+      }
+      move_history_.push_back(history);
+      break;
+    case kNoHistory:
+      break;
+  }
+}
+
+void HanabiState::SetHistoryMode(HistoryMode mode) {
+  history_mode_ = mode;
+  if (mode == kNoHistory) {
+    move_history_.clear();
+  } else if (mode == kRecentHistory &&
+             move_history_.size() > RecentHistoryLength()) {
+    move_history_.erase(move_history_.begin(),
+                        move_history_.end() - RecentHistoryLength());
+  }
+}
+
+void HanabiState::ReplaceHandCards(int player,
+                                   const std::vector<HanabiCard>& cards) {
+  HanabiHand* hand = &hands_[player];
+  REQUIRE(cards.size() == hand->Cards().size());
+  // Deck counts only change for the cards of either hand.
+  uint32_t changed_cards = 0;
+  if (incremental_hash_) {
+    const int num_ranks = parent_game_->NumRanks();
+    for (int card_index = 0; card_index < cards.size(); ++card_index) {
+      const HanabiCard& old_card = hand->Cards()[card_index];
+      changed_cards |= 1u << (old_card.Color() * num_ranks + old_card.Rank());
+      changed_cards |= 1u << (cards[card_index].Color() * num_ranks +
+                              cards[card_index].Rank());
+    }
+    hash_ ^= HandKeys(player, 0) ^ DeckKeys(changed_cards);
+  }
+  for (const HanabiCard& card : hand->Cards()) {
+    deck_.ReturnCard(card.Color(), card.Rank());
+  }
+  for (int card_index = 0; card_index < cards.size(); ++card_index) {
+    const HanabiCard& card = cards[card_index];
+    hand->ReplaceCard(card_index, deck_.DealCard(card.Color(), card.Rank()));
+  }
+  if (incremental_hash_) {
+    hash_ ^= HandKeys(player, 0) ^ DeckKeys(changed_cards);
+  }
+}
+
+uint64_t HanabiState::HandKeys(int player, int first_slot,
+                               const int* color_map) const {
+  const int num_ranks = parent_game_->NumRanks();
+  const HanabiHand& hand = hands_[player];
+  const HanabiCard* cards = hand.Cards().data();
+  const HanabiHand::CardKnowledge* knowledge = hand.Knowledge().data();
+  const int num_cards = hand.Cards().size();
+  uint64_t keys = 0;
+  if (color_map == nullptr) {
+    for (int slot = first_slot; slot < num_cards; ++slot) {
+      keys ^= SlotKey(player, slot,
+                      cards[slot].Color() * num_ranks + cards[slot].Rank(),
+                      knowledge[slot].PlausibleMask(), knowledge[slot].Color(),
+                      knowledge[slot].Rank());
+    }
+    return keys;
+  }
+  for (int slot = first_slot; slot < num_cards; ++slot) {
+    const int hinted_color = knowledge[slot].Color();
+    uint32_t plausible = 0;
+    for (int c = 0; c < parent_game_->NumColors(); ++c) {
+      plausible |= ((knowledge[slot].PlausibleMask() &
+                     knowledge[slot].ColorMask(c)) >> (c * num_ranks))
+                   << (color_map[c] * num_ranks);
+    }
+    keys ^= SlotKey(
+        player, slot,
+        color_map[cards[slot].Color()] * num_ranks + cards[slot].Rank(),
+        plausible, hinted_color < 0 ? -1 : color_map[hinted_color],
+        knowledge[slot].Rank());
+  }
+  return keys;
+}
+
+uint64_t HanabiState::DeckKeys(uint32_t cards) const {
+  const int num_ranks = parent_game_->NumRanks();
+  uint64_t keys = 0;
+  for (; cards != 0; cards &= cards - 1) {
+    const int card_index = LowestSetBit(cards);
+    keys ^= DeckKey(card_index / num_ranks, card_index % num_ranks);
+  }
+  return keys;
+}
+
+uint64_t HanabiState::DeckKey(int color, int rank) const {
+  return DeckCountKey(color * parent_game_->NumRanks() + rank,
+                      deck_.CardCount(color, rank));
+}
+
+uint64_t HanabiState::DiscardKey(int color, int rank) const {
+  return ZobristKey(kDiscardFeature, color * parent_game_->NumRanks() + rank);
+}
+
+uint64_t HanabiState::FireworkKey(int color) const {
+  return ZobristKey(kFireworkFeature,
+                    static_cast<uint64_t>(color) << 8 | fireworks_[color]);
+}
+
+uint64_t HanabiState::CountersKey() const {
+  // 16 bits per counter is more than any game needs.
+  const uint64_t value =
+      static_cast<uint64_t>(cur_player_ + 1) |
+      static_cast<uint64_t>(next_non_chance_player_ + 1) << 4 |
+      static_cast<uint64_t>(information_tokens_ & 0xffff) << 8 |
+      static_cast<uint64_t>(life_tokens_ & 0xffff) << 24 |
+      static_cast<uint64_t>(turns_to_play_ & 0xffff) << 40;
+  return ZobristKey(kCountersFeature, value);
+}
+
+uint64_t HanabiState::MoveKeys(HanabiMove::Type move_type, int player,
+                               int first_slot, HanabiCard card) const {
+  // Keys which the move does not change cancel out.
+  uint64_t keys = CountersKey() ^ discard_keys_ ^ HandKeys(player, first_slot);
+  if (move_type == HanabiMove::kDeal) {
+    keys ^= DeckKey(card.Color(), card.Rank());
+  } else if (move_type == HanabiMove::kPlay) {
+    keys ^= FireworkKey(card.Color());
+  }
+  return keys;
+}
+
+uint64_t HanabiState::ComputeHash(const int* color_map) const {
+  const int num_colors = parent_game_->NumColors();
+  const int num_ranks = parent_game_->NumRanks();
+  const int* colors = color_map != nullptr ? color_map : kIdentityColorMap;
+  uint64_t discard_keys = 0;
+  uint64_t hash = 0;
+  for (int color = 0; color < num_colors; ++color) {
+    hash ^= ZobristKey(kFireworkFeature,
+                       static_cast<uint64_t>(colors[color]) << 8 |
+                           fireworks_[color]);
+    for (int rank = 0; rank < num_ranks; ++rank) {
+      hash ^= DeckCountKey(colors[color] * num_ranks + rank,
+                           deck_.CardCount(color, rank));
+      discard_keys += DiscardCount(color, rank) *
+                      DiscardKey(colors[color], rank);
+    }
+  }
+  hash ^= CountersKey() ^ discard_keys;
+  for (int player = 0; player < hands_.size(); ++player) {
+    hash ^= HandKeys(player, 0, color_map);
+  }
+  return hash;
+}
+
+void HanabiState::SetIncrementalHash(bool enabled) {
+  if (enabled && !incremental_hash_) {
+    discard_keys_ = 0;
+    for (int color = 0; color < parent_game_->NumColors(); ++color) {
+      for (int rank = 0; rank < parent_game_->NumRanks(); ++rank) {
+        discard_keys_ += DiscardCount(color, rank) * DiscardKey(color, rank);
+      }
+    }
+    hash_ = ComputeHash(nullptr);
+  }
+  incremental_hash_ = enabled;
+}
+
+uint64_t HanabiState::CanonicalKey() const {
+  const int num_colors = parent_game_->NumColors();
+  const int num_ranks = parent_game_->NumRanks();
+  // A signature of every color which does not depend on its label: the keys
+  // of all the values involving the color, keyed without the color. Colors
+  // with equal signatures are interchangeable, so the order of their ties
+  // does not change the key.
+  uint64_t signatures[kMaxNumColors];
+  for (int color = 0; color < num_colors; ++color) {
+    uint64_t signature = ZobristKey(kColorFeature, fireworks_[color]);
+    for (int rank = 0; rank < num_ranks; ++rank) {
+      signature ^= ZobristKey(
+          kColorFeature, static_cast<uint64_t>(1) << 40 | rank << 16 |
+                             deck_.CardCount(color, rank) << 8 |
+                             DiscardCount(color, rank));
+    }
+    for (int player = 0; player < hands_.size(); ++player) {
+      const HanabiHand& hand = hands_[player];
+      for (int slot = 0; slot < hand.Cards().size(); ++slot) {
+        const HanabiCard& card = hand.Cards()[slot];
+        const HanabiHand::CardKnowledge& knowledge = hand.Knowledge()[slot];
+        const uint32_t plausible_ranks =
+            (knowledge.PlausibleMask() & knowledge.ColorMask(color)) >>
+            (color * num_ranks);
+        signature ^= ZobristKey(
+            kColorFeature,
+            static_cast<uint64_t>(2) << 40 |
+                static_cast<uint64_t>(player) << 32 | slot << 24 |
+                (card.Color() == color ? card.Rank() + 1 : 0) << 16 |
+                (knowledge.Color() == color) << 8 | plausible_ranks);
+      }
+    }
+    signatures[color] = signature;
+  }
+  int order[kMaxNumColors];
+  std::iota(order, order + num_colors, 0);
+  std::sort(order, order + num_colors, [&signatures](int a, int b) {
+    return signatures[a] < signatures[b];
+  });
+  int color_map[kMaxNumColors];
+  for (int i = 0; i < num_colors; ++i) {
+    color_map[order[i]] = i;
+  }
+  return ComputeHash(color_map);
 }
 
 double HanabiState::ChanceOutcomeProb(HanabiMove move) const {
@@ -279,28 +750,72 @@ double HanabiState::ChanceOutcomeProb(HanabiMove move) const {
          static_cast<double>(deck_.Size());
 }
 
-void HanabiState::ApplyRandomChance() {
-  auto chance_outcomes = ChanceOutcomes();
-  REQUIRE(!chance_outcomes.second.empty());
-  ApplyMove(ParentGame()->PickRandomChance(chance_outcomes));
+void HanabiState::ApplyRandomChance(UndoRecord* undo) {
+  REQUIRE(cur_player_ == kChancePlayerId && !deck_.Empty());
+  const CounterRng rng = rng_;
+  ApplyMove(SampleChanceOutcome(), undo);
+  if (undo != nullptr) {
+    undo->rng = rng;
+  }
+}
+
+HanabiMove HanabiState::SampleChanceOutcome() {
+  const int position = has_random_stream_
+                           ? rng_.Below(deck_.Size())
+                           : ParentGame()->GetSampledInteger(deck_.Size());
+  const HanabiCard card = deck_.CardAt(position);
+  return ParentGame()->GetChanceOutcome(card.Color() * ParentGame()->NumRanks() +
+                                        card.Rank());
+}
+
+void HanabiState::SetDirectDeal(bool enabled) {
+  direct_deal_ = enabled;
+  while (direct_deal_ && cur_player_ == kChancePlayerId) {
+    ApplyMove(SampleChanceOutcome());
+  }
 }
 
 std::vector<HanabiMove> HanabiState::LegalMoves(int player) const {
   std::vector<HanabiMove> movelist;
   // kChancePlayer=-1 must be handled by ChanceOutcome.
   REQUIRE(player >= 0 && player < ParentGame()->NumPlayers());
+  for (uint64_t mask = LegalMovesMask(player); mask != 0; mask &= mask - 1) {
+    movelist.push_back(ParentGame()->GetMove(LowestSetBit(mask)));
+  }
+  return movelist;
+}
+
+uint64_t HanabiState::LegalMovesMask(int player) const {
+  // kChancePlayer=-1 must be handled by ChanceOutcome.
+  REQUIRE(player >= 0 && player < ParentGame()->NumPlayers());
+  REQUIRE(ParentGame()->MaxMoves() <= 64);
   if (player != cur_player_) {
-    // Turn-based game. Empty move list for other players.
-    return movelist;
+    // Turn-based game. No legal moves for other players.
+    return 0;
   }
-  int max_move_uid = ParentGame()->MaxMoves();
-  for (int uid = 0; uid < max_move_uid; ++uid) {
-    HanabiMove move = ParentGame()->GetMove(uid);
-    if (MoveIsLegal(move)) {
-      movelist.push_back(move);
+  const int hand_size = ParentGame()->HandSize();
+  const int num_players = ParentGame()->NumPlayers();
+  const int num_colors = ParentGame()->NumColors();
+  const int num_ranks = ParentGame()->NumRanks();
+  // Uid layout: discards, plays, color hints, rank hints (see HanabiGame).
+  const uint64_t cards_mask =
+      (static_cast<uint64_t>(1) << hands_[player].Cards().size()) - 1;
+  uint64_t mask = cards_mask << hand_size;
+  if (information_tokens_ < ParentGame()->MaxInformationTokens()) {
+    mask |= cards_mask;
+  }
+  if (information_tokens_ > 0) {
+    const int color_hints = 2 * hand_size;
+    const int rank_hints = color_hints + (num_players - 1) * num_colors;
+    for (int offset = 1; offset < num_players; ++offset) {
+      const HanabiHand& target = hands_[(player + offset) % num_players];
+      mask |= static_cast<uint64_t>(target.ColorPresenceMask())
+              << (color_hints + (offset - 1) * num_colors);
+      mask |= static_cast<uint64_t>(target.RankPresenceMask())
+              << (rank_hints + (offset - 1) * num_ranks);
     }
   }
-  return movelist;
+  return mask;
 }
 
 bool HanabiState::CardPlayableOnFireworks(int color, int rank) const {
@@ -356,18 +871,11 @@ std::string HanabiState::ToString() const {
   return result;
 }
 
-int HanabiState::Score() const {
-  if (LifeTokens() <= 0) {
-    return 0;
-  }
-  return std::accumulate(fireworks_.begin(), fireworks_.end(), 0);
-}
-
 HanabiState::EndOfGameType HanabiState::EndOfGameStatus() const {
   if (LifeTokens() < 1) {
     return kOutOfLifeTokens;
   }
-  if (Score() >= ParentGame()->NumColors() * ParentGame()->NumRanks()) {
+  if (fireworks_total_ >= ParentGame()->MaxScore()) {
     return kCompletedFireworks;
   }
   if (turns_to_play_ <= 0) {
@@ -15,15 +15,18 @@
 #ifndef __HANABI_STATE_H__
 #define __HANABI_STATE_H__
 
+#include <cstdint>
 #include <random>
 #include <string>
 #include <vector>
 
+#include "counter_rng.h"
 #include "hanabi_card.h"
 #include "hanabi_game.h"
 #include "hanabi_hand.h"
 #include "hanabi_history_item.h"
 #include "hanabi_move.h"
+#include "util.h"
 
 namespace hanabi_learning_env {
 
@@ -37,27 +40,69 @@ class HanabiState {
     // DealCard returns invalid card on failure.
     HanabiCard DealCard(int color, int rank);
     HanabiCard DealCard(std::mt19937* rng);
+    // Put a dealt card back into the deck.
+    void ReturnCard(int color, int rank);
     int Size() const { return total_count_; }
     bool Empty() const { return total_count_ == 0; }
     int CardCount(int color, int rank) const {
       return card_count_[CardToIndex(color, rank)];
     }
+    // The card at position in the deck, 0 <= position < Size(), with the
+    // cards ordered by color, then rank. Drawing position uniformly draws a
+    // card with probability proportional to its count, in O(log) time.
+    HanabiCard CardAt(int position) const;
 
    private:
+    // Card indices fit in a Fenwick tree of this size, a power of two.
+    static constexpr int kTreeSize = 32;
+
     int CardToIndex(int color, int rank) const {
       return color * num_ranks_ + rank;
     }
     int IndexToColor(int index) const { return index / num_ranks_; }
     int IndexToRank(int index) const { return index % num_ranks_; }
+    // Adds delta to the count of card index, in card_count_ and the tree.
+    void AddCount(int index, int delta);
 
     // Number of instances in the deck for each card.
     // E.g., if card_count_[CardToIndex(card)] == 2, then there are two
     // instances of card remaining in the deck, available to be dealt out.
     std::vector<int> card_count_;
+    // Fenwick tree of card_count_: count_tree_[i - 1] is the sum of the
+    // counts of card indices i - (i & -i) to i - 1.
+    uint8_t count_tree_[kTreeSize] = {};
     int total_count_ = -1;  // Total number of cards available to be dealt out.
     int num_ranks_ = -1;    // From game.NumRanks(), used to map card to index.
   };
 
+  // How much of the move history a state records, see SetHistoryMode.
+  enum HistoryMode {
+    kFullHistory,    // Every move since the start of the game, the default.
+    kRecentHistory,  // At least the last RecentHistoryLength() moves.
+    kNoHistory       // Nothing.
+  };
+
+  // What UndoMove needs to take back a move: the move's history item, which
+  // is filled in whatever the history mode, the card knowledge which the move
+  // lost or changed, and the counters from before the move. Reusing a record
+  // for many moves reuses its memory.
+  struct UndoRecord {
+    HanabiHistoryItem history =
+        HanabiHistoryItem(HanabiMove(HanabiMove::kInvalid, -1, -1, -1, -1));
+    // Knowledge of the played or discarded card, or of the hinted hand.
+    std::vector<HanabiHand::CardKnowledge> knowledge;
+    int num_moves = -1;
+    int last_move_index = -1;  // Of the player who moved.
+    int first_player_move_index = -1;
+    int next_non_chance_player = -1;
+    int information_tokens = -1;
+    int life_tokens = -1;
+    int turns_to_play = -1;
+    CounterRng rng;
+    uint64_t hash = 0;
+    uint64_t discard_keys = 0;
+  };
+
   enum EndOfGameType {
     kNotFinished,        // Not the end of game.
     kOutOfLifeTokens,    // Players ran out of life tokens.
@@ -73,25 +118,78 @@ class HanabiState {
   HanabiState(const HanabiState& state) = default;
 
   bool MoveIsLegal(HanabiMove move) const;
-  void ApplyMove(HanabiMove move);
+  // If undo is not null, it receives what UndoMove needs to take the move
+  // back.
+  void ApplyMove(HanabiMove move, UndoRecord* undo = nullptr);
+  // Restores the state exactly as it was before the move of undo, which must
+  // be the last move applied. Moves are taken back in the reverse order they
+  // were applied, so that depth-first search can make and unmake moves on
+  // one state instead of copying it at every node. The history mode must
+  // not change in between. In kRecentHistory, taking back moves leaves fewer
+  // than RecentHistoryLength() moves in the history, down to none.
+  void UndoMove(const UndoRecord& undo);
   // Legal moves for state. Moves point into an unchanging list in parent_game.
   std::vector<HanabiMove> LegalMoves(int player) const;
+  // Legal moves for state as a bitmask indexed by move uid: bit uid is set iff
+  // ParentGame()->GetMove(uid) is legal for player. Requires MaxMoves() <= 64.
+  uint64_t LegalMovesMask(int player) const;
   // Returns true if card with color and rank can be played on fireworks pile.
   bool CardPlayableOnFireworks(int color, int rank) const;
   bool CardPlayableOnFireworks(HanabiCard card) const {
     return CardPlayableOnFireworks(card.Color(), card.Rank());
   }
+  // Aggregates which every move keeps up to date, for constant-time reads.
+  // Bit color * NumRanks() + rank is set iff card (color, rank) is playable
+  // on the fireworks; same layout as CardKnowledge::PlausibleMask.
+  uint32_t PlayableMask() const { return playable_mask_; }
+  // Copies of card (color, rank) in the discard pile.
+  int DiscardCount(int color, int rank) const {
+    return discard_counts_[color * ParentGame()->NumRanks() + rank];
+  }
+  // Copies of card (color, rank) neither discarded nor on the fireworks,
+  // i.e. still in the deck or in a hand.
+  int RemainingCount(int color, int rank) const {
+    return remaining_counts_[color * ParentGame()->NumRanks() + rank];
+  }
   bool ChanceOutcomeIsLegal(HanabiMove move) const { return MoveIsLegal(move); }
   double ChanceOutcomeProb(HanabiMove move) const;
   void ApplyChanceOutcome(HanabiMove move) { ApplyMove(move); }
-  void ApplyRandomChance();
+  // Applies a random chance outcome, drawn from the state's own random stream
+  // if it has one, and from the generator shared through parent_game if not.
+  // Draws a deck position, see HanabiDeck::CardAt, without allocating.
+  // Taking the deal back with UndoMove also rewinds the state's own stream.
+  void ApplyRandomChance(UndoRecord* undo = nullptr);
+  // Give this state its own random stream for chance outcomes. States with
+  // their own stream can be dealt concurrently, and their deals depend only
+  // on the stream and the moves applied, not on any other state.
+  void SetRandomStream(const CounterRng& rng) {
+    rng_ = rng;
+    has_random_stream_ = true;
+  }
+  bool HasRandomStream() const { return has_random_stream_; }
+  // In direct-deal mode, a play or discard deals the card replacing it in
+  // ApplyMove itself, so that the chance player is never to move between
+  // player moves and callers need not call ApplyRandomChance. Turning the
+  // mode on deals the cards due right away, e.g. the initial hands. Deals are
+  // drawn as ApplyRandomChance draws them and recorded in the history as
+  // before: the state is the same as with the deals applied by the caller.
+  // Plays and discards which deal a card cannot be taken back, so ApplyMove
+  // takes no UndoRecord for them in this mode; hints, and plays and discards
+  // once the deck is empty, can still be undone. Off by default; copies keep
+  // the setting.
+  void SetDirectDeal(bool enabled);
+  bool DirectDeal() const { return direct_deal_; }
+  // Replace the cards of player's hand, keeping their knowledge: the old cards
+  // go back to the deck and cards must be available in it. For sampling the
+  // hidden cards of a hand, see SampleDeterminization.
+  void ReplaceHandCards(int player, const std::vector<HanabiCard>& cards);
   // Get the valid chance moves, and associated probabilities.
   // Guaranteed that moves.size() == probabilities.size().
   std::pair<std::vector<HanabiMove>, std::vector<double>> ChanceOutcomes()
       const;
   EndOfGameType EndOfGameStatus() const;
   bool IsTerminal() const { return EndOfGameStatus() != kNotFinished; }
-  int Score() const;
+  int Score() const { return life_tokens_ > 0 ? fireworks_total_ : 0; }
   std::string ToString() const;
 
   int CurPlayer() const { return cur_player_; }
@@ -104,11 +202,57 @@ class HanabiState {
   // Get the discard pile (the element at the back is the most recent discard.)
   const std::vector<HanabiCard>& DiscardPile() const { return discard_pile_; }
   // Sequence of moves from beginning of game. Stored as <move, actor>.
+  // Only the moves from HistoryStart() on, unless the history mode is
+  // kFullHistory.
   const std::vector<HanabiHistoryItem>& MoveHistory() const {
     return move_history_;
   }
+  // Rollouts and search which never read the history can stop recording it,
+  // or bound it to the recent moves which HanabiObservation needs. Recorded
+  // moves which the new mode does not keep are dropped.
+  void SetHistoryMode(HistoryMode mode);
+  HistoryMode GetHistoryMode() const { return history_mode_; }
+  // Moves kept by kRecentHistory: a move and a deal per player, i.e. every
+  // move since any player's last turn.
+  int RecentHistoryLength() const { return 2 * hands_.size(); }
+  // Number of moves applied since the start of the game, deals included.
+  // Moves are indexed from 0 in the order they were applied.
+  int NumMoves() const { return num_moves_; }
+  // Index of the move at MoveHistory()[0].
+  int HistoryStart() const { return num_moves_ - move_history_.size(); }
+  // Index of the last move of player, -1 if there was none. Kept in every
+  // history mode, so finding the moves since a player's last turn does not
+  // need a scan of the history.
+  int LastMoveIndex(int player) const { return last_move_index_[player]; }
+  // Index of the first move of a player (i.e. the first move after the
+  // initial deals), -1 if there was none.
+  int FirstPlayerMoveIndex() const { return first_player_move_index_; }
+  // 64-bit Zobrist hash of the position: the cards and card knowledge of
+  // every hand slot, fireworks, tokens, deck and discard counts, and whose
+  // turn it is. The move history, the order of the discard pile and the
+  // random stream are not part of the position. Equal positions of games
+  // with the same parameters have equal hashes.
+  //
+  // Computed from scratch unless the state keeps it up to date, see
+  // SetIncrementalHash.
+  uint64_t Hash() const {
+    return incremental_hash_ ? hash_ : ComputeHash(nullptr);
+  }
+  // Search which looks up every state it reaches in a transposition table
+  // can have ApplyMove update the hash as it goes, from the keys of what
+  // each move changes, at the cost of a few tens of nanoseconds per move.
+  // Off by default; copies keep the setting.
+  void SetIncrementalHash(bool enabled);
+  bool IncrementalHash() const { return incremental_hash_; }
+  // Hash of the position with its colors relabeled in a canonical order, so
+  // that positions which only differ by a permutation of the colors share
+  // the key. Computed from scratch on every call.
+  uint64_t CanonicalKey() const;
 
  private:
+  // Converts to and from HanabiState.
+  friend class HanabiCompactState;
+
   // Add card to table if possible, if not lose a life token.
   // Returns <scored,information_token_added>
   // success is true iff card was successfully added to fireworks.
@@ -123,10 +267,57 @@ class HanabiState {
   }
   void AdvanceToNextPlayer();  // Set cur_player to next player to act.
   bool HintingIsLegal(HanabiMove move) const;
-  int PlayerToDeal() const;  // -1 if no player needs a card.
+  // -1 if no player needs a card.
+  int PlayerToDeal() const {
+    return short_hands_ != 0 ? LowestSetBit(short_hands_) : -1;
+  }
   bool IncrementInformationTokens();
   void DecrementInformationTokens();
   void DecrementLifeTokens();
+  // Recomputes the aggregates from scratch, after fields were set directly.
+  void ComputeAggregates();
+  // Call after the size of player's hand changed.
+  void UpdateShortHand(int player) {
+    const uint32_t bit = static_cast<uint32_t>(1) << player;
+    short_hands_ = hands_[player].Cards().size() < ParentGame()->HandSize()
+                       ? short_hands_ | bit
+                       : short_hands_ & ~bit;
+  }
+  // Call after the firework of color changed.
+  void UpdatePlayable(int color);
+  // Counts card as gone from the hands to the fireworks if scored, to the
+  // discard pile if not (delta 1), or back (delta -1).
+  void CountCardOut(HanabiCard card, bool scored, int delta);
+  // Draws the card dealt next, from the state's own random stream if it has
+  // one, and returns its chance outcome.
+  HanabiMove SampleChanceOutcome();
+  // Saves into undo what ApplyMove(move) is about to change, but the history
+  // item.
+  void SaveUndoRecord(HanabiMove move, UndoRecord* undo) const;
+  // Counts a move and records it as the history mode says.
+  void RecordMove(const HanabiHistoryItem& history);
+  // Hash of the position with every color c relabeled color_map[c], or of
+  // the position as it is if color_map is null.
+  uint64_t ComputeHash(const int* color_map) const;
+  // XOR of the Zobrist keys of the cards of player's hand from first_slot on.
+  uint64_t HandKeys(int player, int first_slot,
+                    const int* color_map = nullptr) const;
+  // XOR of the keys of the hand slots, card counts and counters which a move
+  // of move_type by or to player can change, card being the card it deals,
+  // plays or discards. Taken before and after the move, it updates the hash.
+  uint64_t MoveKeys(HanabiMove::Type move_type, int player, int first_slot,
+                    HanabiCard card) const;
+  // Zobrist key of the number of copies of a card in the deck, and XOR of
+  // those of the cards of a bitmask of card indices.
+  uint64_t DeckKey(int color, int rank) const;
+  uint64_t DeckKeys(uint32_t cards) const;
+  // Zobrist key of a discarded card. Discards are a multiset, hashed by the
+  // sum of the keys of its cards so that updates need not count copies.
+  uint64_t DiscardKey(int color, int rank) const;
+  // Zobrist key of a color's firework.
+  uint64_t FireworkKey(int color) const;
+  // Zobrist key of the tokens and of whose turn it is.
+  uint64_t CountersKey() const;
 
   const HanabiGame* parent_game_ = nullptr;
   HanabiDeck deck_;
@@ -134,12 +325,31 @@ class HanabiState {
   std::vector<HanabiCard> discard_pile_;
   std::vector<HanabiHand> hands_;
   std::vector<HanabiHistoryItem> move_history_;
+  HistoryMode history_mode_ = kFullHistory;
+  int num_moves_ = 0;
+  std::vector<int> last_move_index_;
+  int first_player_move_index_ = -1;
   int cur_player_ = -1;
   int next_non_chance_player_ = -1;  // Next non-chance player to act.
   int information_tokens_ = -1;
   int life_tokens_ = -1;
   std::vector<int> fireworks_;
   int turns_to_play_ = -1;  // Number of turns to play once deck is empty.
+  CounterRng rng_;  // Random stream for chance outcomes, if has_random_stream_.
+  bool has_random_stream_ = false;
+  bool incremental_hash_ = false;
+  bool direct_deal_ = false;
+  // Hash() and the sum of the DiscardKey of discard_pile_, if
+  // incremental_hash_.
+  uint64_t hash_ = 0;
+  uint64_t discard_keys_ = 0;
+  // Aggregates of the fields above, see ComputeAggregates. Cards are indexed
+  // color * NumRanks() + rank.
+  int fireworks_total_ = 0;  // Sum of fireworks_.
+  uint32_t playable_mask_ = 0;
+  uint32_t short_hands_ = 0;  // Bit p set iff hands_[p] lacks cards.
+  uint8_t discard_counts_[kMaxNumColors * kMaxNumRanks] = {};
+  uint8_t remaining_counts_[kMaxNumColors * kMaxNumRanks] = {};
 };
 
 }  // namespace hanabi_learning_env
@@ -16,6 +16,7 @@
 #define __UTIL_H__
 
 #include <cassert>
+#include <cstdint>
 #include <cstdlib>
 #include <string>
 #include <unordered_map>
@@ -29,6 +30,12 @@ constexpr int kMaxNumRanks = 5;
 char ColorIndexToChar(int color);
 char RankIndexToChar(int rank);
 
+// Index of the lowest set bit of a non-zero bitmask.
+inline int LowestSetBit(uint64_t mask) { return __builtin_ctzll(mask); }
+
+// Number of set bits of a bitmask.
+inline int PopCount(uint64_t mask) { return __builtin_popcountll(mask); }
+
 // Returns string associated with key in params, parsed as template type.
 // If key is not in params, returns the provided default value.
 template <class T>
@@ -22,18 +22,125 @@
 #include <numeric>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "hanabi_lib/canonical_encoders.h"
+#include "hanabi_lib/hanabi_async_env_pool.h"
+#include "hanabi_lib/hanabi_batch_engine.h"
 #include "hanabi_lib/hanabi_card.h"
 #include "hanabi_lib/hanabi_game.h"
 #include "hanabi_lib/hanabi_history_item.h"
+#include "hanabi_lib/hanabi_ismcts.h"
 #include "hanabi_lib/hanabi_move.h"
 #include "hanabi_lib/hanabi_observation.h"
 #include "hanabi_lib/hanabi_parallel_env.h"
+#include "hanabi_lib/hanabi_rollout.h"
 #include "hanabi_lib/hanabi_state.h"
 #include "hanabi_lib/observation_encoder.h"
 #include "hanabi_lib/util.h"
 
+namespace {
+
+// Allocates size bytes aligned to a cache line. Release with free().
+void* CacheAlignedMalloc(size_t size) {
+  constexpr size_t kCacheLineSize = 64;
+  void* ptr = nullptr;
+  if (posix_memalign(&ptr, kCacheLineSize, size) != 0) {
+    return nullptr;
+  }
+  return ptr;
+}
+
+// Allocates the buffers of a batch observation with rows of obs_len bytes.
+void AllocateBatchObservation(
+    pyhanabi_batch_observation_t* batch_observation,
+    const hanabi_learning_env::HanabiParallelEnv* hanabi_parallel_env,
+    const int obs_len) {
+  const int n_states = hanabi_parallel_env->GetNumStates();
+  const int max_moves = hanabi_parallel_env->GetGame().MaxMoves();
+
+  REQUIRE(n_states > 0);
+  REQUIRE(obs_len > 0);
+  REQUIRE(max_moves > 0);
+  batch_observation->observation_shape[0] = n_states;
+  batch_observation->legal_moves_shape[0] = n_states;
+  batch_observation->observation_shape[1] = obs_len;
+  batch_observation->legal_moves_shape[1] = max_moves;
+
+  batch_observation->observation = (int8_t*) CacheAlignedMalloc(
+      sizeof(int8_t)
+      * batch_observation->observation_shape[0]
+      * batch_observation->observation_shape[1]);
+  batch_observation->legal_moves = (int8_t*) CacheAlignedMalloc(
+      sizeof(int8_t)
+      * batch_observation->legal_moves_shape[0]
+      * batch_observation->legal_moves_shape[1]);
+  batch_observation->scores =
+      (int16_t*) CacheAlignedMalloc(sizeof(int16_t) * n_states);
+  batch_observation->done =
+      (int8_t*) CacheAlignedMalloc(sizeof(int8_t) * n_states);
+  batch_observation->beliefs = nullptr;
+
+  REQUIRE(batch_observation->scores != nullptr);
+  REQUIRE(batch_observation->legal_moves != nullptr);
+  REQUIRE(batch_observation->done != nullptr);
+  REQUIRE(batch_observation->observation != nullptr);
+}
+
+// Wraps the buffers of a batch observation for HanabiParallelEnv.
+hanabi_learning_env::HanabiParallelEnv::HanabiBatchObservationBuffers
+BatchObservationBuffers(pyhanabi_batch_observation_t* batch_observation) {
+  REQUIRE(batch_observation->observation != nullptr);
+  REQUIRE(batch_observation->legal_moves != nullptr);
+  REQUIRE(batch_observation->done != nullptr);
+  REQUIRE(batch_observation->scores != nullptr);
+  hanabi_learning_env::HanabiParallelEnv::HanabiBatchObservationBuffers buffers;
+  buffers.observation = batch_observation->observation;
+  buffers.legal_moves = batch_observation->legal_moves;
+  buffers.scores = batch_observation->scores;
+  buffers.done = batch_observation->done;
+  buffers.beliefs = batch_observation->beliefs;
+  return buffers;
+}
+
+// Dereferences a rollout result handle.
+const hanabi_learning_env::HanabiRolloutResult& RolloutResult(
+    const pyhanabi_rollout_result_t* result) {
+  REQUIRE(result != nullptr);
+  REQUIRE(result->result != nullptr);
+  return *reinterpret_cast<const hanabi_learning_env::HanabiRolloutResult*>(
+      result->result);
+}
+
+hanabi_learning_env::HanabiBatchEngine* BatchEngine(
+    const pyhanabi_batch_engine_t* engine) {
+  REQUIRE(engine != nullptr);
+  REQUIRE(engine->engine != nullptr);
+  return reinterpret_cast<hanabi_learning_env::HanabiBatchEngine*>(
+      engine->engine);
+}
+
+// A search and the rollout policy it plays out games with.
+struct IsmctsSearchHandle {
+  IsmctsSearchHandle(
+      const hanabi_learning_env::IsmctsConfig& config,
+      std::unique_ptr<hanabi_learning_env::HanabiPolicy> rollout_policy)
+      : policy(std::move(rollout_policy)), search(config, policy.get()) {}
+
+  std::unique_ptr<hanabi_learning_env::HanabiPolicy> policy;
+  hanabi_learning_env::HanabiIsmcts search;
+};
+
+// Dereferences a search handle.
+IsmctsSearchHandle* Ismcts(const pyhanabi_ismcts_t* search) {
+  REQUIRE(search != nullptr);
+  REQUIRE(search->search != nullptr);
+  return reinterpret_cast<IsmctsSearchHandle*>(search->search);
+}
+
+}  // namespace
+
 extern "C" {
 
 /* Helpers. */
@@ -299,6 +406,17 @@ void NewState(pyhanabi_game_t* game, pyhanabi_state_t* state) {
       static_cast<hanabi_learning_env::HanabiGame*>(game->game));
 }
 
+void NewSeededState(pyhanabi_game_t* game, uint64_t deal_seed,
+                    pyhanabi_state_t* state) {
+  REQUIRE(state != nullptr);
+  REQUIRE(game != nullptr);
+  REQUIRE(game->game != nullptr);
+  state->state = new hanabi_learning_env::HanabiState(
+      hanabi_learning_env::NewSeededState(
+          *static_cast<hanabi_learning_env::HanabiGame*>(game->game),
+          deal_seed));
+}
+
 void CopyState(const pyhanabi_state_t* src, pyhanabi_state_t* dest) {
   REQUIRE(src != nullptr);
   REQUIRE(src->state != nullptr);
@@ -349,6 +467,20 @@ void StateDealRandomCard(pyhanabi_state_t* state) {
   hanabi_state->ApplyRandomChance();
 }
 
+void StateSetDirectDeal(pyhanabi_state_t* state, int enabled) {
+  REQUIRE(state != nullptr);
+  REQUIRE(state->state != nullptr);
+  reinterpret_cast<hanabi_learning_env::HanabiState*>(state->state)
+      ->SetDirectDeal(enabled != 0);
+}
+
+int StateDirectDeal(pyhanabi_state_t* state) {
+  REQUIRE(state != nullptr);
+  REQUIRE(state->state != nullptr);
+  return reinterpret_cast<hanabi_learning_env::HanabiState*>(state->state)
+      ->DirectDeal();
+}
+
 int StateDeckSize(pyhanabi_state_t* state) {
   REQUIRE(state != nullptr);
   REQUIRE(state->state != nullptr);
@@ -457,6 +589,20 @@ int StateScore(pyhanabi_state_t* state) {
       ->Score();
 }
 
+uint64_t StateHash(pyhanabi_state_t* state) {
+  REQUIRE(state != nullptr);
+  REQUIRE(state->state != nullptr);
+  return reinterpret_cast<hanabi_learning_env::HanabiState*>(state->state)
+      ->Hash();
+}
+
+uint64_t StateCanonicalKey(pyhanabi_state_t* state) {
+  REQUIRE(state != nullptr);
+  REQUIRE(state->state != nullptr);
+  return reinterpret_cast<hanabi_learning_env::HanabiState*>(state->state)
+      ->CanonicalKey();
+}
+
 char* StateToString(pyhanabi_state_t* state) {
   REQUIRE(state != nullptr);
   REQUIRE(state->state != nullptr);
@@ -607,6 +753,197 @@ int MaxMoves(pyhanabi_game_t* game) {
       ->MaxMoves();
 }
 
+/* Wrapper definitions for rollouts. */
+int IsPolicyName(const char* name) {
+  REQUIRE(name != nullptr);
+  return hanabi_learning_env::MakePolicy(name) != nullptr;
+}
+
+void NewRollouts(pyhanabi_rollout_result_t* result,
+                 pyhanabi_game_t* game,
+                 const int policies_len,
+                 const char** policies,
+                 const int num_games,
+                 int record_trajectories) {
+  REQUIRE(result != nullptr);
+  REQUIRE(game != nullptr);
+  REQUIRE(game->game != nullptr);
+  std::vector<std::unique_ptr<hanabi_learning_env::HanabiPolicy>> owned;
+  std::vector<const hanabi_learning_env::HanabiPolicy*> policy_ptrs;
+  for (int p = 0; p < policies_len; ++p) {
+    owned.push_back(hanabi_learning_env::MakePolicy(policies[p]));
+    REQUIRE(owned.back() != nullptr);
+    policy_ptrs.push_back(owned.back().get());
+  }
+  result->result = static_cast<void*>(
+      new hanabi_learning_env::HanabiRolloutResult(
+          hanabi_learning_env::RunRollouts(
+              *reinterpret_cast<hanabi_learning_env::HanabiGame*>(game->game),
+              policy_ptrs, num_games, record_trajectories)));
+  REQUIRE(result->result != nullptr);
+}
+
+void DeleteRolloutResult(pyhanabi_rollout_result_t* result) {
+  REQUIRE(result != nullptr);
+  REQUIRE(result->result != nullptr);
+  delete reinterpret_cast<hanabi_learning_env::HanabiRolloutResult*>(
+      result->result);
+  result->result = nullptr;
+}
+
+int RolloutNumGames(const pyhanabi_rollout_result_t* result) {
+  return RolloutResult(result).num_games;
+}
+
+int64_t RolloutNumMoves(const pyhanabi_rollout_result_t* result) {
+  return RolloutResult(result).num_moves;
+}
+
+int RolloutScoreHistogramSize(const pyhanabi_rollout_result_t* result) {
+  return RolloutResult(result).score_histogram.size();
+}
+
+void RolloutScoreHistogram(const pyhanabi_rollout_result_t* result,
+                           int64_t* score_histogram) {
+  REQUIRE(score_histogram != nullptr);
+  const auto& histogram = RolloutResult(result).score_histogram;
+  std::copy(histogram.begin(), histogram.end(), score_histogram);
+}
+
+int RolloutNumTrajectories(const pyhanabi_rollout_result_t* result) {
+  return RolloutResult(result).trajectories.size();
+}
+
+int RolloutTrajectoryStartPlayer(const pyhanabi_rollout_result_t* result,
+                                 int index) {
+  return RolloutResult(result).trajectories.at(index).start_player;
+}
+
+int RolloutTrajectoryScore(const pyhanabi_rollout_result_t* result,
+                           int index) {
+  return RolloutResult(result).trajectories.at(index).score;
+}
+
+int RolloutTrajectoryNumMoves(const pyhanabi_rollout_result_t* result,
+                              int index) {
+  return RolloutResult(result).trajectories.at(index).moves.size();
+}
+
+void RolloutTrajectoryMoves(const pyhanabi_rollout_result_t* result,
+                            int index, int* moves) {
+  REQUIRE(moves != nullptr);
+  const auto& trajectory = RolloutResult(result).trajectories.at(index);
+  std::copy(trajectory.moves.begin(), trajectory.moves.end(), moves);
+}
+
+int RolloutTrajectoryNumDeals(const pyhanabi_rollout_result_t* result,
+                              int index) {
+  return RolloutResult(result).trajectories.at(index).deals.size();
+}
+
+void RolloutTrajectoryDeals(const pyhanabi_rollout_result_t* result,
+                            int index, int* deals) {
+  REQUIRE(deals != nullptr);
+  const auto& trajectory = RolloutResult(result).trajectories.at(index);
+  std::copy(trajectory.deals.begin(), trajectory.deals.end(), deals);
+}
+
+void EvaluatePolicies(pyhanabi_game_t* game,
+                      const int policies_len,
+                      const char** policies,
+                      const int num_games,
+                      const uint64_t* deal_seeds,
+                      int* scores,
+                      double* mean_differences,
+                      double* difference_std_errors) {
+  REQUIRE(game != nullptr);
+  REQUIRE(game->game != nullptr);
+  REQUIRE(deal_seeds != nullptr && scores != nullptr);
+  REQUIRE(mean_differences != nullptr && difference_std_errors != nullptr);
+  std::vector<std::unique_ptr<hanabi_learning_env::HanabiPolicy>> owned;
+  std::vector<const hanabi_learning_env::HanabiPolicy*> policy_ptrs;
+  for (int p = 0; p < policies_len; ++p) {
+    owned.push_back(hanabi_learning_env::MakePolicy(policies[p]));
+    REQUIRE(owned.back() != nullptr);
+    policy_ptrs.push_back(owned.back().get());
+  }
+  const hanabi_learning_env::HanabiEvaluationResult result =
+      hanabi_learning_env::EvaluatePolicies(
+          *reinterpret_cast<hanabi_learning_env::HanabiGame*>(game->game),
+          policy_ptrs,
+          std::vector<uint64_t>(deal_seeds, deal_seeds + num_games));
+  for (int p = 0; p < policies_len; ++p) {
+    std::copy(result.scores[p].begin(), result.scores[p].end(),
+              scores + static_cast<int64_t>(p) * num_games);
+  }
+  std::copy(result.mean_differences.begin(), result.mean_differences.end(),
+            mean_differences);
+  std::copy(result.difference_std_errors.begin(),
+            result.difference_std_errors.end(), difference_std_errors);
+}
+
+/* Wrapper definitions for search. */
+void NewIsmcts(pyhanabi_ismcts_t* search,
+               const char* rollout_policy,
+               int64_t max_iterations,
+               double time_limit,
+               int max_nodes,
+               double exploration,
+               int num_threads,
+               uint64_t seed) {
+  REQUIRE(search != nullptr);
+  REQUIRE(rollout_policy != nullptr);
+  std::unique_ptr<hanabi_learning_env::HanabiPolicy> policy =
+      hanabi_learning_env::MakePolicy(rollout_policy);
+  REQUIRE(policy != nullptr);
+  hanabi_learning_env::IsmctsConfig config;
+  config.max_iterations = max_iterations;
+  config.time_limit = time_limit;
+  config.max_nodes = max_nodes;
+  config.exploration = exploration;
+  config.num_threads = num_threads;
+  config.seed = seed;
+  search->search = static_cast<void*>(
+      new IsmctsSearchHandle(config, std::move(policy)));
+  REQUIRE(search->search != nullptr);
+}
+
+void DeleteIsmcts(pyhanabi_ismcts_t* search) {
+  delete Ismcts(search);
+  search->search = nullptr;
+}
+
+void IsmctsSearch(pyhanabi_ismcts_t* search,
+                  pyhanabi_state_t* state,
+                  int64_t* visit_counts) {
+  REQUIRE(state != nullptr);
+  REQUIRE(state->state != nullptr);
+  REQUIRE(visit_counts != nullptr);
+  std::vector<int64_t> visits = Ismcts(search)->search.Search(
+      *reinterpret_cast<hanabi_learning_env::HanabiState*>(state->state));
+  std::copy(visits.begin(), visits.end(), visit_counts);
+}
+
+int64_t IsmctsNumIterations(const pyhanabi_ismcts_t* search) {
+  return Ismcts(search)->search.NumIterations();
+}
+
+void StateIsmctsSearch(pyhanabi_state_t* state,
+                       const char* rollout_policy,
+                       int64_t max_iterations,
+                       double time_limit,
+                       int max_nodes,
+                       double exploration,
+                       int num_threads,
+                       uint64_t seed,
+                       int64_t* visit_counts) {
+  pyhanabi_ismcts_t search;
+  NewIsmcts(&search, rollout_policy, max_iterations, time_limit, max_nodes,
+            exploration, num_threads, seed);
+  IsmctsSearch(&search, state, visit_counts);
+  DeleteIsmcts(&search);
+}
+
 void DeleteParallelEnv(pyhanabi_parallel_env_t* parallel_env) {
   REQUIRE(parallel_env != nullptr);
   REQUIRE(parallel_env->parallel_env != nullptr);
@@ -634,26 +971,6 @@ void NewParallelEnv(pyhanabi_parallel_env_t* parallel_env,
   REQUIRE(parallel_env->parallel_env != nullptr);
 }
 
-void _ParallelCopyBatchObservation(
-      pyhanabi_batch_observation_t* batch_observation,
-      hanabi_learning_env::HanabiParallelEnv* hanabi_parallel_env,
-      const int agent_id) {
-  REQUIRE(batch_observation->observation != nullptr);
-  REQUIRE(batch_observation->legal_moves != nullptr);
-  REQUIRE(batch_observation->done != nullptr);
-  REQUIRE(batch_observation->scores != nullptr);
-
-  const auto batch_obs = hanabi_parallel_env->ObserveAgent(agent_id);
-  std::copy(batch_obs.observation.begin(), batch_obs.observation.end(),
-      batch_observation->observation);
-  std::copy(batch_obs.legal_moves.begin(), batch_obs.legal_moves.end(),
-      batch_observation->legal_moves);
-  std::copy(batch_obs.scores.begin(), batch_obs.scores.end(),
-      batch_observation->scores);
-  std::copy(batch_obs.done.begin(), batch_obs.done.end(),
-      batch_observation->done);
-}
-
 void ParallelEnvReset(pyhanabi_parallel_env_t* parallel_env) {
   REQUIRE(parallel_env != nullptr);
   REQUIRE(parallel_env->parallel_env != nullptr);
@@ -663,6 +980,14 @@ void ParallelEnvReset(pyhanabi_parallel_env_t* parallel_env) {
   hanabi_parallel_env->Reset();
 }
 
+void ParallelSetIncrementalEncoding(pyhanabi_parallel_env_t* parallel_env,
+                                    int enable) {
+  REQUIRE(parallel_env != nullptr);
+  REQUIRE(parallel_env->parallel_env != nullptr);
+  reinterpret_cast<hanabi_learning_env::HanabiParallelEnv*>(
+      parallel_env->parallel_env)->SetIncrementalEncoding(enable != 0);
+}
+
 void ParallelParentGame(pyhanabi_game_t* parent_game,
                         const pyhanabi_parallel_env_t* parallel_env) {
   REQUIRE(parallel_env != nullptr);
@@ -691,6 +1016,12 @@ int ParallelObservationLength(const pyhanabi_parallel_env_t* parallel_env) {
             std::multiplies<int>());
 }
 
+int ParallelPackedObservationLength(
+    const pyhanabi_parallel_env_t* parallel_env) {
+  return reinterpret_cast<const hanabi_learning_env::HanabiParallelEnv*>(
+            parallel_env->parallel_env)->GetPackedObservationLength();
+}
+
 void ParallelApplyBatchMove(pyhanabi_parallel_env_t* parallel_env,
                             const int batch_move_len,
                             const int* batch_move,
@@ -700,11 +1031,40 @@ void ParallelApplyBatchMove(pyhanabi_parallel_env_t* parallel_env,
   auto hanabi_parallel_env =
       reinterpret_cast<hanabi_learning_env::HanabiParallelEnv*>(
           parallel_env->parallel_env);
+  REQUIRE(batch_move != nullptr);
+  REQUIRE(batch_move_len == hanabi_parallel_env->GetNumStates());
   std::vector<int> vec_batch_move;
   vec_batch_move.assign(batch_move, batch_move + (batch_move_len));
   hanabi_parallel_env->ApplyBatchMove(vec_batch_move, agent_id);
 }
 
+void ParallelLegalMovesMasks(const pyhanabi_parallel_env_t* parallel_env,
+                             const int agent_id,
+                             uint64_t* masks) {
+  REQUIRE(parallel_env != nullptr);
+  REQUIRE(parallel_env->parallel_env != nullptr);
+  REQUIRE(masks != nullptr);
+  reinterpret_cast<const hanabi_learning_env::HanabiParallelEnv*>(
+      parallel_env->parallel_env)->GetLegalMovesMasks(agent_id, masks);
+}
+
+int ParallelBeliefLength(const pyhanabi_parallel_env_t* parallel_env) {
+  REQUIRE(parallel_env != nullptr);
+  REQUIRE(parallel_env->parallel_env != nullptr);
+  return reinterpret_cast<const hanabi_learning_env::HanabiParallelEnv*>(
+      parallel_env->parallel_env)->GetBeliefLength();
+}
+
+void ParallelBeliefs(const pyhanabi_parallel_env_t* parallel_env,
+                     const int agent_id,
+                     float* beliefs) {
+  REQUIRE(parallel_env != nullptr);
+  REQUIRE(parallel_env->parallel_env != nullptr);
+  REQUIRE(beliefs != nullptr);
+  reinterpret_cast<const hanabi_learning_env::HanabiParallelEnv*>(
+      parallel_env->parallel_env)->GetBeliefs(agent_id, beliefs);
+}
+
 void ParallelResetStates(pyhanabi_parallel_env_t* parallel_env,
                          const int states_len,
                          const int* states,
@@ -717,17 +1077,256 @@ void ParallelResetStates(pyhanabi_parallel_env_t* parallel_env,
       parallel_env->parallel_env)->ResetStates(vec_states, current_agent_id);
 }
 
-void ParallelObserveAgent(pyhanabi_batch_observation_t* batch_observation,
-                          const pyhanabi_parallel_env_t* parallel_env,
-                          const int agent_id) {
+void ParallelStepAndObserve(pyhanabi_batch_observation_t* batch_observation,
+                            pyhanabi_parallel_env_t* parallel_env,
+                            const int batch_move_len,
+                            const int* batch_move,
+                            const int agent_id,
+                            int packed,
+                            int16_t* rewards,
+                            int16_t* final_scores,
+                            int16_t* episode_lengths) {
   REQUIRE(parallel_env != nullptr);
   REQUIRE(parallel_env->parallel_env != nullptr);
   REQUIRE(batch_observation != nullptr);
   auto hanabi_parallel_env =
       reinterpret_cast<hanabi_learning_env::HanabiParallelEnv*>(
           parallel_env->parallel_env);
-  _ParallelCopyBatchObservation(
-      batch_observation, hanabi_parallel_env, agent_id);
+  REQUIRE(batch_move != nullptr);
+  REQUIRE(batch_move_len == hanabi_parallel_env->GetNumStates());
+  hanabi_learning_env::HanabiParallelEnv::HanabiStepResultBuffers results;
+  results.rewards = rewards;
+  results.final_scores = final_scores;
+  results.episode_lengths = episode_lengths;
+  hanabi_parallel_env->StepAndObserve(
+      batch_move, agent_id, packed, BatchObservationBuffers(batch_observation),
+      results);
+}
+
+void ParallelObserveAgent(pyhanabi_batch_observation_t* batch_observation,
+                          const pyhanabi_parallel_env_t* parallel_env,
+                          const int agent_id) {
+  REQUIRE(parallel_env != nullptr);
+  REQUIRE(parallel_env->parallel_env != nullptr);
+  REQUIRE(batch_observation != nullptr);
+  reinterpret_cast<const hanabi_learning_env::HanabiParallelEnv*>(
+      parallel_env->parallel_env)->ObserveAgent(
+          agent_id, BatchObservationBuffers(batch_observation));
+}
+
+void ParallelObserveAgentPacked(
+    pyhanabi_batch_observation_t* batch_observation,
+    const pyhanabi_parallel_env_t* parallel_env,
+    const int agent_id) {
+  REQUIRE(parallel_env != nullptr);
+  REQUIRE(parallel_env->parallel_env != nullptr);
+  REQUIRE(batch_observation != nullptr);
+  reinterpret_cast<const hanabi_learning_env::HanabiParallelEnv*>(
+      parallel_env->parallel_env)->ObserveAgentPacked(
+          agent_id, BatchObservationBuffers(batch_observation));
+}
+
+/* Wrapper definitions for HanabiAsyncEnvPool. */
+void NewAsyncEnvPool(pyhanabi_async_env_pool_t* pool,
+                     const int param_list_len,
+                     const char** param_list,
+                     const int n_groups,
+                     const int states_per_group,
+                     int packed,
+                     const int threads_per_group) {
+  REQUIRE(pool != nullptr);
+  std::unordered_map<std::string, std::string> game_params;
+
+  for (int p = 0; p < param_list_len; p += 2) {
+    std::string key = param_list[p];
+    std::string value = param_list[p + 1];
+    game_params[key] = value;
+  }
+
+  pool->pool = static_cast<void*>(new hanabi_learning_env::HanabiAsyncEnvPool(
+      game_params, n_groups, states_per_group, packed, threads_per_group));
+  REQUIRE(pool->pool != nullptr);
+}
+
+void DeleteAsyncEnvPool(pyhanabi_async_env_pool_t* pool) {
+  REQUIRE(pool != nullptr);
+  REQUIRE(pool->pool != nullptr);
+  delete reinterpret_cast<hanabi_learning_env::HanabiAsyncEnvPool*>(
+      pool->pool);
+  pool->pool = nullptr;
+}
+
+int AsyncEnvPoolNumGroups(const pyhanabi_async_env_pool_t* pool) {
+  REQUIRE(pool != nullptr);
+  REQUIRE(pool->pool != nullptr);
+  return reinterpret_cast<const hanabi_learning_env::HanabiAsyncEnvPool*>(
+      pool->pool)->NumGroups();
+}
+
+int AsyncEnvPoolStatesPerGroup(const pyhanabi_async_env_pool_t* pool) {
+  REQUIRE(pool != nullptr);
+  REQUIRE(pool->pool != nullptr);
+  return reinterpret_cast<const hanabi_learning_env::HanabiAsyncEnvPool*>(
+      pool->pool)->StatesPerGroup();
+}
+
+void AsyncEnvPoolSend(pyhanabi_async_env_pool_t* pool,
+                      const int group,
+                      const int batch_move_len,
+                      const int* batch_move) {
+  REQUIRE(pool != nullptr);
+  REQUIRE(pool->pool != nullptr);
+  auto hanabi_pool =
+      reinterpret_cast<hanabi_learning_env::HanabiAsyncEnvPool*>(pool->pool);
+  REQUIRE(batch_move != nullptr);
+  REQUIRE(batch_move_len == hanabi_pool->StatesPerGroup());
+  hanabi_pool->Send(batch_move, group);
+}
+
+int AsyncEnvPoolRecv(pyhanabi_async_env_pool_t* pool) {
+  REQUIRE(pool != nullptr);
+  REQUIRE(pool->pool != nullptr);
+  return reinterpret_cast<hanabi_learning_env::HanabiAsyncEnvPool*>(
+      pool->pool)->Recv();
+}
+
+int AsyncEnvPoolCurrentAgent(const pyhanabi_async_env_pool_t* pool,
+                             const int group) {
+  REQUIRE(pool != nullptr);
+  REQUIRE(pool->pool != nullptr);
+  return reinterpret_cast<const hanabi_learning_env::HanabiAsyncEnvPool*>(
+      pool->pool)->CurrentAgent(group);
+}
+
+void AsyncEnvPoolGroupObservation(
+    pyhanabi_batch_observation_t* batch_observation,
+    const pyhanabi_async_env_pool_t* pool,
+    const int group) {
+  REQUIRE(pool != nullptr);
+  REQUIRE(pool->pool != nullptr);
+  REQUIRE(batch_observation != nullptr);
+  auto hanabi_pool =
+      reinterpret_cast<const hanabi_learning_env::HanabiAsyncEnvPool*>(
+          pool->pool);
+  const auto& buffers = hanabi_pool->Observation(group);
+  // A view on buffers owned by the pool, must not be passed to
+  // DeleteBatchObservation.
+  batch_observation->observation = buffers.observation;
+  batch_observation->legal_moves = buffers.legal_moves;
+  batch_observation->scores = buffers.scores;
+  batch_observation->done = buffers.done;
+  batch_observation->beliefs = nullptr;
+  batch_observation->observation_shape[0] = hanabi_pool->StatesPerGroup();
+  batch_observation->observation_shape[1] = hanabi_pool->ObservationLength();
+  batch_observation->legal_moves_shape[0] = hanabi_pool->StatesPerGroup();
+  batch_observation->legal_moves_shape[1] = hanabi_pool->GetGame().MaxMoves();
+}
+
+void AsyncEnvPoolGroupStepResults(pyhanabi_step_results_t* step_results,
+                                  const pyhanabi_async_env_pool_t* pool,
+                                  const int group) {
+  REQUIRE(pool != nullptr);
+  REQUIRE(pool->pool != nullptr);
+  REQUIRE(step_results != nullptr);
+  const auto& results =
+      reinterpret_cast<const hanabi_learning_env::HanabiAsyncEnvPool*>(
+          pool->pool)->StepResults(group);
+  step_results->rewards = results.rewards;
+  step_results->final_scores = results.final_scores;
+  step_results->episode_lengths = results.episode_lengths;
+}
+
+/* Wrapper definitions for HanabiBatchEngine. */
+void NewBatchEngine(pyhanabi_batch_engine_t* engine,
+                    const int param_list_len,
+                    const char** param_list,
+                    const int n_games) {
+  REQUIRE(engine != nullptr);
+  std::unordered_map<std::string, std::string> game_params;
+
+  for (int p = 0; p < param_list_len; p += 2) {
+    std::string key = param_list[p];
+    std::string value = param_list[p + 1];
+    game_params[key] = value;
+  }
+
+  engine->engine = static_cast<void*>(
+      new hanabi_learning_env::HanabiBatchEngine(game_params, n_games));
+  REQUIRE(engine->engine != nullptr);
+}
+
+void DeleteBatchEngine(pyhanabi_batch_engine_t* engine) {
+  delete BatchEngine(engine);
+  engine->engine = nullptr;
+}
+
+int BatchEngineNumGames(const pyhanabi_batch_engine_t* engine) {
+  return BatchEngine(engine)->NumGames();
+}
+
+int BatchEngineObservationLength(const pyhanabi_batch_engine_t* engine) {
+  return BatchEngine(engine)->ObservationLength();
+}
+
+int BatchEngineMaxMoves(const pyhanabi_batch_engine_t* engine) {
+  return BatchEngine(engine)->GetGame().MaxMoves();
+}
+
+int BatchEngineCurPlayer(const pyhanabi_batch_engine_t* engine,
+                         const int game) {
+  const auto hanabi_engine = BatchEngine(engine);
+  REQUIRE(game >= 0 && game < hanabi_engine->NumGames());
+  return hanabi_engine->CurPlayer(game);
+}
+
+void BatchEngineReset(pyhanabi_batch_engine_t* engine) {
+  BatchEngine(engine)->Reset();
+}
+
+void BatchEngineObserve(const pyhanabi_batch_engine_t* engine,
+                        int8_t* observation,
+                        int8_t* legal_moves,
+                        int16_t* scores,
+                        int8_t* done) {
+  hanabi_learning_env::HanabiParallelEnv::HanabiBatchObservationBuffers
+      buffers;
+  buffers.observation = observation;
+  buffers.legal_moves = legal_moves;
+  buffers.scores = scores;
+  buffers.done = done;
+  BatchEngine(engine)->Observe(buffers);
+}
+
+void BatchEngineStepAndObserve(pyhanabi_batch_engine_t* engine,
+                               const int batch_move_len,
+                               const int* batch_move,
+                               int8_t* observation,
+                               int8_t* legal_moves,
+                               int16_t* scores,
+                               int8_t* done,
+                               int16_t* rewards,
+                               int16_t* final_scores,
+                               int16_t* episode_lengths) {
+  const auto hanabi_engine = BatchEngine(engine);
+  REQUIRE(batch_move != nullptr);
+  REQUIRE(batch_move_len == hanabi_engine->NumGames());
+  hanabi_learning_env::HanabiParallelEnv::HanabiBatchObservationBuffers
+      buffers;
+  buffers.observation = observation;
+  buffers.legal_moves = legal_moves;
+  buffers.scores = scores;
+  buffers.done = done;
+  hanabi_learning_env::HanabiParallelEnv::HanabiStepResultBuffers results;
+  results.rewards = rewards;
+  results.final_scores = final_scores;
+  results.episode_lengths = episode_lengths;
+  hanabi_engine->StepAndObserve(batch_move, buffers, results);
+}
+
+void BatchEngineLegalMovesMasks(const pyhanabi_batch_engine_t* engine,
+                                uint64_t* masks) {
+  REQUIRE(masks != nullptr);
+  BatchEngine(engine)->LegalMovesMasks(masks);
 }
 
 void NewBatchObservation(pyhanabi_batch_observation_t* batch_observation,
@@ -739,37 +1338,38 @@ void NewBatchObservation(pyhanabi_batch_observation_t* batch_observation,
   const auto hanabi_parallel_env =
       reinterpret_cast<const hanabi_learning_env::HanabiParallelEnv*>(
           parallel_env->parallel_env);
-  const int n_states = hanabi_parallel_env->GetNumStates();
-  const auto obs_shape = hanabi_parallel_env->GetObservationShape();
-  const int obs_len = std::accumulate(obs_shape.begin(), obs_shape.end(), 1,
-      std::multiplies<int>());
-  const int max_moves = hanabi_parallel_env->GetGame().MaxMoves();
+  AllocateBatchObservation(batch_observation, hanabi_parallel_env,
+                           hanabi_parallel_env->GetObservationFlatLength());
+}
 
-  REQUIRE(n_states > 0);
-  REQUIRE(obs_len > 0);
-  REQUIRE(max_moves > 0);
-  batch_observation->observation_shape[0] = n_states;
-  batch_observation->legal_moves_shape[0] = n_states;
-  batch_observation->observation_shape[1] = obs_len;
-  batch_observation->legal_moves_shape[1] = max_moves;
-  REQUIRE(batch_observation->observation_shape[0] == n_states);
-  REQUIRE(batch_observation->legal_moves_shape[0] == n_states);
-  REQUIRE(batch_observation->observation_shape[1] == obs_len);
-  REQUIRE(batch_observation->legal_moves_shape[1] == max_moves);
+void NewPackedBatchObservation(pyhanabi_batch_observation_t* batch_observation,
+                               const pyhanabi_parallel_env_t* parallel_env) {
+  REQUIRE(batch_observation != nullptr);
+  REQUIRE(parallel_env != nullptr);
+  REQUIRE(parallel_env->parallel_env != nullptr);
 
-  batch_observation->observation = (int8_t*) malloc(sizeof(int8_t)
-      * batch_observation->observation_shape[0]
-      * batch_observation->observation_shape[1]);
-  batch_observation->legal_moves = (int8_t*) malloc(sizeof(int8_t)
-      * batch_observation->legal_moves_shape[0]
-      * batch_observation->legal_moves_shape[1]);
-  batch_observation->scores = (int16_t*) malloc(sizeof(int16_t) * n_states);
-  batch_observation->done = (int8_t*) malloc(sizeof(int8_t) * n_states);
+  const auto hanabi_parallel_env =
+      reinterpret_cast<const hanabi_learning_env::HanabiParallelEnv*>(
+          parallel_env->parallel_env);
+  AllocateBatchObservation(batch_observation, hanabi_parallel_env,
+                           hanabi_parallel_env->GetPackedObservationLength());
+}
 
-  REQUIRE(batch_observation->scores != nullptr);
-  REQUIRE(batch_observation->legal_moves != nullptr);
-  REQUIRE(batch_observation->done != nullptr);
-  REQUIRE(batch_observation->observation != nullptr);
+void BatchObservationAddBeliefs(
+    pyhanabi_batch_observation_t* batch_observation,
+    const pyhanabi_parallel_env_t* parallel_env) {
+  REQUIRE(batch_observation != nullptr);
+  REQUIRE(parallel_env != nullptr);
+  REQUIRE(parallel_env->parallel_env != nullptr);
+  REQUIRE(batch_observation->beliefs == nullptr);
+
+  const auto hanabi_parallel_env =
+      reinterpret_cast<const hanabi_learning_env::HanabiParallelEnv*>(
+          parallel_env->parallel_env);
+  batch_observation->beliefs = (float*) CacheAlignedMalloc(
+      sizeof(float) * hanabi_parallel_env->GetNumStates()
+      * hanabi_parallel_env->GetBeliefLength());
+  REQUIRE(batch_observation->beliefs != nullptr);
 }
 
 void DeleteBatchObservation(pyhanabi_batch_observation_t* batch_observation) {
@@ -782,6 +1382,8 @@ void DeleteBatchObservation(pyhanabi_batch_observation_t* batch_observation) {
     free(batch_observation->scores);
   if (batch_observation->done != nullptr)
     free(batch_observation->done);
+  if (batch_observation->beliefs != nullptr)
+    free(batch_observation->beliefs);
 }
 
 /* Wrapper definitions for HanabiObservation. */
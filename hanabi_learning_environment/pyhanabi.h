@@ -60,6 +60,33 @@ typedef struct PyHanabiParallelEnv {
   void* parallel_env;
 } pyhanabi_parallel_env_t;
 
+typedef struct PyHanabiAsyncEnvPool {
+  /* Points to a hanabi_learning_env::HanabiAsyncEnvPool. */
+  void* pool;
+} pyhanabi_async_env_pool_t;
+
+typedef struct PyHanabiBatchEngine {
+  /* Points to a hanabi_learning_env::HanabiBatchEngine. */
+  void* engine;
+} pyhanabi_batch_engine_t;
+
+typedef struct PyHanabiIsmcts {
+  /* Points to a hanabi_learning_env::HanabiIsmcts and its rollout policy. */
+  void* search;
+} pyhanabi_ismcts_t;
+
+typedef struct PyHanabiStepResults {
+  /* Point to buffers owned by the environment. */
+  int16_t* rewards;
+  int16_t* final_scores;
+  int16_t* episode_lengths;
+} pyhanabi_step_results_t;
+
+typedef struct PyHanabiRolloutResult {
+  /* Points to a hanabi_learning_env::HanabiRolloutResult. */
+  void* result;
+} pyhanabi_rollout_result_t;
+
 typedef struct PyHanabiObservation {
   /* Points to a hanabi_learning_env::HanabiObservation. */
   void* observation;
@@ -71,6 +98,8 @@ typedef struct PyHanabiBatchObservation {
   int8_t* legal_moves;
   int16_t* scores;
   int8_t* done;
+  /* Card beliefs, n states x belief length, NULL unless requested. */
+  float* beliefs;
   int observation_shape[2];
   int legal_moves_shape[2];
 } pyhanabi_batch_observation_t;
@@ -126,12 +155,16 @@ int HistoryItemDealToPlayer(pyhanabi_history_item_t* item);
 
 /* State functions. */
 void NewState(pyhanabi_game_t* game, pyhanabi_state_t* state);
+void NewSeededState(pyhanabi_game_t* game, uint64_t deal_seed,
+                    pyhanabi_state_t* state);
 void CopyState(const pyhanabi_state_t* src, pyhanabi_state_t* dest);
 void DeleteState(pyhanabi_state_t* state);
 const void* StateParentGame(pyhanabi_state_t* state);
 void StateApplyMove(pyhanabi_state_t* state, pyhanabi_move_t* move);
 int StateCurPlayer(pyhanabi_state_t* state);
 void StateDealRandomCard(pyhanabi_state_t* state);
+void StateSetDirectDeal(pyhanabi_state_t* state, int enabled);
+int StateDirectDeal(pyhanabi_state_t* state);
 int StateDeckSize(pyhanabi_state_t* state);
 int StateFireworks(pyhanabi_state_t* state, int color);
 int StateDiscardPileSize(pyhanabi_state_t* state);
@@ -145,6 +178,8 @@ void* StateLegalMoves(pyhanabi_state_t* state);
 int StateLifeTokens(pyhanabi_state_t* state);
 int StateNumPlayers(pyhanabi_state_t* state);
 int StateScore(pyhanabi_state_t* state);
+uint64_t StateHash(pyhanabi_state_t* state);
+uint64_t StateCanonicalKey(pyhanabi_state_t* state);
 char* StateToString(pyhanabi_state_t* state);
 bool MoveIsLegal(const pyhanabi_state_t* state, const pyhanabi_move_t* move);
 bool CardPlayableOnFireworks(const pyhanabi_state_t* state, int color,
@@ -171,6 +206,67 @@ int GetMoveUid(pyhanabi_game_t* game, pyhanabi_move_t* move);
 void GetMoveByUid(pyhanabi_game_t* game, int move_uid, pyhanabi_move_t* move);
 int MaxMoves(pyhanabi_game_t* game);
 
+/* Rollout functions. */
+int IsPolicyName(const char* name);
+void NewRollouts(pyhanabi_rollout_result_t* result,
+                 pyhanabi_game_t* game,
+                 const int policies_len,
+                 const char** policies,
+                 const int num_games,
+                 int record_trajectories);
+void DeleteRolloutResult(pyhanabi_rollout_result_t* result);
+int RolloutNumGames(const pyhanabi_rollout_result_t* result);
+int64_t RolloutNumMoves(const pyhanabi_rollout_result_t* result);
+int RolloutScoreHistogramSize(const pyhanabi_rollout_result_t* result);
+void RolloutScoreHistogram(const pyhanabi_rollout_result_t* result,
+                           int64_t* score_histogram);
+int RolloutNumTrajectories(const pyhanabi_rollout_result_t* result);
+int RolloutTrajectoryStartPlayer(const pyhanabi_rollout_result_t* result,
+                                 int index);
+int RolloutTrajectoryScore(const pyhanabi_rollout_result_t* result,
+                           int index);
+int RolloutTrajectoryNumMoves(const pyhanabi_rollout_result_t* result,
+                              int index);
+void RolloutTrajectoryMoves(const pyhanabi_rollout_result_t* result,
+                            int index, int* moves);
+int RolloutTrajectoryNumDeals(const pyhanabi_rollout_result_t* result,
+                              int index);
+void RolloutTrajectoryDeals(const pyhanabi_rollout_result_t* result,
+                            int index, int* deals);
+void EvaluatePolicies(pyhanabi_game_t* game,
+                      const int policies_len,
+                      const char** policies,
+                      const int num_games,
+                      const uint64_t* deal_seeds,
+                      int* scores,
+                      double* mean_differences,
+                      double* difference_std_errors);
+
+/* Search functions. A search keeps its trees across calls of IsmctsSearch;
+ * StateIsmctsSearch builds a new one on every call. */
+void NewIsmcts(pyhanabi_ismcts_t* search,
+               const char* rollout_policy,
+               int64_t max_iterations,
+               double time_limit,
+               int max_nodes,
+               double exploration,
+               int num_threads,
+               uint64_t seed);
+void DeleteIsmcts(pyhanabi_ismcts_t* search);
+void IsmctsSearch(pyhanabi_ismcts_t* search,
+                  pyhanabi_state_t* state,
+                  int64_t* visit_counts);
+int64_t IsmctsNumIterations(const pyhanabi_ismcts_t* search);
+void StateIsmctsSearch(pyhanabi_state_t* state,
+                       const char* rollout_policy,
+                       int64_t max_iterations,
+                       double time_limit,
+                       int max_nodes,
+                       double exploration,
+                       int num_threads,
+                       uint64_t seed,
+                       int64_t* visit_counts);
+
 /* Parallel Game functions */
 void DeleteParallelEnv(pyhanabi_parallel_env_t* parallel_env);
 void NewParallelEnv(pyhanabi_parallel_env_t* parallel_env,
@@ -178,26 +274,111 @@ void NewParallelEnv(pyhanabi_parallel_env_t* parallel_env,
                      const char** param_list,
                      const int n_states);
 void ParallelEnvReset(pyhanabi_parallel_env_t* parallel_env);
+void ParallelSetIncrementalEncoding(pyhanabi_parallel_env_t* parallel_env,
+                                    int enable);
 int ParallelMaxMoves(const pyhanabi_parallel_env_t* parallel_env);
 void ParallelParentGame(pyhanabi_game_t* parent_game,
                         const pyhanabi_parallel_env_t* parallel_env);
 int ParallelNumStates(const pyhanabi_parallel_env_t* parallel_env);
 int ParallelObservationLength(const pyhanabi_parallel_env_t* parallel_env);
+int ParallelPackedObservationLength(
+    const pyhanabi_parallel_env_t* parallel_env);
 void ParallelApplyBatchMove(pyhanabi_parallel_env_t* parallel_env,
                             const int batch_move_len,
                             const int* batch_move,
                             const int agent_id);
+void ParallelStepAndObserve(pyhanabi_batch_observation_t* batch_observation,
+                            pyhanabi_parallel_env_t* parallel_env,
+                            const int batch_move_len,
+                            const int* batch_move,
+                            const int agent_id,
+                            int packed,
+                            int16_t* rewards,
+                            int16_t* final_scores,
+                            int16_t* episode_lengths);
 void ParallelObserveAgent(pyhanabi_batch_observation_t* batch_observation,
                           const pyhanabi_parallel_env_t* parallel_env,
                           const int agent_id);
+void ParallelObserveAgentPacked(
+    pyhanabi_batch_observation_t* batch_observation,
+    const pyhanabi_parallel_env_t* parallel_env,
+    const int agent_id);
+void ParallelLegalMovesMasks(const pyhanabi_parallel_env_t* parallel_env,
+                             const int agent_id,
+                             uint64_t* masks);
+int ParallelBeliefLength(const pyhanabi_parallel_env_t* parallel_env);
+void ParallelBeliefs(const pyhanabi_parallel_env_t* parallel_env,
+                     const int agent_id,
+                     float* beliefs);
 void ParallelResetStates(pyhanabi_parallel_env_t* parallel_env,
                          const int states_len,
                          const int* states,
                          const int current_agent_id);
 
+/* Asynchronous environment pool functions. */
+void NewAsyncEnvPool(pyhanabi_async_env_pool_t* pool,
+                     const int param_list_len,
+                     const char** param_list,
+                     const int n_groups,
+                     const int states_per_group,
+                     int packed,
+                     const int threads_per_group);
+void DeleteAsyncEnvPool(pyhanabi_async_env_pool_t* pool);
+int AsyncEnvPoolNumGroups(const pyhanabi_async_env_pool_t* pool);
+int AsyncEnvPoolStatesPerGroup(const pyhanabi_async_env_pool_t* pool);
+void AsyncEnvPoolSend(pyhanabi_async_env_pool_t* pool,
+                      const int group,
+                      const int batch_move_len,
+                      const int* batch_move);
+int AsyncEnvPoolRecv(pyhanabi_async_env_pool_t* pool);
+int AsyncEnvPoolCurrentAgent(const pyhanabi_async_env_pool_t* pool,
+                             const int group);
+void AsyncEnvPoolGroupObservation(
+    pyhanabi_batch_observation_t* batch_observation,
+    const pyhanabi_async_env_pool_t* pool,
+    const int group);
+void AsyncEnvPoolGroupStepResults(pyhanabi_step_results_t* step_results,
+                                  const pyhanabi_async_env_pool_t* pool,
+                                  const int group);
+
+/* Batch engine functions. Buffers are caller-owned, see HanabiBatchEngine. */
+void NewBatchEngine(pyhanabi_batch_engine_t* engine,
+                    const int param_list_len,
+                    const char** param_list,
+                    const int n_games);
+void DeleteBatchEngine(pyhanabi_batch_engine_t* engine);
+int BatchEngineNumGames(const pyhanabi_batch_engine_t* engine);
+int BatchEngineObservationLength(const pyhanabi_batch_engine_t* engine);
+int BatchEngineMaxMoves(const pyhanabi_batch_engine_t* engine);
+int BatchEngineCurPlayer(const pyhanabi_batch_engine_t* engine,
+                         const int game);
+void BatchEngineReset(pyhanabi_batch_engine_t* engine);
+void BatchEngineObserve(const pyhanabi_batch_engine_t* engine,
+                        int8_t* observation,
+                        int8_t* legal_moves,
+                        int16_t* scores,
+                        int8_t* done);
+void BatchEngineStepAndObserve(pyhanabi_batch_engine_t* engine,
+                               const int batch_move_len,
+                               const int* batch_move,
+                               int8_t* observation,
+                               int8_t* legal_moves,
+                               int16_t* scores,
+                               int8_t* done,
+                               int16_t* rewards,
+                               int16_t* final_scores,
+                               int16_t* episode_lengths);
+void BatchEngineLegalMovesMasks(const pyhanabi_batch_engine_t* engine,
+                                uint64_t* masks);
+
 /* BatchObservation functions. */
 void NewBatchObservation(pyhanabi_batch_observation_t* batch_observation,
                          const pyhanabi_parallel_env_t* parallel_env);
+void NewPackedBatchObservation(pyhanabi_batch_observation_t* batch_observation,
+                               const pyhanabi_parallel_env_t* parallel_env);
+void BatchObservationAddBeliefs(
+    pyhanabi_batch_observation_t* batch_observation,
+    const pyhanabi_parallel_env_t* parallel_env);
 void DeleteBatchObservation(pyhanabi_batch_observation_t* batch_observation);
 
 /* Observation functions. */
@@ -154,6 +154,28 @@ def color_char_to_idx(color_char):
         color_char, COLOR_CHAR))
 
 
+def check_policy_names(policies, num_players=None):
+  """Helper function for checking names of native policies.
+
+  Args:
+    policies: list of policy names, see HanabiGame.rollouts.
+    num_players: if not None, the list must have one name or one per player.
+
+  Raises:
+    ValueError: If a name is not a native policy, or the list has the wrong
+      length.
+  """
+  if num_players is not None and len(policies) not in (1, num_players):
+    raise ValueError("Expected 1 or {} policies, got {}.".format(
+        num_players, len(policies)))
+  if not policies:
+    raise ValueError("Expected at least one policy.")
+  for policy in policies:
+    if not isinstance(policy, str) or not lib.IsPolicyName(
+        policy.encode('ascii')):
+      raise ValueError("Unknown policy: {}.".format(policy))
+
+
 class HanabiCard(object):
   """Hanabi card, with a color and a rank.
 
@@ -503,19 +525,25 @@ class HanabiState(object):
   Python wrapper of C++ HanabiState class.
   """
 
-  def __init__(self, game, c_state=None):
+  def __init__(self, game, c_state=None, deal_seed=None):
     """Returns a new state.
 
     Args:
       game: HanabiGame describing the parameters for a game of Hanabi.
       c_state: C++ state to copy, or None for a new state.
+      deal_seed: for a new state, seed fixing its start player and deck order
+        (see HanabiGame.new_initial_state), or None to draw them from the
+        game's random number generator.
 
     NOTE: If c_state is supplied, game is ignored and c_state game is used.
     """
     self._state = ffi.new("pyhanabi_state_t*")
     if c_state is None:
       self._game = game.c_game
-      lib.NewState(self._game, self._state)
+      if deal_seed is None:
+        lib.NewState(self._game, self._state)
+      else:
+        lib.NewSeededState(self._game, deal_seed, self._state)
     else:
       self._game = lib.StateParentGame(c_state)
       lib.CopyState(c_state, self._state)
@@ -569,6 +597,20 @@ class HanabiState(object):
     """If cur_player == CHANCE_PLAYER_ID, make a random card-deal move."""
     lib.StateDealRandomCard(self._state)
 
+  def set_direct_deal(self, enabled):
+    """Sets whether plays and discards deal the replacing card themselves.
+
+    In direct-deal mode, apply_move deals the cards due after a play or
+    discard, so cur_player() is never CHANCE_PLAYER_ID between player moves.
+    Enabling it deals the cards due right away, e.g. the initial hands. Deals
+    are drawn and recorded in the history as deal_random_card would.
+    """
+    lib.StateSetDirectDeal(self._state, int(enabled))
+
+  def direct_deal(self):
+    """Returns whether the state is in direct-deal mode."""
+    return bool(lib.StateDirectDeal(self._state))
+
   def player_hands(self):
     """Returns a list of all hands, with cards ordered oldest to newest."""
     hand_list = []
@@ -635,6 +677,55 @@ class HanabiState(object):
     """
     return lib.StateScore(self._state)
 
+  def ismcts(self, max_iterations=1000, time_limit=0.0, max_nodes=1 << 20,
+             exploration=0.1, rollout_policy="random", num_threads=0, seed=0):
+    """Searches the current player's move with native ISMCTS.
+
+    The cards of the current player are drawn anew from what the player knows
+    on every iteration, so the search does not cheat. Threads grow separate
+    trees whose root visits are added up.
+
+    Every call allocates the trees of a new search. To keep them across
+    searches, use a HanabiIsmcts object instead.
+
+    Args:
+      max_iterations: iterations over all threads, 0 for no limit.
+      time_limit: wall-clock limit in seconds, 0 for none.
+      max_nodes: nodes of the tree of each thread.
+      exploration: UCB exploration constant, rewards are in [0, 1].
+      rollout_policy: name of the native policy playing out games, see
+        HanabiGame.rollouts.
+      num_threads: number of threads, 0 for all cores.
+      seed: unsigned 64-bit seed of the random streams of the search.
+
+    Returns:
+      numpy int64 array of length max_moves, element uid is the number of
+      visits to the move with that uid.
+
+    Raises:
+      ValueError: If rollout_policy is not a native policy.
+    """
+    check_policy_names([rollout_policy])
+    visits = np.zeros(lib.MaxMoves(self._game), dtype=np.int64)
+    lib.StateIsmctsSearch(self._state,
+                          ffi.new("char[]", rollout_policy.encode('ascii')),
+                          max_iterations, time_limit, max_nodes, exploration,
+                          num_threads, seed,
+                          ffi.cast("int64_t*", visits.ctypes.data))
+    return visits
+
+  def zobrist_hash(self):
+    """Returns a 64-bit hash of the position, for transposition tables.
+
+    Hands, card knowledge, fireworks, tokens, deck and discard counts and the
+    current player are hashed; the move history is not.
+    """
+    return lib.StateHash(self._state)
+
+  def canonical_key(self):
+    """Returns a hash shared by positions which only differ by their colors."""
+    return lib.StateCanonicalKey(self._state)
+
   def move_history(self):
     """Returns list of moves made, from oldest to most recent."""
     history = []
@@ -712,8 +803,16 @@ class HanabiGame(object):
       self._game = ffi.new("pyhanabi_game_t*")
       lib.NewGame(self._game, len(param_list), c_array)
 
-  def new_initial_state(self):
-    return HanabiState(self)
+  def new_initial_state(self, deal_seed=None):
+    """Returns the start of a new game.
+
+    Args:
+      deal_seed: if not None, an integer in [0, 2**64) fixing the start player
+        and the whole deck order of the game: the state deals from its own
+        random stream seeded with it, and the k-th card dealt does not depend
+        on the moves made. Games with the same deal seed deal the same cards.
+    """
+    return HanabiState(self, deal_seed=deal_seed)
 
   @property
   def c_game(self):
@@ -788,6 +887,112 @@ class HanabiGame(object):
     lib.GetMoveByUid(self._game, move_uid, move)
     return HanabiMove(move)
 
+  def rollouts(self, policies, num_games, record_trajectories=False):
+    """Plays games with native policies on all cores.
+
+    Game i deals its cards and draws its random moves from streams derived
+    from the game seed and i only, so results do not depend on the number of
+    threads.
+
+    Args:
+      policies: name of the policy played by every player, or a list with one
+        name per player. Built-in policies are "random" (uniformly random
+        legal move) and "simple" (port of agents/simple_agent.py).
+      num_games: number of games to play.
+      record_trajectories: whether to return the trajectory of every game.
+
+    Returns:
+      A dict with
+        "score_histogram": numpy int64 array, element s is the number of games
+          which ended with score s, for s = 0 ... max score,
+        "num_moves": total number of moves made by players,
+        "trajectories": if record_trajectories, a list with one dict per game
+          with keys "start_player", "score", "moves" (move uids in order) and
+          "deals" (chance outcome uids in order), else None.
+
+    Raises:
+      ValueError: If a name is not a native policy, or there is neither one
+        policy nor one per player.
+    """
+    if isinstance(policies, str):
+      policies = [policies]
+    check_policy_names(policies, self.num_players())
+    c_policies = [ffi.new("char[]", policy.encode('ascii'))
+                  for policy in policies]
+    c_array = ffi.new("char * [" + str(len(c_policies)) + "]", c_policies)
+    result = ffi.new("pyhanabi_rollout_result_t*")
+    lib.NewRollouts(result, self._game, len(c_policies), c_array, num_games,
+                    int(record_trajectories))
+    score_histogram = np.zeros(lib.RolloutScoreHistogramSize(result),
+                               dtype=np.int64)
+    lib.RolloutScoreHistogram(result,
+                              ffi.cast("int64_t*",
+                                       score_histogram.ctypes.data))
+    trajectories = None
+    if record_trajectories:
+      trajectories = []
+      for index in range(lib.RolloutNumTrajectories(result)):
+        moves = ffi.new("int[]", lib.RolloutTrajectoryNumMoves(result, index))
+        lib.RolloutTrajectoryMoves(result, index, moves)
+        deals = ffi.new("int[]", lib.RolloutTrajectoryNumDeals(result, index))
+        lib.RolloutTrajectoryDeals(result, index, deals)
+        trajectories.append({
+            "start_player": lib.RolloutTrajectoryStartPlayer(result, index),
+            "score": lib.RolloutTrajectoryScore(result, index),
+            "moves": list(moves),
+            "deals": list(deals)})
+    num_moves = lib.RolloutNumMoves(result)
+    lib.DeleteRolloutResult(result)
+    return {"score_histogram": score_histogram,
+            "num_moves": num_moves,
+            "trajectories": trajectories}
+
+
+  def evaluate(self, policies, deal_seeds):
+    """Compares native policies on the same deals, on all cores.
+
+    Every policy plays the game of every deal seed (see new_initial_state)
+    as all players, with the same random stream for the policies of a game.
+    Score differences are paired game by game, which removes the luck of the
+    deal from them: far fewer games tell policies apart than with
+    independent evaluations.
+
+    Args:
+      policies: list of policy names, see rollouts. Differences are taken
+        against the first one.
+      deal_seeds: list of deal seeds, one per game.
+
+    Returns:
+      A dict with
+        "scores": numpy int32 array of shape [len(policies), len(deal_seeds)],
+        "mean_scores": numpy float64 array, mean score of every policy,
+        "mean_differences": numpy float64 array, mean of the paired score
+          differences with the first policy,
+        "difference_std_errors": numpy float64 array, their standard errors.
+
+    Raises:
+      ValueError: If policies is empty or has a name which is not a native
+        policy.
+    """
+    check_policy_names(policies)
+    c_policies = [ffi.new("char[]", policy.encode('ascii'))
+                  for policy in policies]
+    c_array = ffi.new("char * [" + str(len(c_policies)) + "]", c_policies)
+    num_games = len(deal_seeds)
+    c_seeds = ffi.new("uint64_t[]", list(deal_seeds))
+    scores = np.zeros((len(policies), num_games), dtype=np.int32)
+    mean_differences = np.zeros(len(policies), dtype=np.float64)
+    difference_std_errors = np.zeros(len(policies), dtype=np.float64)
+    lib.EvaluatePolicies(self._game, len(c_policies), c_array, num_games,
+                         c_seeds, ffi.cast("int*", scores.ctypes.data),
+                         ffi.cast("double*", mean_differences.ctypes.data),
+                         ffi.cast("double*",
+                                  difference_std_errors.ctypes.data))
+    return {"scores": scores,
+            "mean_scores": scores.mean(axis=1),
+            "mean_differences": mean_differences,
+            "difference_std_errors": difference_std_errors}
+
 
 class HanabiParallelEnv(object):
   """Parallel game states for a single instance of Hanabi.
@@ -820,14 +1025,34 @@ class HanabiParallelEnv(object):
                            (n states x max moves).
     - scores            -- scores earned in each state (n states).
     - done              -- indicates whether the states are terminal (n states).
+    - beliefs           -- card beliefs of the observing agent if requested,
+                           see HanabiParallelEnv.beliefs, None otherwise.
+
+    If packed is True, batch_observation holds the observations bit-packed
+    into uint8 (n states x ceil(vectorized observation length / 8)), in
+    little-endian bit order. Unpack with
+    np.unpackbits(batch_observation, axis=1, count=obs_len, bitorder='little').
 
     Do not instantiate HanabiBatchObservation directly. Instead, use
     HanabiParallelEnv.last_observation, in which case it is created and managed
     by HanabiParallelEnv.
     """
-    def __init__(self, parallel_env):
+    def __init__(self, parallel_env, packed=False, beliefs=False):
       self._observation = ffi.new("pyhanabi_batch_observation_t*")
-      lib.NewBatchObservation(self._observation, parallel_env)
+      self.packed = packed
+      if packed:
+        lib.NewPackedBatchObservation(self._observation, parallel_env)
+      else:
+        lib.NewBatchObservation(self._observation, parallel_env)
+      self.beliefs = None
+      if beliefs:
+        lib.BatchObservationAddBeliefs(self._observation, parallel_env)
+        belief_len = lib.ParallelBeliefLength(parallel_env)
+        self.beliefs = self._asarray(
+            self._observation.beliefs,
+            self._observation.observation_shape[0] * belief_len,
+            np.float32).reshape(
+                (self._observation.observation_shape[0], belief_len))
       self.n_states, self.obs_len, self.max_moves = (
           self._observation.observation_shape[0],
           self._observation.observation_shape[1],
@@ -835,7 +1060,8 @@ class HanabiParallelEnv(object):
       self.batch_observation = self._asarray(
           self._observation.observation,
           self.n_states * self.obs_len,
-          np.int8).reshape((self.n_states, self.obs_len))
+          np.uint8 if packed else np.int8).reshape(
+              (self.n_states, self.obs_len))
       self.legal_moves = self._asarray(
           self._observation.legal_moves,
           self.n_states * self.max_moves,
@@ -857,12 +1083,17 @@ class HanabiParallelEnv(object):
         self._observation = None
       del self
 
-  def __init__(self, params=None, n_states=1):
+  def __init__(self, params=None, n_states=1, packed_observations=False,
+               beliefs=False):
     """Creates a HanabiParallelEnv object.
 
     Args:
       params: is a dictionary of parameters and their values.
       n_states: number of parallel states.
+      packed_observations: whether observations are bit-packed, 8 bits per
+        byte (see HanabiBatchObservation).
+      beliefs: whether observations include the card beliefs of the
+        observing agent, in last_observation.beliefs.
 
     Possible parameters include
     "players": 2 <= number of players <= 5
@@ -895,7 +1126,10 @@ class HanabiParallelEnv(object):
       self.parent_game = HanabiParallelEnv.ParentGame()
       lib.ParallelParentGame(self.parent_game._game, self._parallel_env)
       self.last_observation = HanabiParallelEnv.HanabiBatchObservation(
-              self._parallel_env)
+              self._parallel_env, packed_observations, beliefs)
+      self.rewards = np.zeros(n_states, dtype=np.int16)
+      self.final_scores = np.zeros(n_states, dtype=np.int16)
+      self.episode_lengths = np.zeros(n_states, dtype=np.int16)
 
   def num_states(self):
     """Get number of parallel states."""
@@ -905,6 +1139,10 @@ class HanabiParallelEnv(object):
     """Length of a single flat encoded observation."""
     return lib.ParallelObservationLength(self._parallel_env)
 
+  def packed_observation_len(self):
+    """Number of bytes of a single bit-packed encoded observation."""
+    return lib.ParallelPackedObservationLength(self._parallel_env)
+
   def reset(self):
     """Reset the environment.
     Reset all states to initial and write an initial observation into
@@ -913,6 +1151,15 @@ class HanabiParallelEnv(object):
     lib.ParallelEnvReset(self._parallel_env)
     self.observe_agent(0)
 
+  def set_incremental_encoding(self, enable):
+    """Switch incremental observation encoding on or off.
+
+    When on, observations are not re-encoded from scratch; only the bits
+    changed by the moves since an agent's last observation are updated.
+    Costs n states x num players x observation length bytes of memory.
+    """
+    lib.ParallelSetIncrementalEncoding(self._parallel_env, int(enable))
+
   def observe_agent(self, agent_id):
     """Update last_observation with the current observation from specified
     agent's perspective.
@@ -920,9 +1167,92 @@ class HanabiParallelEnv(object):
     Args:
         agent_id: id of the observing agent.
     """
-    lib.ParallelObserveAgent(self.last_observation._observation,
-                             self._parallel_env,
-                             agent_id)
+    if self.last_observation.packed:
+      lib.ParallelObserveAgentPacked(self.last_observation._observation,
+                                     self._parallel_env,
+                                     agent_id)
+    else:
+      lib.ParallelObserveAgent(self.last_observation._observation,
+                               self._parallel_env,
+                               agent_id)
+
+  def step_and_observe(self, batch_move, agent_id):
+    """Apply moves, reset finished states and observe, in a single pass.
+
+    Equivalent to apply_batch_move, followed by reset_states on the states
+    which became terminal and observe_agent for the next agent, but done in
+    one parallel pass over the states.
+
+    Afterwards last_observation holds the observation of agent
+    (agent_id + 1) % num players, and last_observation.done flags the states
+    whose episode ended in this step and which now hold a new episode. For
+    those states final_scores and episode_lengths hold the score and number
+    of moves of the ended episode, for all others they are 0.
+
+    Args:
+        batch_move: 1D array-like with uids of the moves (must be legal) of
+                    size (n states).
+        agent_id: id of the agent making the moves. It must be agent's turn.
+
+    Returns:
+        rewards: change of score in every state caused by the moves.
+
+    Raises:
+        ValueError: If batch_move does not have one move per state.
+    """
+    batch_move = np.ascontiguousarray(batch_move, dtype=np.intc)
+    if batch_move.shape != (self.num_states(),):
+      raise ValueError("Expected {} moves, got shape {}.".format(
+          self.num_states(), batch_move.shape))
+    lib.ParallelStepAndObserve(
+        self.last_observation._observation,
+        self._parallel_env,
+        len(batch_move),
+        ffi.cast("int*", batch_move.ctypes.data),
+        agent_id,
+        int(self.last_observation.packed),
+        ffi.cast("int16_t*", self.rewards.ctypes.data),
+        ffi.cast("int16_t*", self.final_scores.ctypes.data),
+        ffi.cast("int16_t*", self.episode_lengths.ctypes.data))
+    return self.rewards
+
+  def legal_moves_masks(self, agent_id):
+    """Legal moves of an agent in every state, as uint64 bitmasks.
+
+    Bit i of element s is set iff the move with uid i is legal in state s.
+
+    Args:
+        agent_id: id of the agent.
+    """
+    masks = np.zeros(self.num_states(), dtype=np.uint64)
+    lib.ParallelLegalMovesMasks(self._parallel_env, agent_id,
+                                ffi.cast("uint64_t*", masks.ctypes.data))
+    return masks
+
+  def belief_len(self):
+    """Number of floats of the card beliefs of a single state."""
+    return lib.ParallelBeliefLength(self._parallel_env)
+
+  def beliefs(self, agent_id):
+    """Card beliefs of an agent in every state.
+
+    For every card slot of the agent's hand, the probability of each card
+    color * num ranks + rank, given the card knowledge of the slot and the
+    copies of each card the agent has not seen (deck and own hand). Rows of
+    empty slots are zero.
+
+    Args:
+        agent_id: id of the agent.
+
+    Returns:
+        float32 array of shape (n states, hand size, num colors * num ranks).
+    """
+    beliefs = np.zeros((self.num_states(), self.belief_len()),
+                       dtype=np.float32)
+    lib.ParallelBeliefs(self._parallel_env, agent_id,
+                        ffi.cast("float*", beliefs.ctypes.data))
+    return beliefs.reshape((self.num_states(),
+                            self.parent_game.hand_size(), -1))
 
   def reset_states(self, states, current_agent_id):
     """Reset specified states to an initial state.
@@ -958,12 +1288,302 @@ class HanabiParallelEnv(object):
                       of size (n states).
         agent_id -- id of the agent performing the actions.
                     It must be agent's turn.
+
+    Raises:
+        ValueError: If batch_move does not have one move per state.
     """
+    if len(batch_move) != self.num_states():
+      raise ValueError("Expected {} moves, got {}.".format(
+          self.num_states(), len(batch_move)))
     lib.ParallelApplyBatchMove(self._parallel_env,
                                len(batch_move),
                                list(batch_move),
                                agent_id)
 
+class HanabiAsyncEnvPool(object):
+  """Pool of parallel environments stepped asynchronously by worker threads.
+
+  The states are split into groups of states_per_group, each served by its
+  own worker thread. send() hands moves to a group and returns immediately,
+  recv() returns whichever group finished its step first, so policy inference
+  for one group overlaps with the simulation of the others:
+
+    pool = HanabiAsyncEnvPool({"players": 2}, n_groups=4, states_per_group=64)
+    while True:
+      group = pool.recv()
+      view = pool.groups[group]
+      moves = policy(view.batch_observation, view.legal_moves)
+      pool.send(moves, group)
+
+  Every group is ready to be received after construction. A group steps
+  like HanabiParallelEnv.step_and_observe: finished episodes are reset
+  automatically, and the views hold the observation of the agent to move
+  next, pool.current_agent(group).
+
+  Python wrapper of C++ HanabiAsyncEnvPool class.
+  """
+  class GroupView(object):
+    """Numpy views of the outputs of a group, owned by the pool.
+
+    Attributes batch_observation, legal_moves, scores and done are as in
+    HanabiParallelEnv.HanabiBatchObservation, rewards, final_scores and
+    episode_lengths as in HanabiParallelEnv.step_and_observe. The views are
+    valid from recv() of the group until its next send().
+    """
+    def __init__(self, pool, group, packed):
+      observation = ffi.new("pyhanabi_batch_observation_t*")
+      lib.AsyncEnvPoolGroupObservation(observation, pool, group)
+      results = ffi.new("pyhanabi_step_results_t*")
+      lib.AsyncEnvPoolGroupStepResults(results, pool, group)
+      n_states, obs_len, max_moves = (observation.observation_shape[0],
+                                      observation.observation_shape[1],
+                                      observation.legal_moves_shape[1])
+      asarray = HanabiParallelEnv.HanabiBatchObservation._asarray
+      self.batch_observation = asarray(
+          observation.observation, n_states * obs_len,
+          np.uint8 if packed else np.int8).reshape((n_states, obs_len))
+      self.legal_moves = asarray(
+          observation.legal_moves, n_states * max_moves,
+          np.int8).reshape((n_states, max_moves))
+      self.scores = asarray(observation.scores, n_states, np.int16)
+      self.done = asarray(observation.done, n_states, np.int8)
+      self.rewards = asarray(results.rewards, n_states, np.int16)
+      self.final_scores = asarray(results.final_scores, n_states, np.int16)
+      self.episode_lengths = asarray(results.episode_lengths, n_states,
+                                     np.int16)
+
+  def __init__(self, params, n_groups, states_per_group,
+               packed_observations=False, threads_per_group=1):
+    """Creates a HanabiAsyncEnvPool object.
+
+    Args:
+      params: is a dictionary of game parameters, see HanabiParallelEnv.
+      n_groups: number of groups, i.e. of worker threads.
+      states_per_group: number of parallel states in each group.
+      packed_observations: whether observations are bit-packed, 8 bits per
+        byte (see HanabiParallelEnv.HanabiBatchObservation).
+      threads_per_group: number of OpenMP threads each worker uses.
+    """
+    param_list = []
+    for key in params:
+      param_list.append(ffi.new("char[]", key.encode('ascii')))
+      param_list.append(ffi.new("char[]", str(params[key]).encode('ascii')))
+    c_array = ffi.new("char * [" + str(len(param_list)) + "]", param_list)
+    self._pool = ffi.new("pyhanabi_async_env_pool_t*")
+    lib.NewAsyncEnvPool(self._pool, len(param_list), c_array, n_groups,
+                        states_per_group, int(packed_observations),
+                        threads_per_group)
+    self.groups = [HanabiAsyncEnvPool.GroupView(self._pool, group,
+                                                packed_observations)
+                   for group in range(n_groups)]
+
+  def num_groups(self):
+    """Number of groups."""
+    return lib.AsyncEnvPoolNumGroups(self._pool)
+
+  def states_per_group(self):
+    """Number of parallel states in each group."""
+    return lib.AsyncEnvPoolStatesPerGroup(self._pool)
+
+  def send(self, batch_move, group):
+    """Hand moves to a group, without waiting for them to be applied.
+
+    Args:
+        batch_move: 1D array-like with uids of the moves (must be legal) of
+                    the current agent of the group, of size
+                    (states per group).
+        group: group which was returned by recv() since it was last sent to.
+
+    Raises:
+        ValueError: If batch_move does not have one move per state of the
+                    group.
+    """
+    batch_move = np.ascontiguousarray(batch_move, dtype=np.intc)
+    if batch_move.shape != (self.states_per_group(),):
+      raise ValueError("Expected {} moves, got shape {}.".format(
+          self.states_per_group(), batch_move.shape))
+    lib.AsyncEnvPoolSend(self._pool, group, len(batch_move),
+                         ffi.cast("int*", batch_move.ctypes.data))
+
+  def recv(self):
+    """Wait for a group to finish its step and return the group's index."""
+    return lib.AsyncEnvPoolRecv(self._pool)
+
+  def current_agent(self, group):
+    """Id of the agent to move next in a group."""
+    return lib.AsyncEnvPoolCurrentAgent(self._pool, group)
+
+  def __del__(self):
+    if self._pool is not None:
+      self.groups = None
+      lib.DeleteAsyncEnvPool(self._pool)
+      self._pool = None
+    del self
+
+class HanabiBatchEngine(object):
+  """Batched game engine storing all games as a structure of arrays.
+
+  A faster alternative to HanabiParallelEnv for very large batches. Every game
+  always waits for its current player: the engine deals cards itself and
+  replaces finished games automatically, like
+  HanabiParallelEnv.step_and_observe. Observations are those of each game's
+  current player, encoded like the canonical encoder.
+
+    engine = HanabiBatchEngine({"players": 2}, n_games=100000)
+    engine.observe()
+    while True:
+      moves = policy(engine.batch_observation, engine.legal_moves)
+      engine.step_and_observe(moves)
+
+  Attributes batch_observation, legal_moves, scores and done are numpy
+  arrays as in HanabiParallelEnv.HanabiBatchObservation, rewards,
+  final_scores and episode_lengths as in HanabiParallelEnv.step_and_observe.
+  They are owned by the engine and overwritten by every call.
+
+  Games are dealt from other random streams than HanabiParallelEnv's, so
+  the same seed gives different games.
+
+  Python wrapper of C++ HanabiBatchEngine class.
+  """
+
+  def __init__(self, params, n_games):
+    """Creates a HanabiBatchEngine object.
+
+    Args:
+      params: is a dictionary of game parameters, see HanabiParallelEnv.
+      n_games: number of games.
+    """
+    param_list = []
+    for key in params:
+      param_list.append(ffi.new("char[]", key.encode('ascii')))
+      param_list.append(ffi.new("char[]", str(params[key]).encode('ascii')))
+    c_array = ffi.new("char * [" + str(len(param_list)) + "]", param_list)
+    self._engine = ffi.new("pyhanabi_batch_engine_t*")
+    lib.NewBatchEngine(self._engine, len(param_list), c_array, n_games)
+    obs_len = lib.BatchEngineObservationLength(self._engine)
+    max_moves = lib.BatchEngineMaxMoves(self._engine)
+    self.batch_observation = np.zeros((n_games, obs_len), dtype=np.int8)
+    self.legal_moves = np.zeros((n_games, max_moves), dtype=np.int8)
+    self.scores = np.zeros(n_games, dtype=np.int16)
+    self.done = np.zeros(n_games, dtype=np.int8)
+    self.rewards = np.zeros(n_games, dtype=np.int16)
+    self.final_scores = np.zeros(n_games, dtype=np.int16)
+    self.episode_lengths = np.zeros(n_games, dtype=np.int16)
+
+  def num_games(self):
+    """Number of games."""
+    return lib.BatchEngineNumGames(self._engine)
+
+  def cur_player(self, game):
+    """Player to move in a game."""
+    return lib.BatchEngineCurPlayer(self._engine, game)
+
+  def reset(self):
+    """Start a new episode in every game and observe."""
+    lib.BatchEngineReset(self._engine)
+    self.observe()
+
+  def observe(self):
+    """Observe all games without stepping them; clears done."""
+    lib.BatchEngineObserve(
+        self._engine,
+        ffi.cast("int8_t*", self.batch_observation.ctypes.data),
+        ffi.cast("int8_t*", self.legal_moves.ctypes.data),
+        ffi.cast("int16_t*", self.scores.ctypes.data),
+        ffi.cast("int8_t*", self.done.ctypes.data))
+
+  def step_and_observe(self, batch_move):
+    """Apply one move in every game, replace finished games and observe.
+
+    Args:
+        batch_move: 1D array-like with uids of the moves (must be legal) of
+                    the current players, of size (n games).
+
+    Returns:
+        rewards: change of score in every game caused by the moves.
+
+    Raises:
+        ValueError: If batch_move does not have one move per game.
+    """
+    batch_move = np.ascontiguousarray(batch_move, dtype=np.intc)
+    if batch_move.shape != (self.num_games(),):
+      raise ValueError("Expected {} moves, got shape {}.".format(
+          self.num_games(), batch_move.shape))
+    lib.BatchEngineStepAndObserve(
+        self._engine,
+        len(batch_move),
+        ffi.cast("int*", batch_move.ctypes.data),
+        ffi.cast("int8_t*", self.batch_observation.ctypes.data),
+        ffi.cast("int8_t*", self.legal_moves.ctypes.data),
+        ffi.cast("int16_t*", self.scores.ctypes.data),
+        ffi.cast("int8_t*", self.done.ctypes.data),
+        ffi.cast("int16_t*", self.rewards.ctypes.data),
+        ffi.cast("int16_t*", self.final_scores.ctypes.data),
+        ffi.cast("int16_t*", self.episode_lengths.ctypes.data))
+    return self.rewards
+
+  def legal_moves_masks(self):
+    """Legal moves of the current player of every game, as uint64 bitmasks.
+
+    Bit i of element g is set iff the move with uid i is legal in game g.
+    """
+    masks = np.zeros(self.num_games(), dtype=np.uint64)
+    lib.BatchEngineLegalMovesMasks(self._engine,
+                                   ffi.cast("uint64_t*", masks.ctypes.data))
+    return masks
+
+  def __del__(self):
+    if self._engine is not None:
+      lib.DeleteBatchEngine(self._engine)
+      self._engine = None
+    del self
+
+class HanabiIsmcts(object):
+  """Native ISMCTS search whose trees are kept across searches.
+
+  Same search as HanabiState.ismcts, but the node arenas of the threads are
+  allocated once and reused by every call of search, and successive searches
+  draw from different random streams of the seed.
+
+    search = HanabiIsmcts(max_iterations=10000, seed=1)
+    visits = search.search(state)
+
+  Python wrapper of C++ HanabiIsmcts class.
+  """
+
+  def __init__(self, max_iterations=1000, time_limit=0.0, max_nodes=1 << 20,
+               exploration=0.1, rollout_policy="random", num_threads=0,
+               seed=0):
+    """Creates a HanabiIsmcts object, see HanabiState.ismcts for arguments."""
+    self._search = None
+    check_policy_names([rollout_policy])
+    self._search = ffi.new("pyhanabi_ismcts_t*")
+    lib.NewIsmcts(self._search,
+                  ffi.new("char[]", rollout_policy.encode('ascii')),
+                  max_iterations, time_limit, max_nodes, exploration,
+                  num_threads, seed)
+
+  def search(self, state):
+    """Searches the current player's move in state, see HanabiState.ismcts.
+
+    Returns:
+      numpy int64 array of length max_moves with the visits of every move.
+    """
+    visits = np.zeros(lib.MaxMoves(state._game), dtype=np.int64)
+    lib.IsmctsSearch(self._search, state._state,
+                     ffi.cast("int64_t*", visits.ctypes.data))
+    return visits
+
+  def num_iterations(self):
+    """Iterations made by the last search."""
+    return lib.IsmctsNumIterations(self._search)
+
+  def __del__(self):
+    if self._search is not None:
+      lib.DeleteIsmcts(self._search)
+      self._search = None
+    del self
+
 class HanabiObservation(object):
   """Player's observed view of an environment HanabiState.
 
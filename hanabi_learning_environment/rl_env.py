@@ -208,9 +208,8 @@ class HanabiEnv(Environment):
                                   'vectorized': [ 0, 0, 1, ... ]}]}
     """
     self.state = self.game.new_initial_state()
-
-    while self.state.cur_player() == pyhanabi.CHANCE_PLAYER_ID:
-      self.state.deal_random_card()
+    # Deals the initial hands, and the replacement cards in apply_move.
+    self.state.set_direct_deal(True)
 
     obs = self._make_observation_all_players()
     obs["current_player"] = self.state.cur_player()
@@ -354,9 +353,6 @@ class HanabiEnv(Environment):
     # Apply the action to the state.
     self.state.apply_move(action)
 
-    while self.state.cur_player() == pyhanabi.CHANCE_PLAYER_ID:
-      self.state.deal_random_card()
-
     observation = self._make_observation_all_players()
     done = self.state.is_terminal()
     # Reward is score differential. May be large and negative at game end.